@@ -28,13 +28,17 @@
 #include "lib/disassembly.h"
 #include "lib/print.h"
 #include "lib/voxel.h"
+#include "lib/movementcache.h"
+#include "lib/grid-type.h"
 #include "lib/solution.h"
+#include "lib/binary-puzzle.h"
 #include "tools/xml.h"
 #include "tools/gzstream.h"
 
 #include <stdlib.h>
 
 #include <fstream>
+#include <memory>
 #include <iostream>
 
 using namespace std;
@@ -63,7 +67,17 @@ public:
 
     Assemblies++;
 
-    if (disassemble) {
+    if (disassemble && quiet && !allProblems && !printDisassemble) {
+
+      // nothing of the disassembly is printed, so just check if there is one
+      if (d->disassemblable(a)) {
+        Solutions++;
+
+        if (printSolutions)
+          print(a, puzzle);
+      }
+
+    } else if (disassemble) {
 
       Separation * da = d->disassemble(a);
 
@@ -97,7 +111,7 @@ public:
 void usage() {
 
   cout << "burrTxt [options] file [options]\n\n";
-  cout << "  file: puzzle file with the puzzle definition to solve\n\n";
+  cout << "  file: puzzle file with the puzzle definition to solve, XML or binary\n\n";
   cout << "  -d    try to disassemble and only print solutions that do disassemble\n";
   cout << "  -p    print the disassembly plan\n";
   cout << "  -r    reduce the placements bevore starting to solve the puzzle\n";
@@ -106,13 +120,35 @@ void usage() {
   cout << "  -n    don't print a newline at the end of the line\n";
   cout << "  -o n  select the problem to solve\n";
   cout << "  -o all solves all problems in file\n";
+  cout << "  -t n  use n threads for the assembler\n";
   cout << "  -x    only redisassemble the given solutions\n";
+  cout << "  -C file  keep the values calculated for the disassembly in the file, so that\n";
+  cout << "        later runs can reuse them\n";
+  cout << "  -B file  save the puzzle in the binary format into file and exit\n";
+  cout << "  -X file  save the puzzle in the XML format into file and exit\n";
   cout << "  -a    ask for information about the current puzzle, the next letters must be:\n";
   cout << "     s0 print solutions with the only the used pieces\n";
   cout << "     s1 print solutions including the assemblies\n";
   cout << "     c  print comment\n";
 }
 
+/* create the disassembler for the problem. When a cache file is given, the disassembler
+ * uses a movement cache that keeps its values in that file. This cache is returned
+ * in cache and must be deleted after the disassembler
+ */
+static DisassemblerInterface *newDisassembler(const Problem *problem, const char *cacheName, movementCache_c **cache) {
+
+  *cache = 0;
+
+  if (cacheName) {
+    *cache = problem->getGridType()->getMovementCache(problem);
+    if (*cache && !(*cache)->setFile(cacheName))
+      cout << "Can not use the movement cache file " << cacheName << "\n";
+  }
+
+  return new SimpleDisassembler(problem, *cache);
+}
+
 int main(int argv, char* args[]) {
 
   if (argv < 1) {
@@ -132,8 +168,13 @@ int main(int argv, char* args[]) {
   unsigned int lastProblem = 0;
   int filenumber = 0;
   bool reduce = false;
+  const char *cacheName = 0;
+  const char *binaryName = 0;
+  const char *xmlName = 0;
+  movementCache_c *cache = 0;
   bool newline = true;
   bool ask = false;
+  unsigned int threads = 1;
   enum {
     W_NUM_SOLUTIONS,
     W_SOLUTION_PIECES,
@@ -159,6 +200,22 @@ int main(int argv, char* args[]) {
         newline = false;
       else if (strcmp(args[i], "-x") == 0)
         assemble = false;
+      else if (strcmp(args[i], "-t") == 0) {
+        threads = atoi(args[i+1]);
+        i++;
+      }
+      else if (strcmp(args[i], "-C") == 0) {
+        cacheName = args[i+1];
+        i++;
+      }
+      else if (strcmp(args[i], "-B") == 0) {
+        binaryName = args[i+1];
+        i++;
+      }
+      else if (strcmp(args[i], "-X") == 0) {
+        xmlName = args[i+1];
+        i++;
+      }
       else if (strcmp(args[i], "-o") == 0) {
         if (strcmp(args[i+1],"all")==0)
           allProblems = true;
@@ -195,10 +252,41 @@ int main(int argv, char* args[]) {
     return 1;
   }
 
-  std::istream * str = openGzFile(args[filenumber]);
-  XmlParser pars(*str);
-  Puzzle p(pars);
-  delete str;
+  std::unique_ptr<Puzzle> puzzle;
+
+  if (isBinaryPuzzle(args[filenumber])) {
+    puzzle.reset(loadBinaryPuzzle(args[filenumber]));
+    if (!puzzle) {
+      cout << "Can not load the binary puzzle file " << args[filenumber] << "\n";
+      return 2;
+    }
+  } else {
+    std::istream * str = openGzFile(args[filenumber]);
+    XmlParser pars(*str);
+    puzzle.reset(new Puzzle(pars));
+    delete str;
+  }
+
+  Puzzle &p = *puzzle;
+
+  if (binaryName) {
+    if (!saveBinaryPuzzle(&p, binaryName)) {
+      cout << "Can not write the binary puzzle file " << binaryName << "\n";
+      return 2;
+    }
+    return 0;
+  }
+
+  if (xmlName) {
+    ofstream ostr(xmlName);
+    if (!ostr) {
+      cout << "Can not write the puzzle file " << xmlName << "\n";
+      return 2;
+    }
+    XmlWriter xml(ostr);
+    p.save(xml);
+    return 0;
+  }
 
   if (ask) {
 
@@ -272,6 +360,7 @@ int main(int argv, char* args[]) {
       Problem * problem = p.getProblem(pr);
 
       AssemblerInterface *assm = p.getGridType()->findAssembler(problem);
+      assm->setThreads(threads);
 
       switch (assm->createMatrix(problem, false, false, false)) {
       case AssemblerInterface::ERR_TOO_MANY_UNITS:
@@ -311,7 +400,7 @@ int main(int argv, char* args[]) {
 
       d = 0;
       if (disassemble)
-        d = new SimpleDisassembler(problem);
+        d = newDisassembler(problem, cacheName, &cache);
 
       assm->assemble(&a);
 
@@ -322,7 +411,9 @@ int main(int argv, char* args[]) {
 
       delete assm;
       delete d;
+      delete cache;
       d = 0;
+      cache = 0;
       assm = 0;
     }
   } else {
@@ -331,7 +422,7 @@ int main(int argv, char* args[]) {
 
       Problem * problem = p.getProblem(pr);
 
-      d = new SimpleDisassembler(problem);
+      d = newDisassembler(problem, cacheName, &cache);
 
       for (unsigned int sol = 0; sol < problem->solutionNumber(); sol++) {
 
@@ -354,6 +445,8 @@ int main(int argv, char* args[]) {
       }
 
       delete d;
+      delete cache;
+      cache = 0;
     }
   }
 
@@ -23,6 +23,7 @@
 #include "lib/problem.h"
 #include "lib/solvethread.h"
 #include "lib/voxel.h"
+#include "lib/grid-type.h"
 #include "tools/xml.h"
 #include "tools/gzstream.h"
 
@@ -50,7 +51,164 @@ burrTxt [options] file [options]
   -m    keep mirror solutions
   -r    keep rotated solutions
   -p    drop disassemblies and replace by information about disassembly
-  -b    selecte problem, else 0)";
+  -b    selecte problem, else 0
+  -t n  use n threads for the assembler
+  -s n  split the search for the threads at level n, else automatic
+  -D n  use n threads to disassemble the found assemblies
+  -S n  split the search into n parts and save each into its own file
+        (file.partX.xmpuzzle), these can be solved like any other file
+  -M out  merge the solved parts given as files into the file out, the solutions
+        are sorted and limited like a single search with the given -d and -c would
+  -j n  print statistics as a JSON line to stderr every n seconds
+  -C file  keep the values calculated for the disassembly in the file, so
+        that later runs can reuse them
+  -W n  keep only the n most recent solutions unpacked and the others packed
+        in memory, for searches with many solutions
+  -w file  like -W but keep the packed solutions in the file file.N, N being
+        the problem, the window is 1000 when -W is not given)";
+}
+
+/* write the statistics of the solver as one line of JSON */
+static void printStatistics(std::ostream &out, const SolveThread::Statistics &s) {
+
+  static const char *actions[] = {
+    "preparation", "reduce", "assembling", "disassembling", "pausing",
+    "finished", "error", "assert", "wait_to_stop"
+  };
+
+  out << "{\"time\":" << s.time
+      << ",\"action\":\"" << actions[s.action] << "\""
+      << ",\"finished\":" << s.finished
+      << ",\"iterations\":" << s.iterations
+      << ",\"iterationsPerSecond\":" << s.iterationsPerSecond
+      << ",\"assemblies\":" << s.assemblies
+      << ",\"assembliesPerSecond\":" << s.assembliesPerSecond
+      << ",\"solutions\":" << s.solutions
+      << ",\"solutionsPerSecond\":" << s.solutionsPerSecond
+      << ",\"disassemblyQueue\":" << s.disassemblyQueue
+      << ",\"movementCacheHits\":" << s.movementCacheHits
+      << ",\"movementCacheMisses\":" << s.movementCacheMisses
+      << ",\"actionTime\":{";
+
+  for (unsigned int i = 0; i <= SolveThread::ACT_WAIT_TO_STOP; i++)
+    out << (i ? "," : "") << "\"" << actions[i] << "\":" << s.actionTime[i];
+
+  out << "},\"depthHistogram\":[";
+
+  for (unsigned int i = 0; i < s.depthHistogram.size(); i++)
+    out << (i ? "," : "") << s.depthHistogram[i];
+
+  out << "]}" << std::endl;
+}
+
+/* split the search of the problem into parts and save a copy of the puzzle
+ * for each part with the assembler at the start of the part
+ */
+static int splitProblem(Puzzle &p, unsigned int pr, int par, unsigned int parts, std::string name) {
+
+  Problem *prob = p.getProblem(pr);
+
+  prob->removeAllSolutions();
+
+  AssemblerInterface *assm = prob->getGridType()->findAssembler(prob);
+
+  if (assm->createMatrix(prob,
+                         par & SolveThread::PAR_KEEP_MIRROR,
+                         par & SolveThread::PAR_KEEP_ROTATIONS,
+                         par & SolveThread::PAR_COMPLETE_ROTATIONS) != AssemblerInterface::ERR_NONE) {
+    cout << "Could not prepare the problem for the assembler\n";
+    delete assm;
+    return 2;
+  }
+
+  if (par & SolveThread::PAR_REDUCE)
+    assm->reduce();
+
+  // the problem takes over the assembler
+  prob->setAssembler(assm);
+
+  unsigned int count = assm->splitSearch(parts);
+
+  if (!count) {
+    cout << "The search for this problem can not be split\n";
+    return 2;
+  }
+
+  std::string ext;
+
+  if ((name.size() > 9) && (name.compare(name.size() - 9, 9, ".xmpuzzle") == 0)) {
+    ext = ".xmpuzzle";
+    name.erase(name.size() - 9);
+  }
+
+  for (unsigned int i = 0; i < count; i++) {
+
+    assm->selectPart(i);
+
+    std::string outname = name + ".part" + std::to_string(i) + ext;
+
+    ofstream ostr(outname.c_str());
+    if (!ostr) {
+      cout << "Can not open output file " << outname << ", aborting\n";
+      return 2;
+    }
+
+    XmlWriter xml(ostr);
+    p.save(xml);
+  }
+
+  cout << "split into " << count << " parts\n";
+
+  return 0;
+}
+
+/* merge the solutions of all the given files into the first one and save that, the solutions
+ * are sorted and limited like the solver does it with the parameters par
+ */
+static int mergeParts(char *args[], const std::vector<int> &files, int firstProblem, int lastProblem, int par, const char *outname) {
+
+  std::istream *str = openGzFile(args[files[0]]);
+  XmlParser pars(*str);
+  Puzzle p(pars);
+  delete str;
+
+  for (unsigned int f = 0; f < files.size(); f++) {
+
+    std::istream *str2 = openGzFile(args[files[f]]);
+    XmlParser pars2(*str2);
+    Puzzle p2(pars2);
+    delete str2;
+
+    if (p2.problemNumber() != p.problemNumber()) {
+      cout << args[files[f]] << " contains a different puzzle, aborting\n";
+      return 2;
+    }
+
+    for (int pr = firstProblem; pr < lastProblem; pr++) {
+
+      if (p2.getProblem(pr)->getSolveState() != SS_SOLVED) {
+        cout << args[files[f]] << " is not completely solved, aborting\n";
+        return 2;
+      }
+
+      // the first file is the base that gets all the others
+      if (f > 0) {
+        SolveThread merger(p.getProblem(pr), par);
+        merger.mergeSolutions(p2.getProblem(pr));
+      }
+    }
+  }
+
+  ofstream ostr(outname);
+  if (!ostr) {
+    cout << "Can not open output file, aborting\n";
+    return 2;
+  }
+
+  XmlWriter xml(ostr);
+  p.save(xml);
+
+  return 0;
 }
 
 
@@ -81,6 +239,16 @@ int main(int argv, char* args[]) {
   int filenumber = 0;
   int firstProblem = 0;
   int lastProblem = 1;
+  int threads = 1;
+  int splitDepth = 0;
+  int disassemblerThreads = 1;
+  int parts = 0;
+  const char *mergeName = 0;
+  const char *cacheName = 0;
+  const char *spillName = 0;
+  int spillWindow = 0;
+  int statsInterval = 0;
+  std::vector<int> files;
 
   for(int i = 1; i < argv; i++) {
 
@@ -101,8 +269,46 @@ int main(int argv, char* args[]) {
       lastProblem = firstProblem + 1;
       i++;
     }
-    else
+    else if (strcmp(args[i], "-t") == 0) {
+      threads = atoi(args[i+1]);
+      i++;
+    }
+    else if (strcmp(args[i], "-s") == 0) {
+      splitDepth = atoi(args[i+1]);
+      i++;
+    }
+    else if (strcmp(args[i], "-D") == 0) {
+      disassemblerThreads = atoi(args[i+1]);
+      i++;
+    }
+    else if (strcmp(args[i], "-S") == 0) {
+      parts = atoi(args[i+1]);
+      i++;
+    }
+    else if (strcmp(args[i], "-M") == 0) {
+      mergeName = args[i+1];
+      i++;
+    }
+    else if (strcmp(args[i], "-j") == 0) {
+      statsInterval = atoi(args[i+1]);
+      i++;
+    }
+    else if (strcmp(args[i], "-C") == 0) {
+      cacheName = args[i+1];
+      i++;
+    }
+    else if (strcmp(args[i], "-w") == 0) {
+      spillName = args[i+1];
+      i++;
+    }
+    else if (strcmp(args[i], "-W") == 0) {
+      spillWindow = atoi(args[i+1]);
+      i++;
+    }
+    else {
       filenumber = i;
+      files.push_back(i);
+    }
   }
 
   if (filenumber == 0) {
@@ -110,11 +316,20 @@ int main(int argv, char* args[]) {
     return 1;
   }
 
+  if (mergeName)
+    return mergeParts(args, files, firstProblem, lastProblem, par, mergeName);
+
   std::istream * str = openGzFile(args[filenumber]);
   XmlParser pars(*str);
   Puzzle p(pars);
   delete str;
 
+  for (unsigned int i = 0; i < p.shapeNumber(); i++)
+    p.getShape(i)->initHotspot();
+
+  if (parts > 0)
+    return splitProblem(p, firstProblem, par, parts, args[filenumber]);
+
   std::string outname = args[filenumber];
   outname += "ttt";
   cout << "outputting into " << outname << std::endl;
@@ -126,23 +341,38 @@ int main(int argv, char* args[]) {
     return 2;
   }
 
-  for (unsigned int i = 0; i < p.shapeNumber(); i++)
-    p.getShape(i)->initHotspot();
-
 
   for (int pr = firstProblem ; pr < lastProblem ; pr++) {
 
     if (restart)
       p.getProblem(pr)->removeAllSolutions();
 
+    if (spillName) {
+      std::string n = std::string(spillName) + "." + std::to_string(pr);
+      if (spillWindow == 0)
+        spillWindow = 1000;
+      if (spillWindow < 2 || !p.getProblem(pr)->setSolutionSpill(n.c_str(), spillWindow))
+        cout << "Can not keep the solutions in the file " << n << "\n";
+    } else if (spillWindow) {
+      if (spillWindow < 2 || !p.getProblem(pr)->setSolutionSpill(0, spillWindow))
+        cout << "Can not pack the solutions\n";
+    }
 
     SolveThread assmThread(p.getProblem(pr), par);
+    assmThread.setThreads(threads, splitDepth);
+    assmThread.setDisassemblerThreads(disassemblerThreads);
+
+    if (cacheName && !assmThread.setMovementCacheFile(cacheName))
+      cout << "Can not use the movement cache file " << cacheName << "\n";
 
     if (!assmThread.start(false)) {
       cout << "Could not start Solver\n";
       continue;
     }
 
+    time_t lastStats = time(0);
+    SolveThread::Statistics stats;
+
     while (assmThread.currentAction() != SolveThread::ACT_FINISHED &&
         assmThread.currentAction() != SolveThread::ACT_ERROR) {
 
@@ -181,7 +411,14 @@ int main(int argv, char* args[]) {
           cout << "\rpreparing piece " << assmThread.currentActionParameter()+1;
           break;
         case SolveThread::ACT_REDUCE:
-          cout << "\rreducing piece " << assmThread.currentActionParameter()+1;
+          {
+            unsigned int checked, total;
+            assmThread.reduceProgress(&checked, &total);
+            if (total)
+              cout << "\rreducing placement " << checked << "/" << total;
+            else
+              cout << "\rreducing piece " << assmThread.currentActionParameter()+1;
+          }
           break;
         case SolveThread::ACT_ASSEMBLING:
           cout << "\rassembling " << finished*100 << "% done";
@@ -227,6 +464,16 @@ int main(int argv, char* args[]) {
 
       cout.flush();
 
+      if (statsInterval && (time(0) - lastStats >= statsInterval)) {
+        lastStats = time(0);
+        assmThread.getStatistics(&stats);
+        printStatistics(cerr, stats);
+      }
+    }
+
+    if (statsInterval) {
+      assmThread.getStatistics(&stats);
+      printStatistics(cerr, stats);
     }
   }
 
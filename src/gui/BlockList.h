@@ -348,7 +348,7 @@ public:
   }
 
   void setPuzzle(const Problem *pz);
-  void setAssembly(Assembly * assm);
+  void setAssembly(const Assembly * assm);
   virtual unsigned int blockNumber(void);
   virtual void blockDraw(unsigned int block, int x, int y);
   virtual void blockSize(unsigned int block, unsigned int *w, unsigned int *h);
@@ -408,6 +408,9 @@ void imageExport_c::cb_Export() {
   /* this vector contains all the information of all images that need to appear in the output */
   images.clear();
 
+  delete disassembly;
+  disassembly = 0;
+
   if (ExpShape->value()) {
 
     images.push_back(new ImageInfo(puzzle_, getColorMode(),
@@ -425,8 +428,9 @@ void imageExport_c::cb_Export() {
 
     // generate an image for each step (for the moment only for the last solution)
     unsigned int s = pr->solutionNumber() - 1;
-    Separation * t = pr->getSolution(s)->getDisassembly();
-    if (!t) return;
+    if (!pr->getSolution(s)->getDisassembly()) return;
+    disassembly = new Separation(pr->getSolution(s)->getDisassembly());
+    const Separation * t = disassembly;
 
     for (unsigned int step = 0; step < t->sumMoves(); step++) {
       DisassemblyToMoves * dtm = new DisassemblyToMoves(t, 20, pr->pieceNumber());
@@ -442,8 +446,9 @@ void imageExport_c::cb_Export() {
 
     // generate an image for each step (for the moment only for the last solution)
     unsigned int s = pr->solutionNumber() - 1;
-    Separation * t = pr->getSolution(s)->getDisassembly();
-    if (!t) return;
+    if (!pr->getSolution(s)->getDisassembly()) return;
+    disassembly = new Separation(pr->getSolution(s)->getDisassembly());
+    const Separation * t = disassembly;
 
     for (unsigned int step = t->sumMoves() - 1; step > 0; step--) {
       DisassemblyToMoves * dtm = new DisassemblyToMoves(t, 20, pr->pieceNumber());
@@ -579,7 +584,11 @@ void imageExport_c::cb_SzUpdate() {
   }
 }
 
-imageExport_c::imageExport_c(Puzzle * p) : LFl_Double_Window(false), puzzle_(p), working(false), state(0), i(0) {
+imageExport_c::~imageExport_c(void) {
+  delete disassembly;
+}
+
+imageExport_c::imageExport_c(Puzzle * p) : LFl_Double_Window(false), puzzle_(p), working(false), disassembly(0), state(0), i(0) {
 
   label("Export Images");
 
@@ -55,6 +55,7 @@ class LBlockListGroup;
 class ImageInfo;
 class image_c;
 class Puzzle;
+class Separation;
 
 class imageExport_c : public LFl_Double_Window, public VoxelViewCallbacks {
 
@@ -88,6 +89,11 @@ class imageExport_c : public LFl_Double_Window, public VoxelViewCallbacks {
      */
     std::vector<ImageInfo*> images;
 
+    /* a copy of the disassembly the images show, the one of the solution
+     * is only valid until the solution gets unloaded by its spill
+     */
+    Separation * disassembly;
+
     /* some internal variables for the image export */
     unsigned int state;        /* what is currently done, 0: preview, 1: export */
     image_c *i;                  /* current page that is worked on */
@@ -106,6 +112,7 @@ class imageExport_c : public LFl_Double_Window, public VoxelViewCallbacks {
   public:
 
     imageExport_c(Puzzle * p);
+    ~imageExport_c(void);
 
     /* returns true, when there is currently a image export in progress */
     bool isWorking() { return working; }
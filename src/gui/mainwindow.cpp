@@ -55,6 +55,7 @@
 #include "../config.h"
 
 #include "../lib/ps3dloader.h"
+#include "../lib/binary-puzzle.h"
 #include "../lib/voxel.h"
 #include "../lib/puzzle.h"
 #include "../lib/problem.h"
@@ -1387,7 +1388,7 @@ void MainWindow::cb_Load() {
       if (fl_choice("Puzzle changed are you sure?", "Cancel", "Load", 0) == 0)
         return;
 
-    const char * f = flu_file_chooser("Load Puzzle", "*.xmpuzzle", "");
+    const char * f = flu_file_chooser("Load Puzzle", "*.{xmpuzzle,btpuzzle}", "");
 
     tryToLoad(f);
   }
@@ -1887,30 +1888,56 @@ bool MainWindow::tryToLoad(const char * f) {
   if (!f) return false;
   if (!fileExists(f)) return false;
 
-  std::istream * str = openGzFile(f);
-  XmlParser pars(*str);
-
   Puzzle * newPuzzle;
 
-  try {
-    newPuzzle = new Puzzle(pars);
-  }
+  if (isBinaryPuzzle(f)) {
+
+    try {
+      newPuzzle = loadBinaryPuzzle(f);
+    }
+
+    catch (xmlParserException_c e)
+    {
+      fl_message("%s", (std::string("load error: ") + e.what()).c_str());
+      return false;
+    }
+
+    if (!newPuzzle) {
+      fl_message("Could not load the binary puzzle file");
+      return false;
+    }
+
+  } else {
+
+    std::istream * str = openGzFile(f);
+    XmlParser pars(*str);
+
+    try {
+      newPuzzle = new Puzzle(pars);
+    }
+
+    catch (xmlParserException_c e)
+    {
+      fl_message("%s", (std::string("load error: ") + e.what()).c_str());
+      delete str;
+      return false;
+    }
 
-  catch (xmlParserException_c e)
-  {
-    fl_message("%s", (std::string("load error: ") + e.what()).c_str());
     delete str;
-    return false;
   }
 
-  delete str;
-
   if (fname) delete [] fname;
-  fname = new char[strlen(f)+1];
-  strcpy(fname, f);
+  fname = 0;
+
+  // the solutions of binary files stay in the file, so it must not be
+  // overwritten, save asks for a new file instead
+  if (!isBinaryPuzzle(f)) {
+    fname = new char[strlen(f)+1];
+    strcpy(fname, f);
+  }
 
   char nm[300];
-  snprintf(nm, 299, "BurrTools - %s", fname);
+  snprintf(nm, 299, "BurrTools - %s", f);
   label(nm);
 
   ReplacePuzzle(newPuzzle);
@@ -2077,6 +2104,8 @@ void MainWindow::activateSolution(unsigned int prob, unsigned int num) {
   if (disassemble) {
     delete disassemble;
     disassemble = 0;
+    delete disassembleTree;
+    disassembleTree = 0;
   }
 
   if ((prob < puzzle_->problemNumber()) && (num < puzzle_->getProblem(prob)->solutionNumber())) {
@@ -2104,7 +2133,8 @@ void MainWindow::activateSolution(unsigned int prob, unsigned int num) {
 
       MovesInfo->value(levelText);
 
-      disassemble = new DisassemblyToMoves(pr->getSolution(num)->getDisassembly(),
+      disassembleTree = new Separation(pr->getSolution(num)->getDisassembly());
+      disassemble = new DisassemblyToMoves(disassembleTree,
                                       2*pr->getResultShape()->getBiggestDimension(),
                                            pr->pieceNumber());
       disassemble->setStep(SolutionAnim->value(), config.useBlendedRemoving(), true);
@@ -2693,6 +2723,16 @@ void MainWindow::updateInterface() {
         }
         break;
       case SolveThread::ACT_REDUCE:
+        {
+          unsigned int checked, total;
+          assmThread->reduceProgress(&checked, &total);
+          if (total) {
+            char tmp[40];
+            snprintf(tmp, 40, "optimize %u/%u", checked, total);
+            OutputActivity->value(tmp);
+            break;
+          }
+        }
         if (pr->getAssembler()) {
           char tmp[20];
           snprintf(tmp, 20, "optimize piece %i", pr->getAssembler()->getReducePiece()+1);
@@ -3714,6 +3754,7 @@ MainWindow::MainWindow(std::unique_ptr<GridType> grid_type)
   assmThread = 0;
   fname = 0;
   disassemble = 0;
+  disassembleTree = 0;
   editSymmetries = 0;
   expertMode = true;
 
@@ -3797,6 +3838,8 @@ MainWindow::~MainWindow() {
   if (disassemble) {
     delete disassemble;
     disassemble = 0;
+    delete disassembleTree;
+    disassembleTree = 0;
   }
 
   if (gui_grid_type_)
@@ -31,6 +31,7 @@ class ToolTab;
 class Puzzle;
 class SolveThread;
 class DisassemblyToMoves;
+class Separation;
 class GridType;
 class GuiGridType;
 class Layouter;
@@ -66,6 +67,7 @@ class MainWindow : public LFl_Double_Window {
   // always be in sync
   char * fname;
   DisassemblyToMoves * disassemble;
+  Separation * disassembleTree;  // the tree of disassemble, a copy as the solution may unload its own
   SolveThread *assmThread;
   bool SolutionEmpty;
   bool changed;
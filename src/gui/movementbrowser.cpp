@@ -179,7 +179,7 @@ LTreeBrowser::Node * movementBrowser_c::addNode(LTreeBrowser::Node *nd, disassem
    */
   for (int i = 0; i < nd->children(); i++) {
     if (*(((nodeData_s*)(nd->child(i)->user_data()))->node) == *mv) {
-      delete mv;
+      mv->destroy();
       return nd->child(i);
     }
   }
@@ -192,7 +192,7 @@ LTreeBrowser::Node * movementBrowser_c::addNode(LTreeBrowser::Node *nd, disassem
     if (std::fabs(mv->getX(i)) > 10000 ||
         std::fabs(mv->getY(i)) > 10000 ||
         std::fabs(mv->getZ(i)) > 10000) {
-      delete mv;
+      mv->destroy();
       return 0;
     }
 
@@ -323,7 +323,7 @@ void movementBrowser_c::cb_AddMovement() {
     z = -z;
   }
 
-  disassemblerNode_c * n = new disassemblerNode_c(s->pieces.size(), s->node, 0, 0);
+  disassemblerNode_c * n = disassemblerNode_c::create(s->pieces.size(), s->node, 0, 0);
 
   for (unsigned int i = 0; i < s->pieces.size(); i++)
     if (dlg.pieceSelected(i))
@@ -348,7 +348,7 @@ void movementBrowser_c::addSpecificMovement(unsigned int piece, int x, int y, in
   nodeData_s * s = (nodeData_s *)(nd->user_data());
   if (!s) return;
 
-  disassemblerNode_c * n = new disassemblerNode_c(s->pieces.size(), s->node, 0, 0);
+  disassemblerNode_c * n = disassemblerNode_c::create(s->pieces.size(), s->node, 0, 0);
 
   for (unsigned int i = 0; i < s->pieces.size(); i++)
     if (piece == i)
@@ -508,9 +508,9 @@ movementBrowser_c::movementBrowser_c(Problem * puzzle, unsigned int solNum) : LF
   nodeData_s * dat = new nodeData_s;
   nodes.push_back(dat);
 
-  Assembly * assembly = puz->getSolution(solNum)->getAssembly();
+  const Assembly * assembly = puz->getSolution(solNum)->getAssembly();
 
-  dat->node = new disassemblerNode_c(assembly);
+  dat->node = disassemblerNode_c::create(0, assembly);
   dat->node->incRefCount();
 
   /* create pieces field. This field contains the
@@ -533,7 +533,7 @@ movementBrowser_c::~movementBrowser_c() {
 
   /* we have to delete from the end because otherwise we delete nodes that others point to */
   for (unsigned int i = 0; i < nodes.size(); i++) {
-    delete nodes[nodes.size()-1-i]->node;
+    nodes[nodes.size()-1-i]->node->destroy();
     delete nodes[nodes.size()-1-i];
   }
 }
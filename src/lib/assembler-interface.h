@@ -25,6 +25,8 @@
  * contains the classes used for the assembler
  */
 
+#include <vector>
+
 class Voxel;
 class Assembly;
 class Problem;
@@ -116,6 +118,17 @@ class AssemblerInterface {
    */
   virtual unsigned int getReducePiece(void) const { return 0; }
 
+  /**
+   * A finer progress report for reduce: the number of placements checked and the
+   * number of placements there are to check. Reduce works in rounds until nothing more
+   * can be removed, both numbers are for the current round. total is 0 when the
+   * assembler doesn't provide this information.
+   *
+   * createMatrix and reduce also use the threads set with setThreads, so call that
+   * before createMatrix
+   */
+  virtual void getReduceProgress(unsigned int *checked, unsigned int *total) const { *checked = *total = 0; }
+
   /** start the assembly process.
    * it is intended that the assembly process runs in a different thread from
    * the controlling thread. When this is the case the controlling thread can
@@ -124,6 +137,40 @@ class AssemblerInterface {
    */
   virtual void assemble(AssemblerCallbackInterface * /*callback*/) {}
 
+  /**
+   * Use several threads for the assembly process.
+   *
+   * threads is the number of threads to use, splitDepth is the level of the
+   * search tree where the search is split into independent subtrees that are
+   * searched in parallel, 0 lets the assembler choose. The callback still sees each
+   * assembly once and is never called by 2 threads at the same time.
+   *
+   * it is not necessary for an assembler to implement this function, it then
+   * simply keeps on using one thread
+   */
+  virtual void setThreads(unsigned int /*threads*/, unsigned int /*splitDepth*/ = 0) {}
+
+  /**
+   * Split the search into parts that can be searched independently, e.g. on
+   * different computers.
+   *
+   * The search tree is explored down to the first level that contains at least
+   * the given number of subtrees and these subtrees are then grouped into parts
+   * of consecutive subtrees. Returns the number of parts, this might be less than requested,
+   * or 0 when the assembler can not split its search.
+   * The function must be called instead of assemble on a fresh assembler
+   *
+   * it is not necessary for an assembler to implement this function
+   */
+  virtual unsigned int splitSearch(unsigned int /*parts*/) { return 0; }
+
+  /**
+   * after splitSearch, this puts the assembler at the start of the given part.
+   * The position saved then only covers this part, an assembler that continues
+   * from this position finishes at the end of the part
+   */
+  virtual void selectPart(unsigned int /*part*/) {}
+
   /**
    * this function returns a number reflecting the complexity of the
    * puzzle. This could be the number of placements tried, or
@@ -138,6 +185,14 @@ class AssemblerInterface {
    */
   virtual float getFinished(void) const { return 0; }
 
+  /**
+   * append the current level of the search tree, that is the number of pieces
+   * placed, for each thread that is currently searching. This is called
+   * while assemble is running and is only used for statistics, so the
+   * values may be slightly off
+   */
+  virtual void getSearchDepths(std::vector<unsigned int> * /*depths*/) const {}
+
   /** stops the assembly process sometimes in the near future. */
   virtual void stop() {}
 
@@ -0,0 +1,427 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "assembler-thread-pool.h"
+
+#include "assembler-interface.h"
+#include "assembly.h"
+#include "bt_assert.h"
+
+AssemblerTask::~AssemblerTask(void) {
+  for (unsigned int i = 0; i < found.size(); i++)
+    delete found[i];
+}
+
+AssemblerThreadPool::AssemblerThreadPool(unsigned int win) :
+    callback(0), abort(0), windowSize(win), next(0),
+    delivering(false), failed(false),
+    noMoreTasks(false), stopped(false), active(false),
+    committed(-1), iterations(0) {
+}
+
+AssemblerThreadPool::~AssemblerThreadPool(void) {
+
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    noMoreTasks = true;
+    stopLocked();
+  }
+
+  threads.join_all();
+
+  for (unsigned int i = 0; i < workers.size(); i++)
+    delete workers[i];
+
+  for (unsigned int i = 0; i < window.size(); i++)
+    delete window[i];
+
+  for (unsigned int i = 0; i < ready.size(); i++)
+    delete ready[i];
+}
+
+void AssemblerThreadPool::begin(AssemblerCallbackInterface *cb, const bool *ab) {
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  bt_assert(!active);
+  bt_assert(window.empty());
+  bt_assert(ready.empty());
+
+  callback = cb;
+  abort = ab;
+  next = 0;
+  noMoreTasks = false;
+  stopped = false;
+  active = true;
+  failed = false;
+  committed = -1;
+}
+
+void AssemblerThreadPool::addWorker(AssemblerWorker *w) {
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  workers.push_back(w);
+  threads.create_thread(boost::bind(&AssemblerThreadPool::work, this, w));
+}
+
+void AssemblerThreadPool::stopLocked(void) {
+
+  if (stopped) return;
+
+  stopped = true;
+
+  for (unsigned int i = 0; i < workers.size(); i++)
+    workers[i]->stop();
+
+  cond.notify_all();
+}
+
+void AssemblerThreadPool::failLocked(const assert_exception &a) {
+
+  // only the first exception is kept, the others are most likely a result of it
+  if (!failed) {
+    failed = true;
+    error = a;
+  }
+
+  stopLocked();
+}
+
+void AssemblerThreadPool::stop(void) {
+  boost::mutex::scoped_lock lock(mutex);
+  stopLocked();
+}
+
+bool AssemblerThreadPool::addTask(AssemblerTask *t) {
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  /* the flag of the assembler is not protected by our mutex, so
+   * we can not be woken up when it changes, poll it instead
+   */
+  while (!stopped && !*abort && (window.size() >= windowSize))
+    cond.timed_wait(lock, boost::posix_time::milliseconds(100));
+
+  if (*abort)
+    stopLocked();
+
+  if (stopped) {
+    delete t;
+    return false;
+  }
+
+  window.push_back(t);
+  cond.notify_all();
+
+  return true;
+}
+
+void AssemblerThreadPool::assembly(AssemblerTask *t, Assembly *a) {
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  // only the first task in the window may hand its assemblies over
+  // directly, all others need to wait until the tasks before them are done
+  if (window.front() != t) {
+    t->found.push_back(a);
+    return;
+  }
+
+  /* don't get too far ahead of the thread that hands over the assemblies
+   * when the callback is slower than the search
+   */
+  while (delivering && (ready.size() >= windowSize))
+    cond.wait(lock);
+
+  ready.push_back(a);
+
+  deliver(lock);
+}
+
+void AssemblerThreadPool::addAssembly(Assembly *a) {
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  // an empty task that is already done takes the assembly, so that it
+  // is handed over in the right place
+  AssemblerTask *t = new AssemblerTask();
+  t->state = AssemblerTask::TS_DONE;
+  t->found.push_back(a);
+
+  if (!window.empty()) {
+    t->before = window.back()->before + window.back()->weight;
+  } else if (committed >= 0) {
+    t->before = committed;
+  }
+
+  window.push_back(t);
+
+  commit();
+  deliver(lock);
+}
+
+void AssemblerThreadPool::commit(void) {
+
+  while (!window.empty() && (window.front()->state == AssemblerTask::TS_DONE)) {
+
+    AssemblerTask *t = window.front();
+
+    ready.insert(ready.end(), t->found.begin(), t->found.end());
+    t->found.clear();
+
+    committed = t->before + t->weight;
+
+    window.pop_front();
+    // the tasks of the master might not have been seen by a worker
+    if (next > 0) next--;
+    delete t;
+  }
+
+  /* the new first task might have found assemblies while it was waiting
+   * for the tasks before it, these can now be handed over, they are before
+   * all the assemblies the task will find from now on
+   */
+  if (!window.empty()) {
+
+    AssemblerTask *t = window.front();
+
+    ready.insert(ready.end(), t->found.begin(), t->found.end());
+    t->found.clear();
+  }
+}
+
+void AssemblerThreadPool::deliver(boost::mutex::scoped_lock &lock) {
+
+  /* the thread that is handing over assemblies will also take the ones
+   * we added, as it only stops once ready is empty
+   */
+  if (delivering)
+    return;
+
+  delivering = true;
+
+  while (!ready.empty()) {
+
+    // after a failure nobody is interested in the assemblies any more
+    if (failed) {
+      for (unsigned int i = 0; i < ready.size(); i++)
+        delete ready[i];
+      ready.clear();
+      break;
+    }
+
+    std::vector<Assembly *> batch(ready.begin(), ready.end());
+    ready.clear();
+    cond.notify_all();
+
+    lock.unlock();
+
+    unsigned int i = 0;
+
+    try {
+      for (; i < batch.size(); i++)
+        callback->assembly(batch[i]);
+    }
+    catch (const assert_exception &a) {
+
+      // the one that failed belongs to the callback
+      for (i++; i < batch.size(); i++)
+        delete batch[i];
+
+      lock.lock();
+      failLocked(a);
+      continue;
+    }
+
+    lock.lock();
+  }
+
+  delivering = false;
+  cond.notify_all();
+}
+
+void AssemblerThreadPool::work(AssemblerWorker *w) {
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  while (true) {
+
+    while (!stopped && !noMoreTasks && (next >= window.size()))
+      cond.wait(lock);
+
+    if (stopped || (next >= window.size()))
+      break;
+
+    AssemblerTask *t = window[next++];
+
+    // tasks of the master are done already
+    if (t->state != AssemblerTask::TS_QUEUED)
+      continue;
+
+    t->state = AssemblerTask::TS_RUNNING;
+    t->worker = w;
+
+    lock.unlock();
+
+    bool done = false;
+    bool ok = true;
+    assert_exception ae;
+
+    try {
+      done = w->run(t);
+    }
+    catch (const assert_exception &a) {
+      ae = a;
+      ok = false;
+    }
+
+    lock.lock();
+
+    if (!ok)
+      failLocked(ae);
+
+    t->state = done ? AssemblerTask::TS_DONE : AssemblerTask::TS_STOPPED;
+    t->worker = 0;
+
+    commit();
+    deliver(lock);
+
+    cond.notify_all();
+  }
+}
+
+void AssemblerThreadPool::finish(void) {
+
+  {
+    boost::mutex::scoped_lock lock(mutex);
+
+    noMoreTasks = true;
+    cond.notify_all();
+
+    while (!stopped && !window.empty()) {
+      cond.timed_wait(lock, boost::posix_time::milliseconds(100));
+
+      if (*abort)
+        stopLocked();
+    }
+  }
+
+  threads.join_all();
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  for (unsigned int i = 0; i < workers.size(); i++) {
+    iterations += workers[i]->getIterations();
+    delete workers[i];
+  }
+  workers.clear();
+
+  active = false;
+
+  if (failed) {
+
+    for (unsigned int i = 0; i < window.size(); i++)
+      delete window[i];
+    window.clear();
+    next = 0;
+
+    failed = false;
+    throw error;
+  }
+}
+
+AssemblerTask *AssemblerThreadPool::getFirstUnfinished(void) {
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  bt_assert(!active);
+
+  AssemblerTask *t = 0;
+
+  if (!window.empty()) {
+    t = window.front();
+    window.pop_front();
+  }
+
+  for (unsigned int i = 0; i < window.size(); i++)
+    delete window[i];
+
+  window.clear();
+  next = 0;
+
+  return t;
+}
+
+bool AssemblerThreadPool::isActive(void) const {
+  boost::mutex::scoped_lock lock(mutex);
+  return active;
+}
+
+float AssemblerThreadPool::getFinished(void) const {
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  float erg = committed;
+
+  if (erg < 0)
+    erg = window.empty() ? 0 : window.front()->before;
+
+  for (unsigned int i = 0; i < window.size(); i++) {
+    switch (window[i]->state) {
+      case AssemblerTask::TS_DONE:
+        erg += window[i]->weight;
+        break;
+      case AssemblerTask::TS_RUNNING:
+        erg += window[i]->weight * window[i]->worker->getFinished();
+        break;
+      default:
+        break;
+    }
+  }
+
+  return erg;
+}
+
+unsigned long AssemblerThreadPool::getIterations(void) const {
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  unsigned long erg = iterations;
+
+  for (unsigned int i = 0; i < workers.size(); i++)
+    erg += workers[i]->getIterations();
+
+  return erg;
+}
+
+void AssemblerThreadPool::getDepths(std::vector<unsigned int> *depths) const {
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  for (unsigned int i = 0; i < window.size(); i++)
+    if (window[i]->state == AssemblerTask::TS_RUNNING)
+      depths->push_back(window[i]->worker->getDepth());
+}
+
+void AssemblerThreadPool::clearIterations(void) {
+  boost::mutex::scoped_lock lock(mutex);
+  iterations = 0;
+}
@@ -0,0 +1,288 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#ifndef __ASSEMBLER_THREAD_POOL_H__
+#define __ASSEMBLER_THREAD_POOL_H__
+
+/** \file assembler-thread-pool.h
+ * contains the helper classes that let an assembler search on several threads
+ */
+
+#include "bt_assert.h"
+
+#include <boost/thread.hpp>
+
+#include <vector>
+#include <deque>
+
+class Assembly;
+class AssemblerCallbackInterface;
+class AssemblerWorker;
+
+/**
+ * One independent subtree of the search of an assembler.
+ *
+ * The assembler derives from this class and adds whatever it needs to
+ * restore the search state for the subtree (e.g. the rows selected
+ * above the split level)
+ */
+class AssemblerTask {
+
+ public:
+
+  AssemblerTask(void) : before(0), weight(0), state(TS_QUEUED), worker(0) {}
+
+  /** frees the assemblies that have not been handed to the callback */
+  virtual ~AssemblerTask(void);
+
+  /** the fraction of the complete search tree that comes before this subtree */
+  float before;
+
+  /** the fraction of the complete search tree inside this subtree */
+  float weight;
+
+ private:
+
+  friend class AssemblerThreadPool;
+
+  enum {
+    TS_QUEUED,     ///< waiting for a worker
+    TS_RUNNING,    ///< a worker is searching the subtree
+    TS_DONE,       ///< the subtree has been searched completely
+    TS_STOPPED     ///< the search was stopped, the task contains the position where it stood
+  } state;
+
+  /** the worker that is currently processing this task */
+  AssemblerWorker *worker;
+
+  /** assemblies found, that can not yet be given to the callback */
+  std::vector<Assembly *> found;
+
+  // no copying and assigning
+  AssemblerTask(const AssemblerTask &);
+  void operator=(const AssemblerTask &);
+};
+
+/**
+ * One worker of the pool.
+ *
+ * The assembler derives from this class. Each worker has its own
+ * copy of all the data the search modifies and is only ever used
+ * by one thread
+ */
+class AssemblerWorker {
+
+ public:
+
+  AssemblerWorker(void) {}
+  virtual ~AssemblerWorker(void) {}
+
+  /**
+   * search the subtree of the given task.
+   * Return true when the subtree was searched completely, false
+   * when the search was stopped. In that case the task must
+   * be updated so that it contains the current position of the search
+   */
+  virtual bool run(AssemblerTask *t) = 0;
+
+  /** make run return as soon as possible, this is called from another thread */
+  virtual void stop(void) = 0;
+
+  /** the fraction of the subtree of the current task that has been searched */
+  virtual float getFinished(void) const = 0;
+
+  /** the number of iterations this worker did in total */
+  virtual unsigned long getIterations(void) const = 0;
+
+  /** the current level in the search tree, only used for statistics */
+  virtual unsigned int getDepth(void) const { return 0; }
+
+ private:
+
+  // no copying and assigning
+  AssemblerWorker(const AssemblerWorker &);
+  void operator=(const AssemblerWorker &);
+};
+
+/**
+ * A pool of threads that searches subtrees of an assembler search.
+ *
+ * The assembler (running in the master thread) enumerates the subtrees
+ * in the order the single threaded search would visit them and adds them
+ * with addTask. The worker threads take the next waiting task as soon as
+ * they are idle, so the load is balanced automatically.
+ *
+ * Assemblies found by the workers are handed to the callback strictly in
+ * task order. The assemblies of the first unfinished task are handed over right
+ * away, the assemblies of later tasks are kept until all tasks before them are done.
+ * So the callback sees the same sequence of assemblies as with the single
+ * threaded search, it is never called by 2 threads at the same time,
+ * and when the search is stopped the position of the first unfinished task
+ * is a position the single threaded search can continue from.
+ *
+ * The callback is not called with the mutex of the pool locked, as it may take
+ * long (e.g. disassemble the assembly). The assemblies that are ready are
+ * collected and whichever thread finds no other thread handing over assemblies
+ * does it.
+ *
+ * When a worker or the callback throws an assert_exception the search is stopped
+ * and finish throws the exception in the master thread.
+ *
+ * The pool is used like this: begin, addWorker for each thread, addTask
+ * for each subtree, finish and finally getFirstUnfinished to find out where
+ * to continue. Afterwards the pool can be used again.
+ */
+class AssemblerThreadPool {
+
+ public:
+
+  /** window is the maximal number of tasks that can exist at the same time */
+  AssemblerThreadPool(unsigned int window);
+
+  /** stops and joins the threads and frees all remaining workers and tasks */
+  ~AssemblerThreadPool(void);
+
+  /**
+   * start a new search, callback receives the assemblies, abort points to
+   * the stop flag of the assembler, the pool checks it regularly
+   */
+  void begin(AssemblerCallbackInterface *callback, const bool *abort);
+
+  /** add a worker and start a thread for it, the pool takes over the worker */
+  void addWorker(AssemblerWorker *w);
+
+  /**
+   * add the next task, blocks while the window is full.
+   * The pool takes over the task. When the search is stopped
+   * the task is deleted and false is returned
+   */
+  bool addTask(AssemblerTask *t);
+
+  /** called by the workers for each assembly found within the given task */
+  void assembly(AssemblerTask *t, Assembly *a);
+
+  /**
+   * called by the master thread for assemblies it finds itself, they come after
+   * all tasks added so far. This works also after the search has been stopped
+   */
+  void addAssembly(Assembly *a);
+
+  /**
+   * tell the pool that no more tasks will come and wait until all tasks are done
+   * or the search has been stopped, afterwards all worker threads are finished and
+   * the workers are deleted. When a worker failed with an assert_exception, the
+   * remaining tasks are deleted and the exception is thrown
+   */
+  void finish(void);
+
+  /** make all workers stop as soon as possible */
+  void stop(void);
+
+  /**
+   * after finish this returns the first task that has not been finished, or 0
+   * if there is none. The caller takes over the task. All other remaining
+   * tasks are deleted
+   */
+  AssemblerTask *getFirstUnfinished(void);
+
+  /** true between begin and the end of finish */
+  bool isActive(void) const;
+
+  /** the fraction of the complete search tree that has been searched */
+  float getFinished(void) const;
+
+  /** the iterations done by the workers */
+  unsigned long getIterations(void) const;
+
+  /** append the current search level of each worker that is working on a task */
+  void getDepths(std::vector<unsigned int> *depths) const;
+
+  /** reset the iteration counter, used when the assembler takes over the value */
+  void clearIterations(void);
+
+  /**
+   * mutex for workers that need to access data that is shared between all of them
+   * and that is not safe to be accessed concurrently
+   */
+  boost::mutex &getSharedMutex(void) { return shared; }
+
+ private:
+
+  /** the thread function for each worker */
+  void work(AssemblerWorker *w);
+
+  /** move the assemblies of finished tasks at the front of the window to ready, mutex must be locked */
+  void commit(void);
+
+  /**
+   * hand the assemblies in ready to the callback, unless another thread is already
+   * doing that, the lock is released while the callback runs
+   */
+  void deliver(boost::mutex::scoped_lock &lock);
+
+  /** remember the exception and stop the search, mutex must be locked */
+  void failLocked(const assert_exception &a);
+
+  /** stop the workers, mutex must be locked */
+  void stopLocked(void);
+
+  AssemblerCallbackInterface *callback;
+  const bool *abort;
+  unsigned int windowSize;
+
+  /** the tasks that are queued or running or done but not yet handed over */
+  std::deque<AssemblerTask *> window;
+
+  /** index into window of the next task to hand out to a worker */
+  unsigned int next;
+
+  /** assemblies that can be handed to the callback, in the right order */
+  std::deque<Assembly *> ready;
+
+  /** a thread is currently handing over assemblies */
+  bool delivering;
+
+  /** a worker or the callback did throw, the exception is in error */
+  bool failed;
+  assert_exception error;
+
+  bool noMoreTasks;
+  bool stopped;
+  bool active;
+
+  /** end of the last task handed over, negative when there was none */
+  float committed;
+
+  /** iterations of workers that have been deleted already */
+  unsigned long iterations;
+
+  std::vector<AssemblerWorker *> workers;
+  boost::thread_group threads;
+
+  mutable boost::mutex mutex;
+  boost::condition_variable cond;
+  boost::mutex shared;
+
+  // no copying and assigning
+  AssemblerThreadPool(const AssemblerThreadPool &);
+  void operator=(const AssemblerThreadPool &);
+};
+
+#endif
@@ -690,25 +690,50 @@ bool Assembly::smallerRotationExists(const Problem *puz,
       // find out if the whole arrangement can be shifted to the lower positions
       // if that is the case we don't keep the stuff
 
+      // a shift moves all placements by the same amount, so the placement that is
+      // compared first decides: if its transformation is larger than ours no shift
+      // will make tmp smaller, if it is smaller every shift does, otherwise
+      // only the shifts up to the one that moves it onto our placement can
+      const Placement &tp = tmp.placements[pivot < placements.size() ? pivot : 0];
+      const Placement &op = placements[pivot < placements.size() ? pivot : 0];
+
+      if (tp.transformation > op.transformation)
+        continue;
+
+      bool allShifts = tp.transformation < op.transformation;
+      int mx = op.xpos - tp.xpos;
+      int my = op.ypos - tp.ypos;
+      int mz = op.zpos - tp.zpos;
+
       // now we create a voxel space of the given assembly shape/ and shift that one around
       Voxel *assm = tmp.createSpace(puz);
       const Voxel *res = puz->getResultShape();
 
+      // the shifts are tried in the same order as placements are compared, so
+      // the first shift where the assembly fits gives the smallest tmp
+      bool done = false;
+
       for (int x = (int) res->boundX1() - (int) assm->boundX1();
-           (int) assm->boundX2() + x <= (int) res->boundX2(); x++)
+           !done && (int) assm->boundX2() + x <= (int) res->boundX2(); x++)
         for (int y = (int) res->boundY1() - (int) assm->boundY1();
-             (int) assm->boundY2() + y <= (int) res->boundY2(); y++)
+             !done && (int) assm->boundY2() + y <= (int) res->boundY2(); y++)
           for (int z = (int) res->boundZ1() - (int) assm->boundZ1();
-               (int) assm->boundZ2() + z <= (int) res->boundZ2(); z++) {
+               !done && (int) assm->boundZ2() + z <= (int) res->boundZ2(); z++) {
+
+            if (!allShifts && ((x > mx) || ((x == mx) && ((y > my) || ((y == my) && (z > mz)))))) {
+              done = true;
+              break;
+            }
+
             if (assm->onGrid(x, y, z)) {
               bool fits = true;
 
-              for (int pz = (int) assm->boundZ1(); pz <= (int) assm->boundZ2();
+              for (int pz = (int) assm->boundZ1(); fits && pz <= (int) assm->boundZ2();
                    pz++)
                 for (int py = (int) assm->boundY1();
-                     py <= (int) assm->boundY2(); py++)
+                     fits && py <= (int) assm->boundY2(); py++)
                   for (int px = (int) assm->boundX1();
-                       px <= (int) assm->boundX2(); px++) {
+                       fits && px <= (int) assm->boundX2(); px++) {
                     if (
                       // the piece can not be place if the result is empty and the piece is filled at a given voxel
                         ((assm->getState(px, py, pz) == Voxel::VX_FILLED) &&
@@ -744,11 +769,8 @@ bool Assembly::smallerRotationExists(const Problem *puz,
                   return true;
                 }
 
-                for (unsigned int i = 0; i < tmp.placements.size(); i++) {
-                  tmp.placements[i].xpos -= x;
-                  tmp.placements[i].ypos -= y;
-                  tmp.placements[i].zpos -= z;
-                }
+                // all the other shifts result in larger assemblies
+                done = true;
               }
             }
           }
@@ -839,7 +861,7 @@ Voxel *Assembly::createSpace(const Problem *puz) const {
 
       Voxel *pc = puz->getGridType()->getVoxel(puz->getShapeShape(j));
 
-      bt_assert(pc->transform(placements[i].transformation));
+      bt_assert2(pc->transform(placements[i].transformation));
 
       int dx = (int) placements[i].xpos - (int) pc->getHx();
       int dy = (int) placements[i].ypos - (int) pc->getHy();
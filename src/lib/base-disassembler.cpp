@@ -28,7 +28,12 @@
 #include "assembly.h"
 #include "disassembly.h"
 
-BaseDisassembler::BaseDisassembler(const Problem *puz) :
+/* the maximal number of sub problems that are remembered, when there are more
+ * the memory is cleared and we start over
+ */
+#define SUBPROBLEM_LIMIT 20000
+
+BaseDisassembler::BaseDisassembler(const Problem *puz, movementCache_c *cache) :
     DisassemblerInterface(), puzzle(puz) {
 
   /* initialize the grouping class */
@@ -46,7 +51,15 @@ BaseDisassembler::BaseDisassembler(const Problem *puz) :
     for (unsigned int j = 0; j < puz->getShapeMax(i); j++)
       piece2shape[p++] = i;
 
-  analyse = new movementAnalysator_c(puzzle);
+  analyse = new movementAnalysator_c(puzzle, cache);
+
+  countOnly = false;
+  countMark = new Separation(0, 0, std::vector<unsigned int>());
+
+  useSubProblems = true;
+  for (unsigned int i = 0; i < puz->partNumber(); i++)
+    if (puz->getShapeGroupNumber(i))
+      useSubProblems = false;
 }
 
 BaseDisassembler::~BaseDisassembler() {
@@ -54,19 +67,26 @@ BaseDisassembler::~BaseDisassembler() {
   delete[] piece2shape;
 
   delete analyse;
+
+  for (std::map<std::vector<int>, Separation *>::iterator i = subProblems.begin(); i != subProblems.end(); i++)
+    if (i->second != countMark)
+      delete i->second;
+
+  delete countMark;
 }
 
 /* create all the necessary parameters for one of the two possible subproblems
  * our current problems divides into
  */
-static void create_new_params(const disassemblerNode_c *st,
+static void create_new_params(disassemblerNodeArena *arena,
+                              const disassemblerNode_c *st,
                               disassemblerNode_c **n,
                               std::vector<unsigned int> &pn,
                               const std::vector<unsigned int> &pieces,
                               int part,
                               bool cond) {
 
-  *n = new disassemblerNode_c(part);
+  *n = disassemblerNode_c::create(arena, part);
 
   int num = 0;
   int dx, dy, dz;
@@ -106,15 +126,89 @@ Separation *BaseDisassembler::checkSubproblem(int pieceCount,
 
     disassemblerNode_c *n;
     std::vector<unsigned int> pn;
-    create_new_params(st, &n, pn, pieces, pieceCount, left);
-    res = disassemble_rec(pn, n);
+    create_new_params(&arena, st, &n, pn, pieces, pieceCount, left);
+    res = solveSubproblem(pn, n);
+
+    *ok = res || subProbGrouping(pn);
+  }
+
+  return res;
+}
+
+/* disassemble the sub problem, or take the result from the last time
+ * the same sub problem came up. n is released
+ */
+Separation *BaseDisassembler::solveSubproblem(const std::vector<unsigned int> &pn,
+                                              disassemblerNode_c *n) {
+
+  if (!useSubProblems) {
+    Separation *res = disassemble_rec(pn, n);
 
     if (n->decRefCount())
-      delete n;
+      n->destroy();
 
-    *ok = res || subProbGrouping(pn);
+    return res;
   }
 
+  int x = n->getX(0);
+  int y = n->getY(0);
+  int z = n->getZ(0);
+
+  std::vector<int> key;
+  key.reserve(5 * pn.size());
+
+  for (unsigned int i = 0; i < pn.size(); i++) {
+    key.push_back(pn[i]);
+    key.push_back(n->getTrans(i));
+    key.push_back(n->getX(i) - x);
+    key.push_back(n->getY(i) - y);
+    key.push_back(n->getZ(i) - z);
+  }
+
+  std::map<std::vector<int>, Separation *>::iterator i = subProblems.find(key);
+
+  /* when the sub problem was solved by disassemblable we only know that it can be
+   * disassembled, so for disassemble it needs to be solved again
+   */
+  if ((i != subProblems.end()) && (countOnly || (i->second != countMark))) {
+
+    if (n->decRefCount())
+      n->destroy();
+
+    if (!i->second)
+      return 0;
+
+    if (countOnly)
+      return countMark;
+
+    Separation *res = new Separation(i->second);
+    res->shiftPieces(x, y, z);
+    return res;
+  }
+
+  Separation *res = disassemble_rec(pn, n);
+
+  if (n->decRefCount())
+    n->destroy();
+
+  if (subProblems.size() >= SUBPROBLEM_LIMIT) {
+    for (i = subProblems.begin(); i != subProblems.end(); i++)
+      if (i->second != countMark)
+        delete i->second;
+    subProblems.clear();
+  }
+
+  Separation *save = 0;
+
+  if (res == countMark) {
+    save = countMark;
+  } else if (res) {
+    save = new Separation(res);
+    save->shiftPieces(-x, -y, -z);
+  }
+
+  subProblems[key] = save;
+
   return res;
 }
 
@@ -162,7 +256,12 @@ Separation *BaseDisassembler::checkSubproblems(const disassemblerNode_c *st,
   /* if both subproblems are either trivial or solvable, return the
    * result, otherwise return 0
    */
-  if (remove_ok && left_ok) {
+  if (remove_ok && left_ok && countOnly) {
+
+    /* nobody wants to see the tree, so we don't need to build it */
+    erg = countMark;
+
+  } else if (remove_ok && left_ok) {
 
     /* both subproblems are solvable -> construct tree */
     erg = new Separation(left, remove, pieces);
@@ -198,8 +297,8 @@ Separation *BaseDisassembler::checkSubproblems(const disassemblerNode_c *st,
     /* one of the subproblems was unsolvable in this case the whole
      * puzzle is unsolvable, so we can as well stop here
      */
-    if (left) delete left;
-    if (remove) delete remove;
+    if (left && !countOnly) delete left;
+    if (remove && !countOnly) delete remove;
   }
 
   return erg;
@@ -239,13 +338,31 @@ bool BaseDisassembler::subProbGrouping(const std::vector<unsigned int> &pn) {
 
 Separation *BaseDisassembler::disassemble(const Assembly *assembly) {
 
+  countOnly = false;
+
+  return disassembleAssembly(assembly);
+}
+
+bool BaseDisassembler::disassemblable(const Assembly *assembly) {
+
+  countOnly = true;
+
+  bool res = disassembleAssembly(assembly) != 0;
+
+  countOnly = false;
+
+  return res;
+}
+
+Separation *BaseDisassembler::disassembleAssembly(const Assembly *assembly) {
+
   bt_assert(puzzle->pieceNumber() == assembly->placementCount());
   groups->reSet();
 
-  disassemblerNode_c *start = new disassemblerNode_c(assembly);
+  disassemblerNode_c *start = disassemblerNode_c::create(&arena, assembly);
 
   if (start->getPiecenumber() < 2) {
-    delete start;
+    start->destroy();
     return 0;
   }
 
@@ -262,7 +379,10 @@ Separation *BaseDisassembler::disassemble(const Assembly *assembly) {
   Separation *s = disassemble_rec(pieces, start);
 
   if (start->decRefCount())
-    delete start;
+    start->destroy();
+
+  /* all nodes of this disassembly are gone now, so the memory can be reused */
+  arena.reset();
 
   return s;
 }
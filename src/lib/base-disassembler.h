@@ -23,13 +23,16 @@
 
 #include "disassembler-interface.h"
 #include "movementanalysator.h"
+#include "disassemblernode.h"
 
 #include <vector>
+#include <map>
 
 class grouping_c;
 class Problem;
 class disassemblerNode_c;
 class Assembly;
+class movementCache_c;
 
 /**
  * this class is a baseclass for disassemblers.
@@ -72,6 +75,43 @@ class BaseDisassembler : public DisassemblerInterface {
    */
   movementAnalysator_c *analyse;
 
+  /**
+   * the memory for the nodes of the disassemblies
+   */
+  disassemblerNodeArena arena;
+
+  /**
+   * The results of already analysed sub problems.
+   *
+   * Many assemblies of a puzzle contain the same sub assemblies, so the same
+   * sub problems come up again and again. The key contains for each piece
+   * of the sub problem the piece number, the transformation and the position
+   * relative to the first piece. The separations are saved with the first
+   * piece at (0; 0; 0), a null pointer means that the sub problem can not
+   * be disassembled.
+   *
+   * This is only used when the puzzle has no piece groups because with groups
+   * the result of a sub problem depends on the sub problems that were
+   * checked before
+   */
+  std::map<std::vector<int>, Separation *> subProblems;
+  bool useSubProblems;
+
+  /**
+   * True while disassemblable is running.
+   *
+   * In this mode no disassembly sequence is created, all the functions
+   * that return a separation return countMark instead when the pieces
+   * can be separated. countMark is never deleted by them
+   */
+  bool countOnly;
+  Separation *countMark;
+
+  Separation *disassembleAssembly(const Assembly *assembly);
+
+  Separation *solveSubproblem(const std::vector<unsigned int> &pn,
+                              disassemblerNode_c *n);
+
   unsigned short subProbGroup(const disassemblerNode_c *st,
                               const std::vector<unsigned int> &pn,
                               bool cond);
@@ -113,8 +153,10 @@ class BaseDisassembler : public DisassemblerInterface {
    * construct the disassembler for this concrete problem.
    * The problem can not be changed, once you done that but
    * you can analyse many assemblies for disassembability
+   *
+   * cache is the movement cache to use, see movementAnalysator_c
    */
-  BaseDisassembler(const Problem *puz);
+  BaseDisassembler(const Problem *puz, movementCache_c *cache = 0);
   ~BaseDisassembler(void);
 
   /**
@@ -128,6 +170,14 @@ class BaseDisassembler : public DisassemblerInterface {
    */
   Separation *disassemble(const Assembly *assembly);
 
+  /**
+   * Check if the assembly can be disassembled.
+   *
+   * This runs the same search as disassemble, but without creating the
+   * disassembly sequence
+   */
+  bool disassemblable(const Assembly *assembly);
+
  private:
 
   // no copying and assigning
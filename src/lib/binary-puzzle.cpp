@@ -0,0 +1,194 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "binary-puzzle.h"
+
+#include "puzzle.h"
+#include "problem.h"
+
+#include "../tools/xml.h"
+#include "../tools/mappedfile.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <memory>
+
+static const char binaryMagic[4] = { 'B', 'T', 'P', 'Z' };
+static const uint32_t binaryVersion = 1;
+
+/* the size of the header without the table and of one table entry */
+static const unsigned int headerSize = 12;
+static const unsigned int entrySize = 24;
+
+static void put(std::vector<unsigned char> &buf, uint64_t v, unsigned int bytes) {
+  for (unsigned int i = 0; i < bytes; i++)
+    buf.push_back(v >> (8 * i));
+}
+
+static uint64_t get(const unsigned char *data, unsigned int bytes) {
+  uint64_t v = 0;
+  for (unsigned int i = 0; i < bytes; i++)
+    v |= (uint64_t)data[i] << (8 * i);
+  return v;
+}
+
+bool isBinaryPuzzle(const char *fname) {
+
+  std::ifstream in(fname, std::ios::binary);
+
+  char magic[sizeof(binaryMagic)];
+
+  return in.read(magic, sizeof(magic)) && memcmp(magic, binaryMagic, sizeof(magic)) == 0;
+}
+
+bool saveBinaryPuzzle(const Puzzle *p, const char *fname) {
+
+  std::ofstream out(fname, std::ios::binary | std::ios::trunc);
+
+  if (!out)
+    return false;
+
+  /* the table is written at the end, when the positions are known */
+  typedef struct {
+    uint32_t type;
+    uint32_t index;
+    uint64_t pos;
+    uint64_t size;
+  } section;
+
+  std::vector<section> sections;
+
+  sections.push_back(section{BIN_PUZZLE, 0, 0, 0});
+
+  for (unsigned int i = 0; i < p->problemNumber(); i++)
+    if (p->getProblem(i)->solutionNumber())
+      sections.push_back(section{BIN_SOLUTIONS, i, 0, 0});
+
+  std::vector<unsigned char> header(binaryMagic, binaryMagic + sizeof(binaryMagic));
+  put(header, binaryVersion, 4);
+  put(header, sections.size(), 4);
+  header.resize(headerSize + entrySize * sections.size());
+
+  out.write((const char *)&header[0], header.size());
+
+  for (unsigned int s = 0; s < sections.size(); s++) {
+
+    sections[s].pos = out.tellp();
+
+    if (sections[s].type == BIN_PUZZLE) {
+      XmlWriter xml(out);
+      p->save(xml, false);
+    } else
+      p->getProblem(sections[s].index)->saveBinarySolutions(out);
+
+    sections[s].size = (uint64_t)out.tellp() - sections[s].pos;
+  }
+
+  header.resize(headerSize);
+
+  for (unsigned int s = 0; s < sections.size(); s++) {
+    put(header, sections[s].type, 4);
+    put(header, sections[s].index, 4);
+    put(header, sections[s].pos, 8);
+    put(header, sections[s].size, 8);
+  }
+
+  out.seekp(0);
+  out.write((const char *)&header[0], header.size());
+
+  return (bool)out;
+}
+
+Puzzle *loadBinaryPuzzle(const char *fname, unsigned int window) {
+
+  std::shared_ptr<MappedFile> map = std::make_shared<MappedFile>();
+
+  if (!map->open(fname))
+    return 0;
+
+  const unsigned char *data = map->getData();
+  uint64_t size = map->getSize();
+
+  if (size < headerSize ||
+      memcmp(data, binaryMagic, sizeof(binaryMagic)) != 0 ||
+      get(data + 4, 4) != binaryVersion)
+    return 0;
+
+  uint64_t count = get(data + 8, 4);
+
+  if (count > (size - headerSize) / entrySize)
+    return 0;
+
+  // check the table and find the puzzle
+  const unsigned char *puzzleEntry = 0;
+
+  for (unsigned int s = 0; s < count; s++) {
+
+    const unsigned char *entry = data + headerSize + entrySize * s;
+
+    uint64_t pos = get(entry + 8, 8);
+    uint64_t len = get(entry + 16, 8);
+
+    if (pos > size || len > size - pos)
+      return 0;
+
+    if (get(entry, 4) == BIN_PUZZLE)
+      puzzleEntry = entry;
+  }
+
+  if (!puzzleEntry)
+    return 0;
+
+  std::istringstream str(std::string((const char *)data + get(puzzleEntry + 8, 8), get(puzzleEntry + 16, 8)));
+  XmlParser pars(str);
+
+  Puzzle *p = new Puzzle(pars);
+
+  try {
+
+    for (unsigned int s = 0; s < count; s++) {
+
+      const unsigned char *entry = data + headerSize + entrySize * s;
+
+      if (get(entry, 4) != BIN_SOLUTIONS)
+        continue;
+
+      uint64_t index = get(entry + 4, 4);
+
+      if (index >= p->problemNumber() || p->getProblem(index)->solutionNumber()) {
+        delete p;
+        return 0;
+      }
+
+      if (!p->getProblem(index)->loadBinarySolutions(map, get(entry + 8, 8), get(entry + 16, 8), window)) {
+        delete p;
+        return 0;
+      }
+    }
+  }
+
+  catch (...) {
+    delete p;
+    throw;
+  }
+
+  return p;
+}
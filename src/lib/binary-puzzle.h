@@ -0,0 +1,63 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#ifndef __BINARY_PUZZLE_H__
+#define __BINARY_PUZZLE_H__
+
+/** \file binary-puzzle.h
+ * load and save puzzles in the binary format.
+ *
+ * The binary format is a companion to the XML format for puzzles with lots of
+ * solutions. Loading one maps the file and only reads the positions of the
+ * solutions, a solution is unpacked when it is used.
+ *
+ * All values are little endian. The file starts with the 4 bytes "BTPZ", the version and
+ * the number of sections as 32 bit values followed by the table of sections. Each
+ * entry has the type and the index of the section as 32 bit values and the position in the
+ * file and the size of the section as 64 bit values. The sections are:
+ *
+ * - BIN_PUZZLE the puzzle without solutions as XML, that is the grid type, the shapes, the
+ *   problems with the states of their assemblers and so on. This part is small and
+ *   quickly loaded, so it keeps the format that all the classes already know
+ * - BIN_SOLUTIONS the solutions of the problem with the index of the section, see
+ *   Problem::saveBinarySolutions. There is one for every problem with solutions
+ */
+
+class Puzzle;
+
+enum {
+  BIN_PUZZLE = 1,
+  BIN_SOLUTIONS = 2
+};
+
+/** check, if the file is a binary puzzle file */
+bool isBinaryPuzzle(const char *fname);
+
+/** save the puzzle in the binary format, returns false when the file can not be written */
+bool saveBinaryPuzzle(const Puzzle *p, const char *fname);
+
+/**
+ * load a binary puzzle file, returns 0 when the file can not be read or is not
+ * a binary puzzle file. An invalid puzzle throws the exceptions of the XML loader.
+ * The solutions keep window of them unpacked, see Problem::setSolutionSpill
+ */
+Puzzle *loadBinaryPuzzle(const char *fname, unsigned int window = 1000);
+
+#endif
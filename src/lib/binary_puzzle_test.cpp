@@ -0,0 +1,226 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "binary-puzzle.h"
+#include "puzzle.h"
+#include "problem.h"
+#include "solution.h"
+#include "packing.h"
+
+#include "../tools/xml.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <cstdio>
+
+/* 3 cubes in a line, 2 solutions, one of them with a disassembly that
+ * has a sub separation
+ */
+static const char *testPuzzle =
+  "<?xml version=\"1.0\"?>\n"
+  "<puzzle version=\"2\">\n"
+  "  <gridType type=\"0\"/>\n"
+  "  <colors/>\n"
+  "  <shapes>\n"
+  "    <voxel x=\"3\" y=\"1\" z=\"1\" type=\"0\">###</voxel>\n"
+  "    <voxel x=\"1\" y=\"1\" z=\"1\" type=\"0\">#</voxel>\n"
+  "  </shapes>\n"
+  "  <problems>\n"
+  "    <problem state=\"2\" assemblies=\"2\" solutions=\"1\" time=\"3\">\n"
+  "      <shapes>\n"
+  "        <shape id=\"1\" count=\"3\"/>\n"
+  "      </shapes>\n"
+  "      <result id=\"0\"/>\n"
+  "      <bitmap/>\n"
+  "      <solutions>\n"
+  "        <solution>\n"
+  "          <assembly>0 0 0 0 1 0 0 0 2 0 0 0</assembly>\n"
+  "          <separation>\n"
+  "            <pieces count=\"3\">0 1 2</pieces>\n"
+  "            <state><dx>0 1 2</dx><dy>0 0 0</dy><dz>0 0 0</dz></state>\n"
+  "            <state><dx>0 1 3</dx><dy>0 0 0</dy><dz>0 0 0</dz></state>\n"
+  "            <state><dx>0 1 30002</dx><dy>0 0 0</dy><dz>0 0 0</dz></state>\n"
+  "            <separation type=\"left\">\n"
+  "              <pieces count=\"2\">0 1</pieces>\n"
+  "              <state><dx>0 1</dx><dy>0 0</dy><dz>0 0</dz></state>\n"
+  "              <state><dx>0 -30000</dx><dy>0 0</dy><dz>0 0</dz></state>\n"
+  "            </separation>\n"
+  "          </separation>\n"
+  "        </solution>\n"
+  "        <solution asmNum=\"1\">\n"
+  "          <assembly>2 0 0 0 1 0 0 0 0 0 0 0</assembly>\n"
+  "        </solution>\n"
+  "      </solutions>\n"
+  "    </problem>\n"
+  "  </problems>\n"
+  "</puzzle>\n";
+
+static const char *testFile = "binary_puzzle_test.btpz";
+
+static std::string toXml(const Puzzle *p) {
+
+  std::ostringstream str;
+
+  {
+    XmlWriter xml(str);
+    p->save(xml);
+  }
+
+  return str.str();
+}
+
+static std::vector<char> readFile(const char *name) {
+
+  std::ifstream in(name, std::ios::binary);
+
+  return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const char *name, const std::vector<char> &data) {
+
+  std::ofstream out(name, std::ios::binary | std::ios::trunc);
+  out.write(&data[0], data.size());
+}
+
+static uint64_t getValue(const std::vector<char> &data, unsigned int pos, unsigned int bytes) {
+  uint64_t v = 0;
+  for (unsigned int i = 0; i < bytes; i++)
+    v |= (uint64_t)(unsigned char)data[pos + i] << (8 * i);
+  return v;
+}
+
+static void setValue(std::vector<char> &data, unsigned int pos, uint64_t v, unsigned int bytes) {
+  for (unsigned int i = 0; i < bytes; i++)
+    data[pos + i] = v >> (8 * i);
+}
+
+/* load the changed file, the puzzle must not be loaded */
+static bool rejected(const std::vector<char> &data) {
+
+  writeFile(testFile, data);
+
+  std::unique_ptr<Puzzle> p(loadBinaryPuzzle(testFile, 2));
+
+  return !p;
+}
+
+BOOST_AUTO_TEST_CASE( binary_puzzle_test )
+{
+  std::istringstream str(testPuzzle);
+  XmlParser pars(str);
+  Puzzle orig(pars);
+
+  std::string xml = toXml(&orig);
+
+  BOOST_REQUIRE( saveBinaryPuzzle(&orig, testFile));
+  BOOST_REQUIRE( isBinaryPuzzle(testFile));
+
+  {
+    std::unique_ptr<Puzzle> p(loadBinaryPuzzle(testFile, 2));
+    BOOST_REQUIRE( p);
+    BOOST_CHECK( p->getProblem(0)->solutionNumber() == 2);
+    BOOST_CHECK( p->getProblem(0)->getSolution(0)->getDisassembly());
+    BOOST_CHECK( toXml(p.get()) == xml);
+  }
+
+  const std::vector<char> data = readFile(testFile);
+
+  // the header with the table of the 2 sections, the puzzle and the solutions
+  BOOST_REQUIRE( data.size() > 12 + 2 * 24);
+  BOOST_REQUIRE( getValue(data, 8, 4) == 2);
+  BOOST_REQUIRE( getValue(data, 12 + 24, 4) == BIN_SOLUTIONS);
+
+  const unsigned int solTable = 12 + 24;
+  const uint64_t solPos = getValue(data, solTable + 8, 8);
+  const uint64_t solSize = getValue(data, solTable + 16, 8);
+
+  BOOST_REQUIRE( solPos + solSize == data.size());
+
+  // the solutions start with their number, the first one with its assembly and
+  // solution number, the length of the record and the number of placements
+  BOOST_REQUIRE( data[solPos] == 2);
+  BOOST_REQUIRE( data[solPos + 1] == 0 && data[solPos + 2] == 0);
+  BOOST_REQUIRE( data[solPos + 3] < (int)solSize - 4);
+  BOOST_REQUIRE( data[solPos + 4] == 3);
+
+  std::vector<char> bad;
+
+  bad = data;
+  bad[0] = 'X';
+  BOOST_CHECK( rejected(bad));
+
+  bad = data;
+  setValue(bad, 4, 2, 4);
+  BOOST_CHECK( rejected(bad));
+
+  bad = data;
+  setValue(bad, 8, 0xFFFFFFFF, 4);
+  BOOST_CHECK( rejected(bad));
+
+  bad = data;
+  bad.resize(solTable);
+  BOOST_CHECK( rejected(bad));
+
+  // sections outside of the file
+  bad = data;
+  setValue(bad, solTable + 8, data.size() + 1, 8);
+  BOOST_CHECK( rejected(bad));
+
+  bad = data;
+  setValue(bad, solTable + 16, solSize + 1, 8);
+  BOOST_CHECK( rejected(bad));
+
+  bad = data;
+  setValue(bad, solTable + 8, 0xFFFFFFFFFFFFFFF0ull, 8);
+  BOOST_CHECK( rejected(bad));
+
+  // a section that ends within a record
+  bad = data;
+  setValue(bad, solTable + 16, solSize - 1, 8);
+  BOOST_CHECK( rejected(bad));
+
+  // more solutions than there are
+  bad = data;
+  bad[solPos] = 3;
+  BOOST_CHECK( rejected(bad));
+
+  // a record that is longer than the section, the section is the number of
+  // solutions followed by the 2 numbers and the length of each record
+  bad = data;
+  bad[solPos + 3] = 0x7F;
+  BOOST_CHECK( rejected(bad));
+
+  // damaged records are found when the solution is used
+  bad = data;
+  bad[solPos + 5] = 200;
+  writeFile(testFile, bad);
+
+  {
+    std::unique_ptr<Puzzle> p(loadBinaryPuzzle(testFile, 2));
+    BOOST_REQUIRE( p);
+    BOOST_CHECK_THROW( p->getProblem(0)->getSolution(0)->getAssembly(), packException_c);
+    BOOST_CHECK( p->getProblem(0)->getSolution(1)->getAssembly());
+  }
+
+  std::remove(testFile);
+}
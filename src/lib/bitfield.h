@@ -59,6 +59,12 @@ class bitfield_c {
     memcpy(field, orig.field, 8 * ((bits + 63) / 64));
   }
 
+  /// assignment, goes with the copy constructor
+  bitfield_c<bits> &operator=(const bitfield_c<bits> &orig) {
+    memcpy(field, orig.field, 8 * ((bits + 63) / 64));
+    return *this;
+  }
+
   /// get a bit
   bool get(uint16_t pos) const {
     bt_assert(pos < bits);
@@ -83,7 +89,7 @@ class bitfield_c {
   }
 
   /// check, if at least one bit is set to 1
-  bool notNull() {
+  bool notNull() const {
     for (int i = 0; i < ((bits + 63) / 64); i++)
       if (field[i] > 0)
         return true;
@@ -216,6 +222,53 @@ class bitfield_c {
     return res;
   }
 
+  /**
+   * bitwise and of this bitfield with the inverse of the 2nd bitfield,
+   * so all the bits set in right are cleared
+   */
+  const bitfield_c<bits> andNot(const bitfield_c<bits> &right) const {
+    bitfield_c<bits> res;
+
+    for (int i = 0; i < ((bits + 63) / 64); i++)
+      res.field[i] = field[i] & ~right.field[i];
+
+    return res;
+  }
+
+  /**
+   * find the first set bit at or after position pos,
+   * -1 is returned when there is no such bit
+   */
+  int findNext(unsigned int pos) const {
+
+    if (pos >= bits)
+      return -1;
+
+    unsigned int i = pos >> 6;
+    uint64_t s = field[i] & (~0ull << (pos & 63));
+
+    while (!s) {
+      i++;
+      if (i >= ((bits + 63) / 64))
+        return -1;
+      s = field[i];
+    }
+
+    int res = i * 64;
+
+    while (!(s & 0xff)) {
+      s >>= 8;
+      res += 8;
+    }
+
+    while (!(s & 1)) {
+      s >>= 1;
+      res++;
+    }
+
+    return (res < bits) ? res : -1;
+  }
+
   /**
    * bitwise or of 2 bitfields
    */
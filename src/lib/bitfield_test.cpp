@@ -94,3 +94,33 @@ BOOST_AUTO_TEST_CASE( bitfield_test )
     BOOST_CHECK( bits.notNull());
     }
 
+
+BOOST_AUTO_TEST_CASE( bitfield_ops_test )
+    {
+        bitfield_c<240> bits;
+        bitfield_c<240> mask;
+
+    BOOST_CHECK( bits.findNext(0) == -1);
+
+    bits.set(3);
+    bits.set(64);
+    bits.set(200);
+
+    BOOST_CHECK( bits.findNext(0) == 3);
+    BOOST_CHECK( bits.findNext(3) == 3);
+    BOOST_CHECK( bits.findNext(4) == 64);
+    BOOST_CHECK( bits.findNext(65) == 200);
+    BOOST_CHECK( bits.findNext(201) == -1);
+    BOOST_CHECK( bits.findNext(240) == -1);
+
+    mask.set(64);
+    mask.set(100);
+
+    bitfield_c<240> res = bits.andNot(mask);
+
+    for (int i = 0; i < 240; i++)
+    if (i == 3 || i == 200)
+    BOOST_CHECK( res.get(i));
+    else
+    BOOST_CHECK( !res.get(i));
+    }
@@ -0,0 +1,533 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "bitset-assembler.h"
+
+#include "bt_assert.h"
+#include "problem.h"
+#include "voxel.h"
+#include "assembler-thread-pool.h"
+
+#include <climits>
+#include <algorithm>
+
+/* marks nodes and columns of the matrix that have no row or column in the bitsets */
+#define NO_INDEX UINT_MAX
+
+/* the number of bits set in a word */
+static inline unsigned int popcount(uint64_t s) {
+#ifdef __GNUC__
+  return __builtin_popcountll(s);
+#else
+  s -= ((s >> 1) & 0x5555555555555555ll);
+  s = (((s >> 2) & 0x3333333333333333ll) + (s & 0x3333333333333333ll));
+  s = (((s >> 4) + s) & 0x0f0f0f0f0f0f0f0fll);
+  s += (s >> 8);
+  s += (s >> 16);
+  s += (s >> 32);
+
+  return s & 0x7f;
+#endif
+}
+
+/* the position of the lowest set bit of a word that is not 0 */
+static inline unsigned int lowestBit(uint64_t s) {
+#ifdef __GNUC__
+  return __builtin_ctzll(s);
+#else
+  unsigned int res = 0;
+
+  while (!(s & 0xff)) {
+    s >>= 8;
+    res += 8;
+  }
+
+  while (!(s & 1)) {
+    s >>= 1;
+    res++;
+  }
+
+  return res;
+#endif
+}
+
+BitsetAssembler::BitsetAssembler(void) : DonKnuthAssembler(), rowCount(0), words(0), primaryColumns(0) {
+  // the search uses the bitsets, the nodes are only needed to create them
+  setNodeLayout(NODES_SEPARATE);
+}
+
+BitsetAssembler::BitsetAssembler(const BitsetAssembler *orig) :
+    DonKnuthAssembler(orig),
+    rowCount(orig->rowCount), words(orig->words),
+    columnNode(orig->columnNode), columnIndex(orig->columnIndex),
+    primaryColumns(orig->primaryColumns),
+    columnRows(orig->columnRows), columnFirst(orig->columnFirst), columnLast(orig->columnLast),
+    rowColumns(orig->rowColumns), rowStart(orig->rowStart),
+    entryColumn(orig->entryColumn), entryNode(orig->entryNode),
+    nodeRow(orig->nodeRow),
+    activeRows(orig->activeRows), activeFirst(orig->activeFirst), activeLast(orig->activeLast),
+    openColumns(orig->openColumns) {
+}
+
+DonKnuthAssembler *BitsetAssembler::clone(void) const {
+  return new BitsetAssembler(this);
+}
+
+bool BitsetAssembler::canHandle(const Problem *p) {
+
+  if (!DonKnuthAssembler::canHandle(p) || !p->resultValid())
+    return false;
+
+  return p->pieceNumber() +
+      p->getResultShape()->countState(Voxel::VX_FILLED) +
+      p->getResultShape()->countState(Voxel::VX_VARIABLE) <= BITSET_ASSEMBLER_COLUMNS;
+}
+
+BitsetAssembler::errState BitsetAssembler::createMatrix(const Problem *puz,
+                                                        bool keepMirror,
+                                                        bool keepRotations,
+                                                        bool comp) {
+
+  if (!canHandle(puz))
+    return ERR_PUZZLE_UNHANDABLE;
+
+  errState err = DonKnuthAssembler::createMatrix(puz, keepMirror, keepRotations, comp);
+
+  if (err == ERR_NONE)
+    build();
+
+  return err;
+}
+
+void BitsetAssembler::reduce(void) {
+
+  DonKnuthAssembler::reduce();
+
+  build();
+}
+
+void BitsetAssembler::build(void) {
+
+  /* the columns, the order is important, the search must select the same columns
+   * as the search on the matrix and that takes the first column in the header
+   * list with the smallest number of rows
+   */
+  columnNode.clear();
+  columnIndex.assign(varivoxelEnd + 1, NO_INDEX);
+
+  for (unsigned int c = right[0]; c; c = right[c]) {
+    columnIndex[c] = columnNode.size();
+    columnNode.push_back(c);
+  }
+
+  primaryColumns = columnNode.size();
+
+  for (unsigned int c = right[varivoxelEnd]; c != varivoxelEnd; c = right[c]) {
+    columnIndex[c] = columnNode.size();
+    columnNode.push_back(c);
+  }
+
+  bt_assert(columnNode.size() <= BITSET_ASSEMBLER_COLUMNS);
+
+  /* the rows, they are in the same order as in the columns of the matrix, there the
+   * rows are sorted by their node number
+   */
+  std::vector<unsigned int> rowNodes;
+
+  for (unsigned int p = 1; p <= piecenumber; p++)
+    for (unsigned int r = down(p); r != p; r = down(r))
+      rowNodes.push_back(r);
+
+  std::sort(rowNodes.begin(), rowNodes.end());
+
+  rowCount = rowNodes.size();
+  words = (rowCount + 63) / 64;
+  if (!words) words = 1;
+
+  rowColumns.assign(rowCount, columnSet());
+  rowStart.clear();
+  entryColumn.clear();
+  entryNode.clear();
+  nodeRow.assign(left.size(), NO_INDEX);
+  columnRows.assign(columnNode.size() * words, 0);
+
+  for (unsigned int r = 0; r < rowCount; r++) {
+
+    rowStart.push_back(entryColumn.size());
+
+    unsigned int j = rowNodes[r];
+    do {
+      unsigned int c = columnIndex[colCount[j]];
+      bt_assert(c != NO_INDEX);
+
+      rowColumns[r].set(c);
+      entryColumn.push_back(c);
+      entryNode.push_back(j);
+      nodeRow[j] = r;
+      columnRows[c * words + (r >> 6)] |= 1ull << (r & 63);
+
+      j = right[j];
+    } while (j != rowNodes[r]);
+  }
+
+  rowStart.push_back(entryColumn.size());
+
+  columnFirst.assign(columnNode.size(), 0);
+  columnLast.assign(columnNode.size(), 0);
+
+  for (unsigned int c = 0; c < columnNode.size(); c++) {
+
+    const uint64_t *cr = &columnRows[c * words];
+
+    unsigned int f = 0;
+    unsigned int l = words;
+
+    while ((f < l) && !cr[f]) f++;
+    while ((l > f) && !cr[l - 1]) l--;
+
+    columnFirst[c] = f;
+    columnLast[c] = l;
+  }
+
+  /* on the first level all rows are possible and all columns open */
+  activeRows.assign((piecenumber + 1) * words, 0);
+  activeFirst.assign(piecenumber + 1, 0);
+  activeLast.assign(piecenumber + 1, 0);
+  openColumns.assign(piecenumber + 1, columnSet());
+
+  for (unsigned int r = 0; r < rowCount; r++)
+    activeRows[r >> 6] |= 1ull << (r & 63);
+
+  activeLast[0] = (rowCount + 63) / 64;
+
+  for (unsigned int c = 0; c < columnNode.size(); c++)
+    openColumns[0].set(c);
+}
+
+void BitsetAssembler::selectRow(unsigned int level, unsigned int row) {
+
+  const uint64_t *from = &activeRows[level * words];
+  uint64_t *to = &activeRows[(level + 1) * words];
+
+  unsigned int f = activeFirst[level];
+  unsigned int l = activeLast[level];
+
+  for (unsigned int i = f; i < l; i++)
+    to[i] = from[i];
+
+  /* all rows that share a column with the selected row are not possible any more */
+  for (unsigned int e = rowStart[row]; e < rowStart[row + 1]; e++) {
+
+    unsigned int c = entryColumn[e];
+    const uint64_t *cr = &columnRows[c * words];
+
+    unsigned int cf = std::max(f, columnFirst[c]);
+    unsigned int cl = std::min(l, columnLast[c]);
+
+    for (unsigned int i = cf; i < cl; i++)
+      to[i] &= ~cr[i];
+  }
+
+  while ((f < l) && !to[f]) f++;
+  while ((l > f) && !to[l - 1]) l--;
+
+  activeFirst[level + 1] = f;
+  activeLast[level + 1] = l;
+
+  openColumns[level + 1] = openColumns[level].andNot(rowColumns[row]);
+}
+
+unsigned int BitsetAssembler::countRows(unsigned int level, unsigned int col, unsigned int limit) const {
+
+  const uint64_t *act = &activeRows[level * words];
+  const uint64_t *cr = &columnRows[col * words];
+
+  unsigned int f = std::max(activeFirst[level], columnFirst[col]);
+  unsigned int l = std::min(activeLast[level], columnLast[col]);
+
+  unsigned int cnt = 0;
+
+  for (unsigned int i = f; (i < l) && (cnt < limit); i++)
+    cnt += popcount(act[i] & cr[i]);
+
+  return cnt;
+}
+
+unsigned int BitsetAssembler::countRowsBefore(unsigned int level, unsigned int col, unsigned int row) const {
+
+  const uint64_t *act = &activeRows[level * words];
+  const uint64_t *cr = &columnRows[col * words];
+
+  unsigned int f = std::max(activeFirst[level], columnFirst[col]);
+  unsigned int l = std::min(activeLast[level], columnLast[col]);
+
+  unsigned int cnt = 0;
+
+  for (unsigned int i = f; (i < l) && (i < (row >> 6)); i++)
+    cnt += popcount(act[i] & cr[i]);
+
+  if (((row >> 6) >= f) && ((row >> 6) < l))
+    cnt += popcount(act[row >> 6] & cr[row >> 6] & ((1ull << (row & 63)) - 1));
+
+  return cnt;
+}
+
+int BitsetAssembler::nextRow(unsigned int level, unsigned int col, unsigned int start) const {
+
+  const uint64_t *act = &activeRows[level * words];
+  const uint64_t *cr = &columnRows[col * words];
+
+  unsigned int f = std::max(activeFirst[level], columnFirst[col]);
+  unsigned int l = std::min(activeLast[level], columnLast[col]);
+
+  unsigned int i = start >> 6;
+
+  if (i < f) {
+    i = f;
+    start = 0;
+  }
+
+  if (i >= l)
+    return -1;
+
+  uint64_t s = act[i] & cr[i] & (~0ull << (start & 63));
+
+  while (!s) {
+    i++;
+    if (i >= l)
+      return -1;
+    s = act[i] & cr[i];
+  }
+
+  return i * 64 + lowestBit(s);
+}
+
+unsigned int BitsetAssembler::rowNode(unsigned int row, unsigned int col) const {
+
+  for (unsigned int e = rowStart[row]; e < rowStart[row + 1]; e++)
+    if (entryColumn[e] == col)
+      return entryNode[e];
+
+  bt_assert(0);
+  return 0;
+}
+
+/* this is the search of DonKnuthAssembler::iterativeMultiSearch with the
+ * matrix operations replaced by the bitset operations. The stack (pos, rows
+ * and columns) contains the same values as there
+ */
+void BitsetAssembler::iterativeMultiSearch(void) {
+
+  bool cont;
+
+  while (!abbort) {
+
+    if ((pos > piecenumber) || (pos < minPos))
+      break;
+
+    if (partEnd.size() && (pos == partEnd.size()) &&
+        std::equal(partEnd.begin(), partEnd.end(), rows)) {
+      uncoverStack();
+      pos = (unsigned int)-1;
+      partEnd.clear();
+      break;
+    }
+
+    // all columns that need to be filled are filled
+    int col = openColumns[pos].findNext(0);
+
+    if ((col < 0) || (col >= (int)primaryColumns))
+      solution();
+
+    if (debug) {
+      if (debug_loops <= 0)
+        break;
+
+      debug_loops--;
+    }
+
+    if (pos == splitDepth) {
+      if ((splitDepth < piecenumber) && !addTask())
+        break;
+      pos--;
+    }
+
+    cont = false;
+    iterations++;
+
+    if (!rows[pos]) {
+
+      /* find the first open column with the smallest number of rows, this
+       * must be the same column as the one the matrix search takes
+       */
+      const columnSet &open = openColumns[pos];
+
+      unsigned int c = 0;
+      unsigned int s = 0;
+
+      col = open.findNext(0);
+
+      if ((col >= 0) && (col < (int)primaryColumns)) {
+
+        c = col;
+        s = countRows(pos, c, UINT_MAX);
+
+        if (s)
+          for (col = open.findNext(col + 1); (col >= 0) && (col < (int)primaryColumns); col = open.findNext(col + 1)) {
+
+            unsigned int cnt = countRows(pos, col, s);
+
+            if (cnt < s) {
+              c = col;
+              s = cnt;
+
+              if (!s)
+                break;
+            }
+          }
+      }
+
+      // there must not be more unfillable variable voxels than holes
+      if (s) {
+        int currentHoles = holes;
+
+        for (col = open.findNext(primaryColumns); col >= 0; col = open.findNext(col + 1))
+          if (!countRows(pos, col, 1)) {
+            if (currentHoles == 0) {
+              s = 0;
+              break;
+            }
+            currentHoles--;
+          }
+      }
+
+      if (s) {
+        columns[pos] = columnNode[c];
+        rows[pos] = rowNode(nextRow(pos, c, 0), c);
+
+        cont = true;
+      }
+
+      if (!cont) {
+        rows[pos] = 0;
+        pos--;
+        continue;
+      }
+
+    } else {
+
+      // continue with the next row of the column
+      unsigned int c = columnIndex[columns[pos]];
+      int r = nextRow(pos, c, nodeRow[rows[pos]] + 1);
+
+      if (r >= 0) {
+        rows[pos] = rowNode(r, c);
+        cont = true;
+      }
+    }
+
+    if (cont) {
+
+      selectRow(pos, nodeRow[rows[pos]]);
+
+      pos++;
+
+    } else {
+
+      rows[pos] = 0;
+      pos--;
+    }
+  }
+}
+
+void BitsetAssembler::coverStack(void) {
+
+  if (pos > piecenumber)
+    return;
+
+  for (unsigned int p = 0; (p <= pos) && (p < piecenumber); p++)
+    if (rows[p]) {
+
+      bt_assert((rows[p] < nodeRow.size()) && (nodeRow[rows[p]] != NO_INDEX));
+      bt_assert((columns[p] < columnIndex.size()) && (columnIndex[columns[p]] != NO_INDEX));
+
+      selectRow(p, nodeRow[rows[p]]);
+    }
+}
+
+void BitsetAssembler::uncoverStack(void) {
+  /* nothing to do, the levels are calculated from the first level, which never changes */
+}
+
+void BitsetAssembler::getFraction(unsigned int depth, float *before, float *weight) const {
+
+  *before = 0;
+  *weight = 1;
+
+  for (unsigned int i = 0; i < depth; i++) {
+
+    unsigned int c = columnIndex[columns[i]];
+    unsigned int cnt = countRows(i, c, UINT_MAX);
+    unsigned int idx = rows[i] ? countRowsBefore(i, c, nodeRow[rows[i]]) : 0;
+
+    if (!cnt) break;
+
+    *before += *weight * idx / cnt;
+    *weight /= cnt;
+  }
+}
+
+float BitsetAssembler::getFinished(void) const {
+
+  /* like for the matrix search there is no locking here, the value
+   * may be a bit off while the search is running
+   */
+
+  if (!rows || !columns || !rowCount)
+    return 0;
+
+  if (pool && pool->isActive())
+    return pool->getFinished();
+
+  float erg = 0;
+
+  if (pos > piecenumber)
+    return 1;
+
+  for (int i = pos - 1; i >= (int)minPos; i--) {
+
+    unsigned int r = rows[i];
+    unsigned int c = columns[i];
+
+    if (!r || (r >= nodeRow.size()) || (nodeRow[r] == NO_INDEX) ||
+        (c >= columnIndex.size()) || (columnIndex[c] == NO_INDEX))
+      continue;
+
+    unsigned int cnt = countRows(i, columnIndex[c], UINT_MAX);
+
+    if (!cnt)
+      continue;
+
+    erg += countRowsBefore(i, columnIndex[c], nodeRow[r]);
+    erg /= cnt;
+  }
+
+  return erg;
+}
@@ -0,0 +1,148 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#ifndef __BITSET_ASSEMBLER_H__
+#define __BITSET_ASSEMBLER_H__
+
+#include "don-knuth-assembler.h"
+#include "bitfield.h"
+
+#include <vector>
+
+/** the maximal number of columns (pieces plus voxels of the result) the bitset assembler can handle */
+#define BITSET_ASSEMBLER_COLUMNS 256
+
+/**
+ * An assembler that searches the matrix using bitsets instead of dancing links.
+ *
+ * The matrix is created and reduced exactly like for DonKnuthAssembler. Afterwards
+ * each row is stored as a bitset of its columns and each column as a bitset of its rows.
+ * For each level of the search there is a bitset of the rows that are still possible
+ * and of the columns that are still open. Placing a piece is then just clearing the rows
+ * of its columns, word by word, and the number of rows of a column is a popcount. For
+ * dense matrices with few columns this is faster than following the links through memory.
+ *
+ * The search visits the nodes of the search tree in exactly the same order as
+ * the search of DonKnuthAssembler. So the same assemblies are found in the same order and the
+ * position is saved in the same format: both assemblers can continue the search of the other.
+ * Threads and split searches work like for DonKnuthAssembler.
+ */
+class BitsetAssembler : public DonKnuthAssembler {
+
+  typedef bitfield_c<BITSET_ASSEMBLER_COLUMNS> columnSet;
+
+  /* the number of rows and the number of 64 bit words of a row bitset */
+  unsigned int rowCount;
+  unsigned int words;
+
+  /* the columns, first the columns that need to be filled in the order of the column
+   * header list of the matrix, then the variable columns. columnNode contains the matrix
+   * column for each of our columns, columnIndex the other way round
+   */
+  std::vector<unsigned int> columnNode;
+  std::vector<unsigned int> columnIndex;
+  unsigned int primaryColumns;
+
+  /* for each column the bitset of its rows and the first and one after the last
+   * word of the bitset that contain a row
+   */
+  std::vector<uint64_t> columnRows;
+  std::vector<unsigned int> columnFirst;
+  std::vector<unsigned int> columnLast;
+
+  /* for each row the set of its columns and for each entry of the row (from rowStart[r]
+   * to rowStart[r+1]) the column and the node of the matrix
+   */
+  std::vector<columnSet> rowColumns;
+  std::vector<unsigned int> rowStart;
+  std::vector<unsigned int> entryColumn;
+  std::vector<unsigned int> entryNode;
+
+  /* the row for each node of the matrix */
+  std::vector<unsigned int> nodeRow;
+
+  /* the state for each level of the search: the rows that are still possible (words
+   * words for each level), the range of words that may contain a row and the columns
+   * that are still open
+   */
+  std::vector<uint64_t> activeRows;
+  std::vector<unsigned int> activeFirst;
+  std::vector<unsigned int> activeLast;
+  std::vector<columnSet> openColumns;
+
+  /* create the bitsets from the matrix, this needs to be done each time
+   * the matrix changed
+   */
+  void build(void);
+
+  /* calculate the rows and columns of the next level when the given row is selected
+   * on this level
+   */
+  void selectRow(unsigned int level, unsigned int row);
+
+  /* the number of possible rows in the column on the given level, counting stops
+   * when limit is reached
+   */
+  unsigned int countRows(unsigned int level, unsigned int col, unsigned int limit) const;
+
+  /* the number of possible rows in the column before the given row */
+  unsigned int countRowsBefore(unsigned int level, unsigned int col, unsigned int row) const;
+
+  /* the first possible row in the column at or after start, -1 if there is none */
+  int nextRow(unsigned int level, unsigned int col, unsigned int start) const;
+
+  /* the node of the matrix for the row in the column */
+  unsigned int rowNode(unsigned int row, unsigned int col) const;
+
+  void iterativeMultiSearch(void);
+  void coverStack(void);
+  void uncoverStack(void);
+  void getFraction(unsigned int depth, float *before, float *weight) const;
+
+  DonKnuthAssembler *clone(void) const;
+
+  /* create a copy of the search data of another assembler, for the worker threads */
+  BitsetAssembler(const BitsetAssembler *orig);
+
+ public:
+
+  BitsetAssembler(void);
+
+  /* functions that are overloaded from AssemblerInterface, for comments see there */
+  errState createMatrix(const Problem *puz,
+                        bool keepMirror,
+                        bool keepRotations,
+                        bool complete);
+  void reduce(void);
+  float getFinished(void) const;
+
+  /* true, when the problem can be handled by DonKnuthAssembler and the number
+   * of columns fits into the bitsets
+   */
+  static bool canHandle(const Problem *p);
+
+ private:
+
+  // no copying and assigning
+  BitsetAssembler(const BitsetAssembler &);
+  void operator=(const BitsetAssembler &);
+};
+
+#endif
@@ -53,6 +53,15 @@ class DisassemblerInterface {
    */
   virtual Separation *disassemble(const Assembly * /*assembly*/) { return 0; }
 
+  /**
+   * Check if an assembly can be disassembled.
+   *
+   * This is for when only the number of disassemblable assemblies is
+   * required. The disassembler doesn't need to create the disassembly
+   * sequence, so this may be quite a bit faster than disassemble
+   */
+  virtual bool disassemblable(const Assembly * /*assembly*/) { return false; }
+
  private:
 
   // no copying and assigning
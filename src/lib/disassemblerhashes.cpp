@@ -22,192 +22,154 @@
 
 #include "disassemblernode.h"
 
-nodeHash::nodeHash() {
+#include "bt_assert.h"
 
-  tab_size = 11;
-  tab_entries = 0;
+#include <string.h>
+
+nodeTable::nodeTable(unsigned int initialBits) : tab_entries(0), bits(initialBits) {
 
-  tab = new disassemblerNode_c *[tab_size];
+  tab_size = 1ul << bits;
+  tab = new entry[tab_size];
 
-  memset(tab, 0, tab_size * sizeof(disassemblerNode_c *));
+  memset(tab, 0, tab_size * sizeof(entry));
 }
 
-nodeHash::~nodeHash() {
+nodeTable::~nodeTable(void) {
   clear();
 
   delete[] tab;
 }
 
-void nodeHash::clear(void) {
-  for (unsigned int i = 0; i < tab_size; i++) {
-    while (tab[i]) {
-      disassemblerNode_c *n = tab[i];
-      tab[i] = n->next;
+void nodeTable::clear(void) {
 
-      if (n->decRefCount())
-        delete n;
-    }
+  if (!tab_entries) return;
+
+  for (unsigned long i = 0; i < tab_size; i++) {
+    disassemblerNode_c *n = tab[i].node;
+
+    if (n && n->decRefCount())
+      n->destroy();
   }
 
+  memset(tab, 0, tab_size * sizeof(entry));
   tab_entries = 0;
 }
 
-const disassemblerNode_c *nodeHash::insert(disassemblerNode_c *n) {
+disassemblerNode_c *nodeTable::find(const disassemblerNode_c *n) const {
 
-  unsigned long h = n->hash() % tab_size;
+  unsigned int h = n->hash();
+  unsigned long mask = tab_size - 1;
+  unsigned long pos = home(h);
 
-  disassemblerNode_c *hn = tab[h];
+  for (unsigned long dist = 0; ; dist++) {
 
-  while (hn) {
-    if (*hn == *n) {
+    const entry &e = tab[pos];
 
-      // let's see, a node for this state already exists, if the found way to this
-      // node is longer than the current way, we replace it with the data of the current
-      // node
-      if (hn->getWaylength() > n->getWaylength())
-        hn->replaceNode(n);
+    /* an empty slot or a node that is closer to its home than we would be
+     * means the node is not in the table, it would have been placed here
+     */
+    if (!e.node || ((pos - home(e.hash)) & mask) < dist)
+      return 0;
 
-      return hn;
-    }
+    if (e.hash == h && *e.node == *n)
+      return e.node;
 
-    hn = hn->next;
+    pos = (pos + 1) & mask;
   }
+}
 
-  /* node not in table, insert */
-  n->incRefCount();
+void nodeTable::place(entry e) {
 
-  n->next = tab[h];
-  tab[h] = n;
+  unsigned long mask = tab_size - 1;
+  unsigned long pos = home(e.hash);
+  unsigned long dist = 0;
 
-  tab_entries++;
-  if (tab_entries > tab_size) {
-    // rehash
-
-    unsigned long new_size = tab_size * 4 + 1;
-
-    disassemblerNode_c **new_tab = new disassemblerNode_c *[new_size];
-    memset(new_tab, 0, new_size * sizeof(disassemblerNode_c *));
-
-    for (unsigned int i = 0; i < tab_size; i++) {
-      while (tab[i]) {
-        disassemblerNode_c *n = tab[i];
-        tab[i] = n->next;
-        unsigned long h = n->hash() % new_size;
-        n->next = new_tab[h];
-        new_tab[h] = n;
-      }
+  while (tab[pos].node) {
+
+    unsigned long d = (pos - home(tab[pos].hash)) & mask;
+
+    /* the node in this slot is closer to its home than the one we place,
+     * so it has to make room and we continue with the node taken out
+     */
+    if (d < dist) {
+      entry t = tab[pos];
+      tab[pos] = e;
+      e = t;
+      dist = d;
     }
 
-    delete[] tab;
-    tab = new_tab;
-    tab_size = new_size;
+    pos = (pos + 1) & mask;
+    dist++;
   }
 
-  return 0;
+  tab[pos] = e;
 }
 
-bool nodeHash::contains(const disassemblerNode_c *n) const {
-  unsigned long h = n->hash() % tab_size;
+void nodeTable::add(disassemblerNode_c *n) {
 
-  disassemblerNode_c *hn = tab[h];
+  /* keep the table at most 3/4 full */
+  if (4 * (tab_entries + 1) > 3 * tab_size) {
 
-  while (hn) {
-    if (*hn == *n)
-      return true;
+    entry *old_tab = tab;
+    unsigned long old_size = tab_size;
 
-    hn = hn->next;
+    bits++;
+    tab_size = 1ul << bits;
+    tab = new entry[tab_size];
+    memset(tab, 0, tab_size * sizeof(entry));
+
+    for (unsigned long i = 0; i < old_size; i++)
+      if (old_tab[i].node)
+        place(old_tab[i]);
+
+    delete[] old_tab;
   }
 
-  return false;
+  entry e;
+  e.hash = n->hash();
+  e.node = n;
+
+  place(e);
+  tab_entries++;
 }
 
-countingNodeHash::countingNodeHash() {
+const disassemblerNode_c *nodeHash::insert(disassemblerNode_c *n) {
 
-  tab_size = 100;
-  tab_entries = 0;
+  disassemblerNode_c *hn = tab.find(n);
 
-  tab = new hashNode *[tab_size];
+  if (hn) {
 
-  memset(tab, 0, tab_size * sizeof(hashNode *));
+    // let's see, a node for this state already exists, if the found way to this
+    // node is longer than the current way, we replace it with the data of the current
+    // node
+    if (hn->getWaylength() > n->getWaylength())
+      hn->replaceNode(n);
 
-  scanPtr = 0;
-  scanActive = false;
+    return hn;
+  }
 
-  linkStart = 0;
-}
+  /* node not in table, insert */
+  n->incRefCount();
+  tab.add(n);
 
-countingNodeHash::~countingNodeHash(void) {
-  clear();
-  delete[] tab;
+  return 0;
 }
 
 /* delete all nodes and empty table for new usage */
 void countingNodeHash::clear(void) {
-  hashNode *hn = linkStart;
-
-  while (hn) {
-    hashNode *hn2 = hn->link;
-
-    if (hn->dat->decRefCount())
-      delete hn->dat;
-
-    delete hn;
-
-    hn = hn2;
-  }
-
-  memset(tab, 0, tab_size * sizeof(hashNode *));
-  tab_entries = 0;
-  linkStart = 0;
+  tab.clear();
+  added.clear();
 }
 
 bool countingNodeHash::insert(disassemblerNode_c *n) {
 
-  unsigned long h = n->hash() % tab_size;
-
-  hashNode *hn = tab[h];
-
-  while (hn) {
-    if (*(hn->dat) == *n)
-      return true;
-
-    hn = hn->next;
-  }
+  if (tab.find(n))
+    return true;
 
   /* node not in table, insert */
   n->incRefCount();
-
-  hn = new hashNode;
-  hn->dat = n;
-
-  hn->next = tab[h];
-  tab[h] = hn;
-
-  hn->link = linkStart;
-  linkStart = hn;
-
-  tab_entries++;
-  if (tab_entries > tab_size) {
-
-    unsigned long new_size = tab_size * 4 + 1;
-
-    hashNode **new_tab = new hashNode *[new_size];
-    memset(new_tab, 0, new_size * sizeof(hashNode *));
-
-    for (unsigned int i = 0; i < tab_size; i++) {
-      while (tab[i]) {
-        hashNode *hn = tab[i];
-        tab[i] = hn->next;
-        unsigned long h = hn->dat->hash() % new_size;
-        hn->next = new_tab[h];
-        new_tab[h] = hn;
-      }
-    }
-
-    delete[] tab;
-    tab = new_tab;
-    tab_size = new_size;
-  }
+  tab.add(n);
+  added.push_back(n);
 
   return false;
 }
@@ -216,7 +178,7 @@ void countingNodeHash::initScan() {
 
   bt_assert(!scanActive);
 
-  scanPtr = linkStart;
+  scanPos = added.size();
   scanActive = true;
 }
 
@@ -224,17 +186,13 @@ const disassemblerNode_c *countingNodeHash::nextScan() {
 
   bt_assert(scanActive);
 
-  if (!scanPtr) {
+  if (!scanPos) {
     scanActive = false;
     return 0;
 
   } else {
 
-    disassemblerNode_c *res = scanPtr->dat;
-    scanPtr = scanPtr->link;
-
-    return res;
+    scanPos--;
+    return added[scanPos];
   }
 }
-
-
@@ -21,36 +21,103 @@
 #ifndef __DISASSEMBLER_HASHES_H__
 #define __DISASSEMBLER_HASHES_H__
 
+#include <vector>
+
 class disassemblerNode_c;
 
 /**
- * This is a hashtable that stores disassemblerNode_c pointer
+ * The table used by the hashtables below to find nodes.
  *
- * The nodes will not become owned by the hashtable, but the table
- * will use the reference counting system of the node
+ * This is an open addressed table: the entries are stored in one flat
+ * array and a node that collides with another one goes into the next free
+ * slot. Each slot contains the hash value of the node together with the
+ * node pointer, so most of the time the nodes themselves only need
+ * to be looked at when the node really is the one searched for.
+ *
+ * The nodes are placed with robin hood hashing: when a node is inserted
+ * and passes a slot whose node is closer to its home slot than the new node
+ * is, the 2 are swapped. This keeps the probe sequences short and a search
+ * for a node that is not in the table can stop as soon as it finds a node
+ * that is closer to its home slot than the searched node would be.
+ *
+ * The table size is always a power of 2. Nodes are never removed from the
+ * table on their own, only the whole table can be emptied.
  */
-class nodeHash {
+class nodeTable {
 
  private:
 
-  /** current table size */
+  /** one slot of the table, node is 0 for empty slots */
+  struct entry {
+    unsigned int hash;
+    disassemblerNode_c *node;
+  };
+
+  /** the table */
+  entry *tab;
+
+  /** current table size, always a power of 2 */
   unsigned long tab_size;
 
   /** current number of entries */
   unsigned long tab_entries;
 
-  /** the hashtable */
-  disassemblerNode_c **tab;
+  /** the number of bits of the slot index, tab_size is 1 << bits */
+  unsigned int bits;
+
+  /** the slot where a node with the given hash value should go */
+  unsigned long home(unsigned int hash) const {
+    /* the lower bits of the hash values are not very well distributed, so mix
+     * the bits by multiplying with a large odd number and use the upper bits
+     */
+    return (unsigned long)((hash * 2654435769u) >> (32 - bits));
+  }
+
+  /** place entry e into the table, there must be space and the node must not be in the table */
+  void place(entry e);
 
  public:
 
-  nodeHash(void);
+  nodeTable(unsigned int initialBits);
 
-  ~nodeHash(void);
+  ~nodeTable(void);
 
-  /** delete all nodes and empty table for new usage */
+  /** remove all nodes from the table, decreasing their reference count */
   void clear(void);
 
+  /** find a node that is equal to n, returns 0, if there is none */
+  disassemblerNode_c *find(const disassemblerNode_c *n) const;
+
+  /** add a node, that is not yet in the table, the reference count is not changed */
+  void add(disassemblerNode_c *n);
+
+ private:
+
+  // no copying and assigning
+  nodeTable(const nodeTable &);
+  void operator=(const nodeTable &);
+};
+
+/**
+ * This is a hashtable that stores disassemblerNode_c pointer
+ *
+ * The nodes will not become owned by the hashtable, but the table
+ * will use the reference counting system of the node
+ */
+class nodeHash {
+
+ private:
+
+  /** the table with the nodes */
+  nodeTable tab;
+
+ public:
+
+  nodeHash(void) : tab(4) {}
+
+  /** delete all nodes and empty table for new usage */
+  void clear(void) { tab.clear(); }
+
   /**
    * add a new node.
    *
@@ -60,7 +127,7 @@ class nodeHash {
   const disassemblerNode_c *insert(disassemblerNode_c *n);
 
   /** check, if a node is in the hashtable */
-  bool contains(const disassemblerNode_c *n) const;
+  bool contains(const disassemblerNode_c *n) const { return tab.find(n) != 0; }
 
  private:
 
@@ -83,44 +150,20 @@ class countingNodeHash {
 
  private:
 
-  /** current table size */
-  unsigned long tab_size;
-  /** current number of entries */
-  unsigned long tab_entries;
-
-  /**
-   * hash node data structur
-   *
-   * this hash table is non intrusive, it stores a pointer
-   * to the disassembler node.
-   *
-   * This is more suitable here because the nodes normally live only
-   * a short time inside this table, while they stay for a very long
-   * time in the other table
-   */
-  struct hashNode {
-    /** the data of the node */
-    disassemblerNode_c *dat;
-    /** next entry in the bucket list */
-    hashNode *next;
-    /** the next entry of the all element link list */
-    hashNode *link;
-  };
+  /** the table with the nodes */
+  nodeTable tab;
 
-  /** the hash table */
-  hashNode **tab;
-  /** pointer to the inverse linked list of all added elements */
-  hashNode *linkStart;
+  /** all added nodes in the order they were added */
+  std::vector<disassemblerNode_c *> added;
 
-  /** current scan position */
-  hashNode *scanPtr;
+  /** current scan position, the scan continues with the node before this index */
+  unsigned long scanPos;
   /** is there a scan active? */
   bool scanActive;
 
  public:
 
-  countingNodeHash(void);
-  ~countingNodeHash(void);
+  countingNodeHash(void) : tab(7), scanPos(0), scanActive(false) {}
 
   /** delete all nodes and empty table for new usage */
   void clear(void);
@@ -22,42 +22,271 @@
 
 #include "assembly.h"
 
+#include <new>
+#include <cstring>
+
+/* the size of the slabs, blocks bigger than a quarter of a slab are allocated on their own */
+#define ARENA_SLAB_SIZE 0x10000
+
+/* the value used in getPositions for the orientation of pieces whose position is not yet known */
+#define UNKNOWN_TRANS 0x7FFF
+
+/* the size of the data of a node with pn pieces, full nodes contain all positions, the others the
+ * 2 vectors and 2 bitmasks
+ */
+static size_t dataSize(unsigned int pn, bool full) {
+  if (full)
+    return 4 * pn * sizeof(int16_t);
+  else
+    return 6 * sizeof(int16_t) + 2 * ((pn + 7) / 8);
+}
+
+/* the size of the memory for a node, rounded up to keep the nodes aligned */
+static size_t nodeSize(unsigned int pn, bool full) {
+  return (sizeof(disassemblerNode_c) + dataSize(pn, full) + 7) & ~(size_t)7;
+}
+
+/* the size class of a node for the arena */
+static unsigned int sizeClass(unsigned int pn, bool full) {
+  return 2 * pn + (full ? 0 : 1);
+}
+
+/* room for the positions of all pieces of a node, on the stack for the usual
+ * number of pieces
+ */
+class positionBuffer {
+
+  int16_t local[4 * 32];
+  std::vector<int16_t> big;
+  int16_t *p;
+
+ public:
+
+  positionBuffer(unsigned int pn) {
+    if (pn <= 32)
+      p = local;
+    else {
+      big.resize(4 * pn);
+      p = &big[0];
+    }
+  }
+
+  operator int16_t *(void) { return p; }
+};
+
+/* the hash value and the comparison for positions, see the hash function and
+ * the comparison operator of the node
+ */
+static unsigned int hashPositions(const int16_t *dat, unsigned int piecenumber) {
+
+  unsigned int h = 0x17fe3b3c;
+
+  // as the zero-th entry of the transformation
+  // is not included in the loop below add it manually
+  h += dat[3];
+
+  for (unsigned int i = 1; i < piecenumber; i++) {
+    h += (dat[4 * i + 0] - dat[0]);
+    h *= 1343;
+    h += (dat[4 * i + 1] - dat[1]);
+    h *= 923;
+    h += (dat[4 * i + 2] - dat[2]);
+    h *= 113;
+    h += (dat[4 * i + 3]);
+    h *= 23;
+  }
+
+  if (h == 0) h = 1;
+
+  return h;
+}
+
+static bool equalPositions(const int16_t *a, const int16_t *b, unsigned int piecenumber) {
+  // as the zero-th entry of the transformation
+  // is not included in the loop below add it manually
+  if (a[3] != b[3]) return false;
+
+  for (unsigned int i = 1; i < piecenumber; i++) {
+    if (a[4 * i + 0] - a[0] != b[4 * i + 0] - b[0]) return false;
+    if (a[4 * i + 1] - a[1] != b[4 * i + 1] - b[1]) return false;
+    if (a[4 * i + 2] - a[2] != b[4 * i + 2] - b[2]) return false;
+    if (a[4 * i + 3] != b[4 * i + 3]) return false;
+  }
+
+  return true;
+}
+
+disassemblerNodeArena::~disassemblerNodeArena(void) {
+  for (unsigned int i = 0; i < slabs.size(); i++)
+    delete[] slabs[i];
+  for (unsigned int i = 0; i < bigBlocks.size(); i++)
+    delete[] bigBlocks[i];
+}
+
+void *disassemblerNodeArena::allocate(size_t size, unsigned int sizeClass) {
+
+  used++;
+
+  /* first try to reuse a freed block */
+  if ((sizeClass < freeBlocks.size()) && freeBlocks[sizeClass]) {
+    void *b = freeBlocks[sizeClass];
+    freeBlocks[sizeClass] = *(void **)b;
+    return b;
+  }
+
+  /* big blocks don't go into the slabs */
+  if (size > ARENA_SLAB_SIZE / 4) {
+    bigBlocks.push_back(new char[size]);
+    return bigBlocks.back();
+  }
+
+  if (size > slabLeft) {
+
+    if (slabPos)
+      currentSlab++;
+
+    if (currentSlab >= slabs.size())
+      slabs.push_back(new char[ARENA_SLAB_SIZE]);
+
+    slabPos = slabs[currentSlab];
+    slabLeft = ARENA_SLAB_SIZE;
+  }
+
+  void *b = slabPos;
+  slabPos += size;
+  slabLeft -= size;
+
+  return b;
+}
+
+void disassemblerNodeArena::release(void *block, unsigned int sizeClass) {
+
+  bt_assert(used > 0);
+  used--;
+
+  if (sizeClass >= freeBlocks.size())
+    freeBlocks.resize(sizeClass + 1, 0);
+
+  *(void **)block = freeBlocks[sizeClass];
+  freeBlocks[sizeClass] = block;
+}
+
+void disassemblerNodeArena::reset(void) {
+
+  if (used)
+    return;
+
+  freeBlocks.clear();
+
+  for (unsigned int i = 0; i < bigBlocks.size(); i++)
+    delete[] bigBlocks[i];
+  bigBlocks.clear();
+
+  currentSlab = 0;
+  slabPos = 0;
+  slabLeft = 0;
+}
+
+void *disassemblerNode_c::allocate(disassemblerNodeArena *ar, unsigned int pn, bool full) {
+  if (ar)
+    return ar->allocate(nodeSize(pn, full), sizeClass(pn, full));
+  else
+    return ::operator new(nodeSize(pn, full));
+}
+
+size_t disassemblerNode_c::dataSize(void) const {
+  return ::dataSize(piecenumber, chain == 0);
+}
+
+disassemblerNode_c *disassemblerNode_c::create(unsigned int pn,
+                                               disassemblerNode_c *comf,
+                                               int _dir,
+                                               int _amount,
+                                               int step) {
+  bt_assert(comf);
+
+  /* when there are already too many difference nodes before this one
+   * this node gets all positions
+   */
+  bool full = comf->chain >= maxChain;
+
+  return new(allocate(comf->arena, pn, full)) disassemblerNode_c(pn, comf, _dir, _amount, step, full);
+}
+
+disassemblerNode_c *disassemblerNode_c::create(disassemblerNodeArena *ar, const Assembly *assm) {
+
+  unsigned int pn = 0;
+
+  for (unsigned int j = 0; j < assm->placementCount(); j++)
+    if (assm->isPlaced(j))
+      pn++;
+
+  return new(allocate(ar, pn, true)) disassemblerNode_c(ar, assm, pn);
+}
+
+disassemblerNode_c *disassemblerNode_c::create(disassemblerNodeArena *ar, unsigned int pn) {
+  return new(allocate(ar, pn, true)) disassemblerNode_c(ar, pn);
+}
+
+void disassemblerNode_c::destroy(void) {
+
+  disassemblerNodeArena *ar = arena;
+  unsigned int sc = sizeClass(piecenumber, chain == 0);
+
+  this->~disassemblerNode_c();
+
+  if (ar)
+    ar->release(this, sc);
+  else
+    ::operator delete(this);
+}
+
 disassemblerNode_c::disassemblerNode_c(unsigned int pn,
                                        disassemblerNode_c *comf,
                                        int _dir,
                                        int _amount,
-                                       int step) :
-    comefrom(comf), piecenumber(pn), dat(new int16_t[4 * piecenumber]),
-    refcount(1), dir(_dir), amount(_amount), hashValue(0) {
+                                       int step,
+                                       bool full) :
+    comefrom(comf), arena(comf->arena),
+    refcount(1), dir(_dir), amount(_amount), hashValue(0), piecenumber(pn) {
   bt_assert(comefrom);
+  bt_assert(pn == comf->piecenumber);
 
   comefrom->incRefCount();
   waylength = comf->waylength + step;
+
+  if (full) {
+    /* start with the positions of the come-from node, set then adds the movement */
+    chain = 0;
+    comefrom->getPositions(dat());
+  } else {
+    chain = comefrom->chain + 1;
+    memset(dat(), 0, dataSize());
+  }
 }
 
-disassemblerNode_c::disassemblerNode_c(unsigned int pn) :
-    comefrom(0), piecenumber(pn), dat(new int16_t[4 * piecenumber]),
-    refcount(1), dir(0), amount(0), hashValue(0), waylength(0) {
+disassemblerNode_c::disassemblerNode_c(disassemblerNodeArena *ar, unsigned int pn) :
+    comefrom(0), arena(ar),
+    refcount(1), dir(0), amount(0), hashValue(0), waylength(0), piecenumber(pn), chain(0) {
+  bt_assert(pn < 0x10000);
 }
 
-disassemblerNode_c::disassemblerNode_c(const Assembly *assm) :
+disassemblerNode_c::disassemblerNode_c(disassemblerNodeArena *ar, const Assembly *assm, unsigned int pn) :
     comefrom(0),
-    piecenumber(0),
+    arena(ar),
     refcount(1),
     dir(0),
     amount(0),
     hashValue(0),
-    waylength(0) {
+    waylength(0),
+    piecenumber(pn),
+    chain(0) {
+  bt_assert(pn < 0x10000);
+
   /* create the first node with the start state
    * here all pieces are at position (0; 0; 0)
-   */
-  for (unsigned int j = 0; j < assm->placementCount(); j++)
-    if (assm->isPlaced(j))
-      piecenumber++;
-
-  dat = new int16_t[4 * piecenumber];
-
-  /* create pieces field. This field contains the
+   *
+   * create pieces field. This field contains the
    * names of all present pieces. Because at the start
    * all pieces are still there we fill the array
    * with all the numbers
@@ -70,20 +299,176 @@ disassemblerNode_c::disassemblerNode_c(const Assembly *assm) :
               abs(assm->getY(j)) < maxMove &&
               abs(assm->getZ(j)) < maxMove);
 
-      dat[4 * pc + 0] = assm->getX(j);
-      dat[4 * pc + 1] = assm->getY(j);
-      dat[4 * pc + 2] = assm->getZ(j);
-      dat[4 * pc + 3] = assm->getTransformation(j);
+      dat()[4 * pc + 0] = assm->getX(j);
+      dat()[4 * pc + 1] = assm->getY(j);
+      dat()[4 * pc + 2] = assm->getZ(j);
+      dat()[4 * pc + 3] = assm->getTransformation(j);
       pc++;
     }
 }
 
 disassemblerNode_c::~disassemblerNode_c() {
 
-  delete[] dat;
-
   if (comefrom && comefrom->decRefCount())
-    delete comefrom;
+    comefrom->destroy();
+}
+
+void disassemblerNode_c::setRemove(unsigned int i, int x, int y, int z) {
+  bt_assert(i < piecenumber);
+  bt_assert(abs(x) < maxMove && abs(y) < maxMove && abs(z) < maxMove);
+
+  if (chain) {
+
+    int16_t *v = dat() + 3;
+
+    /* all pieces must be removed in the same direction */
+    if (v[0] == 0 && v[1] == 0 && v[2] == 0) {
+      v[0] = x;
+      v[1] = y;
+      v[2] = z;
+    } else
+      bt_assert(v[0] == x && v[1] == y && v[2] == z);
+
+    masks()[maskBytes() + (i >> 3)] |= 1 << (i & 7);
+
+  } else {
+
+    dat()[4 * i + 0] = x;
+    dat()[4 * i + 1] = y;
+    dat()[4 * i + 2] = z;
+    dat()[4 * i + 3] = (int16_t) 0xFFFF;
+  }
+
+  hashValue = 0;
+}
+
+void disassemblerNode_c::set(unsigned int i, int tx, int ty, int tz) {
+  bt_assert(i < piecenumber);
+  bt_assert(comefrom);
+
+  if (chain) {
+
+    bt_assert(abs(tx) < maxMove && abs(ty) < maxMove && abs(tz) < maxMove);
+
+    if (tx || ty || tz) {
+
+      int16_t *v = dat();
+
+      /* all pieces must be moved by the same vector */
+      if (v[0] == 0 && v[1] == 0 && v[2] == 0) {
+        v[0] = tx;
+        v[1] = ty;
+        v[2] = tz;
+      } else
+        bt_assert(v[0] == tx && v[1] == ty && v[2] == tz);
+
+      masks()[i >> 3] |= 1 << (i & 7);
+    }
+
+  } else {
+
+    /* the data already contains the position of the come-from node */
+    bt_assert(abs(dat()[4 * i + 0] + tx) < maxMove &&
+        abs(dat()[4 * i + 1] + ty) < maxMove &&
+        abs(dat()[4 * i + 2] + tz) < maxMove);
+
+    dat()[4 * i + 0] += tx;
+    dat()[4 * i + 1] += ty;
+    dat()[4 * i + 2] += tz;
+  }
+
+  hashValue = 0;
+}
+
+int16_t disassemblerNode_c::component(unsigned int i, unsigned int c) const {
+
+  /* walk along the come-from nodes and add up the movements of the piece until we
+   * either find a node where it was removed or a node with all positions
+   */
+  int16_t v = 0;
+  const disassemblerNode_c *n = this;
+
+  while (n->chain) {
+
+    if (n->isRemoved(i))
+      return (c == 3) ? (int16_t) 0xFFFF : (int16_t)(v + n->dat()[3 + c]);
+
+    if (n->isMoved(i) && c < 3)
+      v += n->dat()[c];
+
+    n = n->comefrom;
+  }
+
+  return (c == 3) ? n->dat()[4 * i + 3] : (int16_t)(v + n->dat()[4 * i + c]);
+}
+
+void disassemblerNode_c::getPositions(int16_t *pos) const {
+
+  if (!chain) {
+    memcpy(pos, dat(), 4 * piecenumber * sizeof(int16_t));
+    return;
+  }
+
+  /* add up the movements of all pieces along the come-from nodes, pieces that are
+   * found to be removed get their position from that node, the others once
+   * the node with all positions is reached
+   */
+  for (unsigned int i = 0; i < piecenumber; i++) {
+    pos[4 * i + 0] = pos[4 * i + 1] = pos[4 * i + 2] = 0;
+    pos[4 * i + 3] = UNKNOWN_TRANS;
+  }
+
+  unsigned int bytes = maskBytes();
+  const disassemblerNode_c *n = this;
+
+  while (n->chain) {
+
+    const uint8_t *m = n->masks();
+    const int16_t *v = n->dat();
+
+    for (unsigned int b = 0; b < bytes; b++) {
+
+      if (m[bytes + b])
+        for (unsigned int i = 8 * b; i < 8 * b + 8; i++)
+          if (((m[bytes + b] >> (i & 7)) & 1) && (pos[4 * i + 3] == UNKNOWN_TRANS)) {
+            pos[4 * i + 0] += v[3];
+            pos[4 * i + 1] += v[4];
+            pos[4 * i + 2] += v[5];
+            pos[4 * i + 3] = (int16_t) 0xFFFF;
+          }
+
+      if (m[b])
+        for (unsigned int i = 8 * b; i < 8 * b + 8; i++)
+          if (((m[b] >> (i & 7)) & 1) && (pos[4 * i + 3] == UNKNOWN_TRANS)) {
+            pos[4 * i + 0] += v[0];
+            pos[4 * i + 1] += v[1];
+            pos[4 * i + 2] += v[2];
+          }
+    }
+
+    n = n->comefrom;
+  }
+
+  for (unsigned int i = 0; i < piecenumber; i++)
+    if (pos[4 * i + 3] == UNKNOWN_TRANS) {
+      pos[4 * i + 0] += n->dat()[4 * i + 0];
+      pos[4 * i + 1] += n->dat()[4 * i + 1];
+      pos[4 * i + 2] += n->dat()[4 * i + 2];
+      pos[4 * i + 3] = n->dat()[4 * i + 3];
+    }
+}
+
+void disassemblerNode_c::setDifference(const int16_t *from, const int16_t *to) {
+
+  bt_assert(chain);
+
+  memset(dat(), 0, dataSize());
+
+  for (unsigned int i = 0; i < piecenumber; i++)
+    if (to[4 * i + 3] == (int16_t) 0xFFFF && from[4 * i + 3] != (int16_t) 0xFFFF)
+      setRemove(i, to[4 * i + 0], to[4 * i + 1], to[4 * i + 2]);
+    else
+      set(i, to[4 * i + 0] - from[4 * i + 0], to[4 * i + 1] - from[4 * i + 1], to[4 * i + 2] - from[4 * i + 2]);
 }
 
 void disassemblerNode_c::replaceNode(const disassemblerNode_c *n) {
@@ -93,66 +478,154 @@ void disassemblerNode_c::replaceNode(const disassemblerNode_c *n) {
   bt_assert(piecenumber == n->piecenumber);
   bt_assert(hashValue == n->hashValue);
 
-  memcpy(dat, n->dat, 4 * piecenumber * sizeof(int16_t));
+  if (!chain) {
+
+    /* we have room for all positions, so simply take them */
+    n->getPositions(dat());
+
+  } else if (n->chain) {
+
+    memcpy(dat(), n->dat(), dataSize());
+    chain = n->chain;
+
+  } else {
+
+    /* the other node contains all positions but we only have room for
+     * the difference to its come-from node, which we will have afterwards
+     */
+    bt_assert(n->comefrom);
+
+    positionBuffer from(piecenumber);
+    n->comefrom->getPositions(from);
+
+    unsigned int h = hashValue;
+    setDifference(from, n->dat());
+    hashValue = h;
+
+    chain = (n->comefrom->chain < 254) ? n->comefrom->chain + 1 : 255;
+  }
+
   dir = n->dir;
   amount = n->amount;
   waylength = n->waylength;
 
+  if (n->comefrom)
+    n->comefrom->incRefCount();
+
   if (comefrom && comefrom->decRefCount())
-    delete comefrom;
+    comefrom->destroy();
 
   comefrom = n->comefrom;
-
-  if (comefrom)
-    comefrom->incRefCount();
 }
 
 unsigned int disassemblerNode_c::hash(void) const {
   if (hashValue) return hashValue;
 
-  unsigned int h = 0x17fe3b3c;
+  if (chain) {
+    positionBuffer pos(piecenumber);
+    getPositions(pos);
+    hashValue = hashPositions(pos, piecenumber);
+  } else
+    hashValue = hashPositions(dat(), piecenumber);
 
-  // as the zero-th entry of the transformation
-  // is not included in the loop below add it manually
-  h += dat[3];
+  return hashValue;
+}
 
-  for (unsigned int i = 1; i < piecenumber; i++) {
-    h += (dat[4 * i + 0] - dat[0]);
-    h *= 1343;
-    h += (dat[4 * i + 1] - dat[1]);
-    h *= 923;
-    h += (dat[4 * i + 2] - dat[2]);
-    h *= 113;
-    h += (dat[4 * i + 3]);
-    h *= 23;
+void disassemblerNode_c::applyDifference(int16_t *pos) const {
+
+  bt_assert(chain);
+
+  for (unsigned int i = 0; i < piecenumber; i++)
+    if (isRemoved(i)) {
+      pos[4 * i + 0] = dat()[3];
+      pos[4 * i + 1] = dat()[4];
+      pos[4 * i + 2] = dat()[5];
+      pos[4 * i + 3] = (int16_t) 0xFFFF;
+    } else if (isMoved(i)) {
+      pos[4 * i + 0] += dat()[0];
+      pos[4 * i + 1] += dat()[1];
+      pos[4 * i + 2] += dat()[2];
+    }
+}
+
+void disassemblerNode_c::getPositions(int16_t *pos, const int16_t *comefromPos) const {
+
+  if (!chain) {
+    memcpy(pos, dat(), 4 * piecenumber * sizeof(int16_t));
+    return;
   }
 
-  if (h == 0) h = 1;
+  memcpy(pos, comefromPos, 4 * piecenumber * sizeof(int16_t));
+  applyDifference(pos);
+}
 
-  hashValue = h;
-  return h;
+unsigned int disassemblerNode_c::hash(const int16_t *comefromPos) const {
+  if (hashValue || !chain) return hash();
+
+  positionBuffer pos(piecenumber);
+  getPositions(pos, comefromPos);
+
+  hashValue = hashPositions(pos, piecenumber);
+  return hashValue;
 }
 
 bool disassemblerNode_c::operator==(const disassemblerNode_c &b) const {
-  // as the zero-th entry of the transformation
-  // is not included in the loop below add it manually
-  if (dat[3] != b.dat[3]) return false;
 
-  for (unsigned int i = 1; i < piecenumber; i++) {
-    if (dat[4 * i + 0] - dat[0] != b.dat[4 * i + 0] - b.dat[0]) return false;
-    if (dat[4 * i + 1] - dat[1] != b.dat[4 * i + 1] - b.dat[1]) return false;
-    if (dat[4 * i + 2] - dat[2] != b.dat[4 * i + 2] - b.dat[2]) return false;
-    if (dat[4 * i + 3] != b.dat[4 * i + 3]) return false;
+  if (!chain && !b.chain)
+    return equalPositions(dat(), b.dat(), piecenumber);
+
+  positionBuffer p1(piecenumber);
+  positionBuffer p2(piecenumber);
+
+  if (chain && b.chain && comefrom == b.comefrom) {
+
+    /* for 2 nodes with the same come-from node we only need to collect
+     * the positions of that node once
+     */
+    comefrom->getPositions(p1);
+    memcpy(p2, p1, 4 * piecenumber * sizeof(int16_t));
+    applyDifference(p1);
+    b.applyDifference(p2);
+
+  } else {
+
+    getPositions(p1);
+    b.getPositions(p2);
   }
 
-  return true;
+  return equalPositions(p1, p2, piecenumber);
+}
+
+bool disassemblerNode_c::is_piece_removed(unsigned int nr) const {
+  bt_assert(nr < piecenumber);
+
+  /* once removed a piece stays removed, so look for a node where it was removed */
+  const disassemblerNode_c *n = this;
+
+  while (n->chain) {
+    if (n->isRemoved(nr))
+      return true;
+    n = n->comefrom;
+  }
+
+  return n->dat()[4 * nr + 3] == (int16_t) 0xFFFF;
 }
 
 bool disassemblerNode_c::is_separation() const {
+
+  const disassemblerNode_c *n = this;
+  unsigned int bytes = maskBytes();
+
+  while (n->chain) {
+    for (unsigned int b = 0; b < bytes; b++)
+      if (n->masks()[bytes + b])
+        return true;
+    n = n->comefrom;
+  }
+
   for (unsigned int i = 0; i < piecenumber; i++)
-    if (is_piece_removed(i))
+    if (n->dat()[4 * i + 3] == (int16_t) 0xFFFF)
       return true;
 
   return false;
 }
-
@@ -26,8 +26,69 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#include <vector>
+
 class Assembly;
 
+/**
+ * Memory for disassembler nodes.
+ *
+ * The disassembler creates and frees huge numbers of nodes. Getting each of them
+ * from the heap is slow and wastes memory, so each disassembler has an arena that
+ * hands out the memory for its nodes. The memory is taken in big slabs.
+ * Freed nodes go into a free list for their size class and are reused for the next node
+ * of the same class. Once all nodes are freed, e.g. at the end of
+ * one disassembly, reset makes the whole slabs available again in one go.
+ *
+ * An arena must only be used by one thread at a time.
+ */
+class disassemblerNodeArena {
+
+ private:
+
+  /** the slabs and the free space within the current slab, blocks that
+   * are too big for the slabs are allocated on their own
+   */
+  std::vector<char *> slabs;
+  std::vector<char *> bigBlocks;
+  unsigned int currentSlab;
+  char *slabPos;
+  size_t slabLeft;
+
+  /** the freed blocks for each size class, linked through their first bytes */
+  std::vector<void *> freeBlocks;
+
+  /** the number of blocks in use */
+  unsigned long used;
+
+ public:
+
+  disassemblerNodeArena(void) : currentSlab(0), slabPos(0), slabLeft(0), used(0) {}
+
+  ~disassemblerNodeArena(void);
+
+  /**
+   * get a block of the given size, all blocks of one size class must
+   * have the same size
+   */
+  void *allocate(size_t size, unsigned int sizeClass);
+
+  /** return a block that was got with allocate for the given size class */
+  void release(void *block, unsigned int sizeClass);
+
+  /**
+   * when there are no nodes left, make all memory available for new nodes,
+   * the slabs are kept for the next usage
+   */
+  void reset(void);
+
+ private:
+
+  // no copying and assigning
+  disassemblerNodeArena(const disassemblerNodeArena &);
+  void operator=(const disassemblerNodeArena &);
+};
+
 /**
  * The node structure used by the disassembler.
  *
@@ -40,11 +101,15 @@ class Assembly;
  *
  * The node is used by the disassembler to construct its search tree. As
  * the tree can grow pretty large with a lot of nodes, it is important to
- * keep the node small. There is some possible optimisation available
- * in this node. For example you could save just the direction, amount and
- * pieces involved the transition from the come-from node to this node.
+ * keep the node small. So most nodes don't save the positions of the pieces,
+ * but only the difference to the come-from node: which pieces were moved and
+ * the vector they were moved by, and which pieces were removed and the
+ * direction they were removed in. The positions are calculated from the
+ * come-from nodes when needed.
  *
- * The redundant information could be calculated from the come-from node.
+ * Root nodes and every maxChain-th node along a way contain the positions
+ * of all pieces, so that calculating the positions never has to walk along
+ * more than a few come-from nodes.
  */
 class disassemblerNode_c {
 
@@ -57,6 +122,13 @@ class disassemblerNode_c {
    */
   static const int16_t maxMove = 32767;
 
+  /**
+   * The number of nodes along the come-from nodes that contain a difference.
+   * Once this number gets bigger than this value the new node will contain
+   * all positions
+   */
+  static const unsigned int maxChain = 16;
+
   /**
    * The node that we came from to reach this node.
    * The nodes are used to save the shortest way from the start to each
@@ -66,25 +138,11 @@ class disassemblerNode_c {
   disassemblerNode_c *comefrom;
 
   /**
-   * Number of pieces this node is handling
+   * The arena that contains the memory for this node, or 0 when
+   * the node is on the heap. Nodes created from this node are
+   * put into the same arena
    */
-  unsigned int piecenumber;
-
-  /**
-   * The position and orientation of all involved pieces.
-   *
-   * For more memory performance I will try to limit the
-   * amount of memory required by allocating only one big
-   * chunk of memory with interleaved data
-   * at position x%4 == 0 is x, ==1 is y ==2 is z ==3 is trans
-   *
-   * a piece NOT inside the rest is signified by
-   * trans == 0xFF, the direction the pieces were move out
-   * should be obtained from dir below, when trans is 0xFF
-   * then the data fields also contain the direction, not the
-   * position of the piece
-   */
-  int16_t *dat;
+  disassemblerNodeArena *arena;
 
   /**
    * A reference counter for automatic deletion of the node.
@@ -132,6 +190,80 @@ class disassemblerNode_c {
    */
   unsigned int waylength;
 
+  /**
+   * Number of pieces this node is handling
+   */
+  uint16_t piecenumber;
+
+  /**
+   * The number of nodes that contain only differences from this node up to
+   * and including this node until a node with all positions is found.
+   * 0 for nodes that contain all positions
+   */
+  uint8_t chain;
+
+  /**
+   * The data of the node is directly behind the node within the same block
+   * of memory, this is why nodes can only be created with the create functions.
+   *
+   * When chain is 0 it contains the position and orientation of all
+   * involved pieces as interleaved data: at position x%4 == 0 is x,
+   * ==1 is y ==2 is z ==3 is trans
+   *
+   * a piece NOT inside the rest is signified by
+   * trans == 0xFF, the direction the pieces were move out
+   * should be obtained from dir below, when trans is 0xFF
+   * then the data fields also contain the direction, not the
+   * position of the piece
+   *
+   * When chain is not 0 it contains the vector the moved pieces were moved by,
+   * the direction the removed pieces were removed in and then 2 bitmasks with one bit
+   * per piece: the moved pieces and the removed pieces
+   */
+  int16_t *dat(void) { return reinterpret_cast<int16_t *>(this + 1); }
+  const int16_t *dat(void) const { return reinterpret_cast<const int16_t *>(this + 1); }
+
+  /** the bitmasks of a difference node, first the moved, then the removed pieces */
+  uint8_t *masks(void) { return reinterpret_cast<uint8_t *>(dat() + 6); }
+  const uint8_t *masks(void) const { return reinterpret_cast<const uint8_t *>(dat() + 6); }
+
+  /** the number of bytes of one of the bitmasks of a difference node */
+  unsigned int maskBytes(void) const { return (piecenumber + 7) / 8; }
+
+  bool isMoved(unsigned int i) const { return (masks()[i >> 3] >> (i & 7)) & 1; }
+  bool isRemoved(unsigned int i) const { return (masks()[maskBytes() + (i >> 3)] >> (i & 7)) & 1; }
+
+  /** the size of the data of the node */
+  size_t dataSize(void) const;
+
+  /** calculate the value of piece i, component 0-2 are x-z, 3 is trans, for difference nodes */
+  int16_t component(unsigned int i, unsigned int c) const;
+
+  /** for difference nodes, turn the positions of the come-from node into the positions of this node */
+  void applyDifference(int16_t *pos) const;
+
+  /** for difference nodes, set the data so that the positions turn from "from" into "to" */
+  void setDifference(const int16_t *from, const int16_t *to);
+
+ private:
+
+  /* the constructors for the create functions below */
+  disassemblerNode_c(unsigned int pn,
+                     disassemblerNode_c *comf,
+                     int _dir,
+                     int _amount,
+                     int step,
+                     bool full);
+  disassemblerNode_c(disassemblerNodeArena *ar, const Assembly *assm, unsigned int pn);
+  disassemblerNode_c(disassemblerNodeArena *ar, unsigned int pn);
+
+  ~disassemblerNode_c();
+
+  /* memory for a node with pn pieces from the arena or the heap, full nodes
+   * contain all positions
+   */
+  static void *allocate(disassemblerNodeArena *ar, unsigned int pn, bool full);
+
  public:
 
   /**
@@ -140,21 +272,30 @@ class disassemblerNode_c {
    * Create a new node with the given number of pieces the given come-from pointer
    * and the defined values for direction, amount.
    * Thepsize is added to the waylength of the come-from pointer and the result will be
-   * saved in our waylength value
+   * saved in our waylength value. The node is put into the arena of the come-from node.
+   *
+   * Afterwards the positions of the pieces must be set with set or setRemove
+   * relative to the come-from node, at most once for each piece. All pieces that are
+   * moved must be moved by the same vector and all removed pieces must be removed
+   * in the same direction
    */
-  disassemblerNode_c(unsigned int pn,
-                     disassemblerNode_c *comf,
-                     int _dir,
-                     int _amount,
-                     int step = 1);
+  static disassemblerNode_c *create(unsigned int pn,
+                                    disassemblerNode_c *comf,
+                                    int _dir,
+                                    int _amount,
+                                    int step = 1);
 
-  /** creates a root node from an assembly */
-  disassemblerNode_c(const Assembly *assm);
+  /** creates a root node from an assembly, arena may be 0 to use the heap */
+  static disassemblerNode_c *create(disassemblerNodeArena *ar, const Assembly *assm);
 
-  /** create a new root node with pn pieces */
-  disassemblerNode_c(unsigned int pn);
+  /** create a new root node with pn pieces, arena may be 0 to use the heap */
+  static disassemblerNode_c *create(disassemblerNodeArena *ar, unsigned int pn);
 
-  ~disassemblerNode_c();
+  /**
+   * free the node, this replaces delete. The come-from node is
+   * freed too, when this node was the last one pointing to it
+   */
+  void destroy(void);
 
   /**
    * Replace this node with the information from another node
@@ -174,7 +315,7 @@ class disassemblerNode_c {
    * this function is used by outsiders to free
    * their own pointers to this node.
    *
-   * if the function returs true, delete the node
+   * if the function returs true, destroy the node
    */
   bool decRefCount() {
     bt_assert(refcount > 0);
@@ -198,6 +339,13 @@ class disassemblerNode_c {
    */
   unsigned int hash(void) const;
 
+  /**
+   * Calculate the hash value when the positions of the come-from node are already
+   * known, as returned by getPositions. This saves collecting the positions along
+   * the come-from nodes
+   */
+  unsigned int hash(const int16_t *comefromPos) const;
+
   /**
    * The comparison operations using "normalized" positions.
    * This means all the pieces are shifted so, that the position
@@ -211,27 +359,40 @@ class disassemblerNode_c {
   /** return x-position of piece i */
   int getX(unsigned int i) const {
     bt_assert(i < piecenumber);
-    return dat[4 * i + 0];
+    return chain ? component(i, 0) : dat()[4 * i + 0];
   }
 
   /** return y-position of piece i */
   int getY(unsigned int i) const {
     bt_assert(i < piecenumber);
-    return dat[4 * i + 1];
+    return chain ? component(i, 1) : dat()[4 * i + 1];
   }
 
   /** return z-position of piece i */
   int getZ(unsigned int i) const {
     bt_assert(i < piecenumber);
-    return dat[4 * i + 2];
+    return chain ? component(i, 2) : dat()[4 * i + 2];
   }
 
   /** return orientation of piece i */
   unsigned int getTrans(unsigned int i) const {
     bt_assert(i < piecenumber);
-    return (unsigned char) dat[4 * i + 3];
+    return (unsigned char) (chain ? component(i, 3) : dat()[4 * i + 3]);
   }
 
+  /**
+   * get the position and orientation of all pieces at once, this is much faster than
+   * getting them one after the other. pos must have space for 4 values for
+   * each piece, they are x, y, z and trans like in the get functions above
+   */
+  void getPositions(int16_t *pos) const;
+
+  /**
+   * get the positions of all pieces when the positions of the come-from node are already
+   * known, this saves collecting them along the come-from nodes
+   */
+  void getPositions(int16_t *pos, const int16_t *comefromPos) const;
+
   /** return the number of pieces that are handled in this node */
   unsigned int getPiecenumber(void) const {
     return piecenumber;
@@ -243,55 +404,33 @@ class disassemblerNode_c {
    * The x, y and z value define the direction in which the
    * piece is removed
    */
-  void setRemove(unsigned int i, int x, int y, int z) {
-    bt_assert(i < piecenumber);
-    bt_assert(abs(x) < maxMove && abs(y) < maxMove && abs(z) < maxMove);
-
-    dat[4 * i + 0] = x;
-    dat[4 * i + 1] = y;
-    dat[4 * i + 2] = z;
-    dat[4 * i + 3] = (int16_t) 0xFFFF;
-    hashValue = 0;
-  }
+  void setRemove(unsigned int i, int x, int y, int z);
 
   /**
-   * set position of piece i in this node to the given values
+   * set position of piece i in this node to the given values, this
+   * is only possible for root nodes
    */
   void set(unsigned int i, int x, int y, int z, unsigned int tr) {
     bt_assert(i < piecenumber);
+    bt_assert(!chain);
     bt_assert(abs(x) < maxMove && abs(y) < maxMove && abs(z) < maxMove);
 
-    dat[4 * i + 0] = x;
-    dat[4 * i + 1] = y;
-    dat[4 * i + 2] = z;
-    dat[4 * i + 3] = (int16_t) tr;
+    dat()[4 * i + 0] = x;
+    dat()[4 * i + 1] = y;
+    dat()[4 * i + 2] = z;
+    dat()[4 * i + 3] = (int16_t) tr;
     hashValue = 0;
   }
 
   /**
    * set position of piece i in this node relative to the position in the come-from node
    */
-  void set(unsigned int i, int tx, int ty, int tz) {
-    bt_assert(i < piecenumber);
-    bt_assert(comefrom);
-    bt_assert(abs(comefrom->dat[4 * i + 0] + tx) < maxMove &&
-        abs(comefrom->dat[4 * i + 1] + ty) < maxMove &&
-        abs(comefrom->dat[4 * i + 2] + tz) < maxMove);
-
-    dat[4 * i + 0] = comefrom->dat[4 * i + 0] + tx;
-    dat[4 * i + 1] = comefrom->dat[4 * i + 1] + ty;
-    dat[4 * i + 2] = comefrom->dat[4 * i + 2] + tz;
-    dat[4 * i + 3] = comefrom->dat[4 * i + 3];
-    hashValue = 0;
-  }
+  void set(unsigned int i, int tx, int ty, int tz);
 
   /**
    * check if piece number nr is removed in this node
    */
-  bool is_piece_removed(unsigned int nr) const {
-    bt_assert(nr < piecenumber);
-    return (dat[4 * nr + 3] == (int16_t) 0xFFFF);
-  }
+  bool is_piece_removed(unsigned int nr) const;
 
   /**
    * check, if there is any piece that is removed in this node
@@ -318,15 +457,6 @@ class disassemblerNode_c {
     return waylength;
   }
 
-  /**
-   * Next-pointer for the hash-table lists.
-   *
-   * These node will be saved in disassembler-hash-tables. For
-   * those tables we need a next-pointer to save lists of nodes
-   * that go into the same hash-bucket
-   */
-  disassemblerNode_c *next;
-
  private:
 
   // no copying and assigning
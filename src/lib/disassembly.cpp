@@ -473,6 +473,19 @@ void Separation::exchangeShape(unsigned int s1, unsigned int s2) {
     left->exchangeShape(s1, s2);
 }
 
+void Separation::shiftPieces(int dx, int dy, int dz) {
+
+  for (unsigned int s = 0; s < states.size(); s++)
+    for (unsigned int i = 0; i < pieces.size(); i++)
+      states[s]->set(i, states[s]->getX(i) + dx, states[s]->getY(i) + dy, states[s]->getZ(i) + dz);
+
+  if (removed)
+    removed->shiftPieces(dx, dy, dz);
+
+  if (left)
+    left->shiftPieces(dx, dy, dz);
+}
+
 unsigned int Separation::getSequenceLength(unsigned int x) const {
   if (x == 0)
     return states.size();
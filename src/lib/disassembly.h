@@ -261,6 +261,9 @@ class Separation : public Disassembly {
   /** 2 pieces have exchanged their place in the problem list */
   void exchangeShape(unsigned int s1, unsigned int s2);
 
+  /** move all pieces in all states, including the sub separations, by the given amount */
+  void shiftPieces(int dx, int dy, int dz);
+
   /* implementation of the base class functions */
   virtual unsigned int getSequenceLength(unsigned int x) const;
   virtual unsigned int getNumSequences(void) const;
@@ -311,6 +314,12 @@ class SeparationInfo : public Disassembly {
 
   int movesText2(char *txt, int len, unsigned int idx) const;
 
+  /** empty separation info, the PackReader fills the values */
+  SeparationInfo(void) {}
+
+  friend class PackWriter;
+  friend class PackReader;
+
  public:
 
   /** load separationInfo from parser */
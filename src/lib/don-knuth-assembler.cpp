@@ -25,11 +25,15 @@
 #include "voxel.h"
 #include "assembly.h"
 #include "grid-type.h"
+#include "assembler-thread-pool.h"
+#include "placement-masks.h"
 
 #include "../tools/xml.h"
 
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <inttypes.h>
 
 #include "../config.h"
 
@@ -39,6 +43,65 @@
 
 #define ASSEMBLER_VERSION "1.4"
 
+/* the accessors for the nodes of the matrix that are given to the template functions
+ * of the assembler. L, R, U and D are the left, right, up and down links and C is
+ * the shared column and count member
+ */
+
+/* the nodes in the separate arrays of the assembler */
+class separateNodes {
+
+  unsigned int *l, *r, *ud, *cc;
+
+ public:
+
+  separateNodes(const std::vector<unsigned int> &left,
+                const std::vector<unsigned int> &right,
+                const std::vector<unsigned int> &upDown,
+                const std::vector<unsigned int> &colCount) :
+      l(const_cast<unsigned int *>(&left[0])),
+      r(const_cast<unsigned int *>(&right[0])),
+      ud(const_cast<unsigned int *>(&upDown[0])),
+      cc(const_cast<unsigned int *>(&colCount[0])) {}
+
+  unsigned int &L(unsigned int n) const { return l[n]; }
+  unsigned int &R(unsigned int n) const { return r[n]; }
+  unsigned int &U(unsigned int n) const { return ud[2 * n]; }
+  unsigned int &D(unsigned int n) const { return ud[2 * n + 1]; }
+  unsigned int &C(unsigned int n) const { return cc[n]; }
+};
+
+/* the links of one node in the packed layout */
+template <class T>
+struct packedNode {
+  T up, down, left, right;
+};
+
+/* the nodes of the packed layout */
+template <class T>
+class packedNodesAccess {
+
+  packedNode<T> *n;
+  T *cc;
+
+ public:
+
+  packedNodesAccess(const void *nodes, const void *counts) :
+      n((packedNode<T> *)nodes), cc((T *)counts) {}
+
+  T &L(unsigned int i) const { return n[i].left; }
+  T &R(unsigned int i) const { return n[i].right; }
+  T &U(unsigned int i) const { return n[i].up; }
+  T &D(unsigned int i) const { return n[i].down; }
+  T &C(unsigned int i) const { return cc[i]; }
+};
+
+/* the accessors for the packed layout of this assembler */
+#define PACKED_NODES(T) packedNodesAccess<T>(packedNodes, packedCounts)
+
+/* the accessor for the separate arrays of this assembler */
+#define SEPARATE_NODES separateNodes(left, right, upDown, colCount)
+
 /* print out the current matrix */
 void printMatrix(
     const std::vector<unsigned int> &upDown,
@@ -340,14 +403,59 @@ void DonKnuthAssembler::AddVoxelNode(unsigned int col, unsigned int piecenode) {
 
 DonKnuthAssembler::DonKnuthAssembler(void) :
     AssemblerInterface(),
-    pos(0), rows(0), columns(0),
-    reducePiece(0),
+    layout(NODES_PACKED), packedBits(0), packedMemory(0), packedNodes(0), packedCounts(0),
+    abbort(false), running(false),
+    pos(0), rows(0), columns(0), splitDepth(0), minPos(0),
+    threads(1), requestedSplitDepth(0), pool(0),
+    partCount(0), splitting(false),
+    reducePiece(0), reduceChecked(0), reducePlacements(0),
     avoidTransformedAssemblies(0), avoidTransformedMirror(0) {
 }
 
+DonKnuthAssembler::DonKnuthAssembler(const DonKnuthAssembler *orig) :
+    AssemblerInterface(),
+    puzzle(orig->puzzle),
+    left(orig->left), right(orig->right), upDown(orig->upDown), colCount(orig->colCount),
+    layout(orig->layout), packedBits(0), packedMemory(0), packedNodes(0), packedCounts(0),
+    abbort(false), running(false),
+    pos(0), splitDepth(orig->piecenumber), minPos(0),
+    threads(1), requestedSplitDepth(0), pool(0),
+    partCount(0), splitting(false),
+    errorsState(ERR_NONE), errorsParam(0),
+    iterations(0), holes(orig->holes),
+    varivoxelStart(orig->varivoxelStart), varivoxelEnd(orig->varivoxelEnd),
+    piecenumber(orig->piecenumber), asm_bc(0), reducePiece(0),
+    reduceChecked(0), reducePlacements(0),
+    piecePositions(orig->piecePositions),
+    // the rotation check is done by the worker, as it is not thread safe
+    avoidTransformedAssemblies(false), avoidTransformedMirror(0),
+    complete(orig->complete), debug(false), debug_loops(0) {
+
+  rows = new unsigned int[piecenumber];
+  columns = new unsigned int[piecenumber];
+
+  memset(rows, 0, piecenumber * sizeof(int));
+  memset(columns, 0, piecenumber * sizeof(int));
+
+  if (orig->packedBits) {
+    packNodes();
+    bt_assert(packedBits == orig->packedBits);
+  }
+}
+
+DonKnuthAssembler *DonKnuthAssembler::clone(void) const {
+  return new DonKnuthAssembler(this);
+}
+
 DonKnuthAssembler::~DonKnuthAssembler() {
+  // the pool needs to go first, its workers use our data
+  if (pool) delete pool;
+
+  clearSubtrees();
+
   if (rows) delete[] rows;
   if (columns) delete[] columns;
+  if (packedMemory) delete[] packedMemory;
 
   if (avoidTransformedMirror) delete avoidTransformedMirror;
 }
@@ -368,35 +476,108 @@ static Voxel *addToCache(Voxel *cache[], unsigned int *fill, Voxel *piece) {
   return piece;
 }
 
-bool DonKnuthAssembler::canPlace(const Voxel *piece,
-                                 int x,
-                                 int y,
-                                 int z) const {
+/* one orientation of a piece for prepare, with the placements found for it */
+class DonKnuthPrepareJob {
 
-  if (!piece->onGrid(x, y, z))
-    return false;
+ public:
+
+  unsigned int piece;
+  unsigned int rot;
+  const Voxel *rotation;
+
+  /* x, y and z for each placement and the columns of the voxels of each
+   * placement, all placements have the same number of voxels
+   */
+  std::vector<int> positions;
+  std::vector<unsigned int> columns;
+
+  DonKnuthPrepareJob(unsigned int pc, unsigned int r, const Voxel *v) :
+      piece(pc), rot(r), rotation(v) {}
+};
+
+/* the orientations for prepare, shared by all threads */
+class DonKnuthPrepareJobs {
+
+ public:
+
+  std::vector<DonKnuthPrepareJob> jobs;
+
+  /* the column for each voxel of the result */
+  const unsigned int *columns;
+
+  /* finds the positions of the orientations */
+  const PlacementMasks *masks;
+
+  boost::mutex mutex;
+
+  /* the next orientation to hand out */
+  unsigned int next;
+
+  /* set, when one of the threads failed with an assert */
+  bool failed;
+  assert_exception ae;
+
+  DonKnuthPrepareJobs(const unsigned int *c, const PlacementMasks *m) :
+      columns(c), masks(m), next(0), failed(false) {}
+};
+
+void DonKnuthAssembler::preparePlacements(DonKnuthPrepareJobs *jobs) {
 
   const Voxel *result = puzzle->getResultShape();
 
-  for (unsigned int pz = piece->boundZ1(); pz <= piece->boundZ2(); pz++)
-    for (unsigned int py = piece->boundY1(); py <= piece->boundY2(); py++)
-      for (unsigned int px = piece->boundX1(); px <= piece->boundX2(); px++)
-        if (
-          // the piece can not be place if the result is empty and the piece is filled at a given voxel
-            ((piece->getState(px, py, pz) == Voxel::VX_FILLED) &&
-                (result->getState(x + px, y + py, z + pz) == Voxel::VX_EMPTY))
-                ||
+  try {
 
-                    // the piece can also not be placed when the colour constraints don't fit
-                    !puzzle->placementAllowed(piece->getColor(px, py, pz),
-                                              result->getColor(x + px,
-                                                               y + py,
-                                                               z + pz))
+    while (true) {
 
-            )
-          return false;
+      unsigned int j;
 
-  return true;
+      {
+        boost::mutex::scoped_lock lock(jobs->mutex);
+
+        if (jobs->failed || jobs->next >= jobs->jobs.size())
+          break;
+
+        j = jobs->next++;
+        reducePiece = jobs->jobs[j].piece;
+      }
+
+      DonKnuthPrepareJob &job = jobs->jobs[j];
+      const Voxel *rotation = job.rotation;
+
+      std::vector<int> pos;
+      jobs->masks->findPlacements(rotation, &pos);
+
+      for (unsigned int i = 0; i < pos.size(); i += 3) {
+
+        int x = pos[i];
+        int y = pos[i + 1];
+        int z = pos[i + 2];
+
+        job.positions.push_back(x + rotation->getHx());
+        job.positions.push_back(y + rotation->getHy());
+        job.positions.push_back(z + rotation->getHz());
+
+        /* now add the used cubes of the piece */
+        for (unsigned int pz = rotation->boundZ1();
+             pz <= rotation->boundZ2(); pz++)
+          for (unsigned int py = rotation->boundY1();
+               py <= rotation->boundY2(); py++)
+            for (unsigned int px = rotation->boundX1();
+                 px <= rotation->boundX2(); px++)
+              if (rotation->getState(px, py, pz) == Voxel::VX_FILLED)
+                job.columns.push_back(jobs->columns[result->getIndex(x + px,
+                                                                     y + py,
+                                                                     z + pz)]);
+      }
+    }
+  }
+
+  catch (const assert_exception &a) {
+
+    boost::mutex::scoped_lock lock(jobs->mutex);
+    jobs->failed = true;
+    jobs->ae = a;
+  }
 }
 
 /**
@@ -615,6 +796,15 @@ int DonKnuthAssembler::prepare() {
 
   Voxel **cache = new Voxel *[sym->getNumTransformationsMirror()];
 
+  /* first collect all the different orientations of all pieces, the placements
+   * of these orientations are then searched in parallel and finally added
+   * to the matrix in the order of the orientations. So the matrix is the same
+   * as if everything was done one after the other
+   */
+  PlacementMasks masks(puzzle);
+  DonKnuthPrepareJobs jobs(columns, &masks);
+  std::vector<Voxel *> orientations;
+
   /* now we insert one shape after another */
   for (unsigned int pc = 0; pc < puzzle->partNumber(); pc++) {
 
@@ -623,7 +813,6 @@ int DonKnuthAssembler::prepare() {
     /* this array contains all the pieces found so far, this will help us
      * to not add two times the same piece to the structure */
     unsigned int cachefill = 0;
-    unsigned int placements = 0;
 
     /* go through all possible rotations of the piece
      * if shape is new to cache, add it to the cache and also
@@ -640,35 +829,8 @@ int DonKnuthAssembler::prepare() {
       rotation = addToCache(cache, &cachefill, rotation);
 
       if (rotation) {
-        for (int x = (int) result->boundX1() - (int) rotation->boundX1();
-             x <= (int) result->boundX2() - (int) rotation->boundX2(); x++)
-          for (int y = (int) result->boundY1() - (int) rotation->boundY1();
-               y <= (int) result->boundY2() - (int) rotation->boundY2(); y++)
-            for (int z = (int) result->boundZ1() - (int) rotation->boundZ1();
-                 z <= (int) result->boundZ2() - (int) rotation->boundZ2(); z++)
-              if (canPlace(rotation, x, y, z)) {
-
-                int piecenode = AddPieceNode(pc,
-                                             rot,
-                                             x + rotation->getHx(),
-                                             y + rotation->getHy(),
-                                             z + rotation->getHz());
-                placements = 1;
-
-                /* now add the used cubes of the piece */
-                for (unsigned int pz = rotation->boundZ1();
-                     pz <= rotation->boundZ2(); pz++)
-                  for (unsigned int py = rotation->boundY1();
-                       py <= rotation->boundY2(); py++)
-                    for (unsigned int px = rotation->boundX1();
-                         px <= rotation->boundX2(); px++)
-                      if (rotation->getState(px, py, pz) == Voxel::VX_FILLED)
-                        AddVoxelNode(columns[result->getIndex(x + px,
-                                                              y + py,
-                                                              z + pz)],
-                                     piecenode);
-              }
 
+        jobs.jobs.push_back(DonKnuthPrepareJob(pc, rot, rotation));
 
         /* for the symmetry breaker piece we also add all symmetries of the box */
         if (pc == symBreakerShape)
@@ -687,21 +849,65 @@ int DonKnuthAssembler::prepare() {
       }
     }
 
-    for (unsigned int i = 0; i < cachefill; i++) delete cache[i];
+    orientations.insert(orientations.end(), cache, cache + cachefill);
+  }
 
-    /* check, if the current piece has at least one placement */
-    if (placements == 0) {
-      delete[] cache;
-      delete[] columns;
-      delete[] voxelindex;
-      return -puzzle->getShape(pc);
+  delete[] cache;
+
+  {
+    boost::thread_group group;
+
+    for (unsigned int t = 1; t < threads; t++)
+      group.create_thread(boost::bind(&DonKnuthAssembler::preparePlacements, this, &jobs));
+
+    preparePlacements(&jobs);
+
+    group.join_all();
+  }
+
+  for (unsigned int i = 0; i < orientations.size(); i++) delete orientations[i];
+
+  if (jobs.failed) {
+    delete[] columns;
+    delete[] voxelindex;
+    throw jobs.ae;
+  }
+
+  std::vector<bool> placed(puzzle->partNumber(), false);
+
+  for (unsigned int j = 0; j < jobs.jobs.size(); j++) {
+
+    const DonKnuthPrepareJob &job = jobs.jobs[j];
+    unsigned int placements = job.positions.size() / 3;
+
+    if (!placements)
+      continue;
+
+    unsigned int voxels = job.columns.size() / placements;
+
+    for (unsigned int i = 0; i < placements; i++) {
+
+      int piecenode = AddPieceNode(job.piece,
+                                   job.rot,
+                                   job.positions[3 * i],
+                                   job.positions[3 * i + 1],
+                                   job.positions[3 * i + 2]);
+
+      for (unsigned int v = 0; v < voxels; v++)
+        AddVoxelNode(job.columns[i * voxels + v], piecenode);
     }
+
+    placed[job.piece] = true;
   }
 
-  delete[] cache;
   delete[] columns;
   delete[] voxelindex;
 
+  /* check, if each piece has at least one placement */
+  for (unsigned int pc = 0; pc < puzzle->partNumber(); pc++)
+    if (!placed[pc])
+      return -puzzle->getShape(pc);
+
   return 1;
 }
 
@@ -770,6 +976,8 @@ DonKnuthAssembler::errState DonKnuthAssembler::createMatrix(const Problem *puz,
   memset(rows, 0, piecenumber * sizeof(int));
   memset(columns, 0, piecenumber * sizeof(int));
   pos = 0;
+  splitDepth = piecenumber;
+  minPos = 0;
   iterations = 0;
 
   if (keepMirror)
@@ -778,18 +986,71 @@ DonKnuthAssembler::errState DonKnuthAssembler::createMatrix(const Problem *puz,
   if (keepRotations)
     avoidTransformedAssemblies = false;
 
+  packNodes();
+
   errorsState = ERR_NONE;
   return errorsState;
 }
 
+/* align the pointer to the start of the next cache line */
+static unsigned char *cacheAlign(unsigned char *p) {
+  return (unsigned char *)(((uintptr_t)p + 63) & ~(uintptr_t)63);
+}
+
+template <class T>
+static void fillPacked(packedNodesAccess<T> m,
+                       const std::vector<unsigned int> &left,
+                       const std::vector<unsigned int> &right,
+                       const std::vector<unsigned int> &upDown,
+                       const std::vector<unsigned int> &colCount) {
+
+  for (unsigned int i = 0; i < left.size(); i++) {
+    m.L(i) = left[i];
+    m.R(i) = right[i];
+    m.U(i) = up(i);
+    m.D(i) = down(i);
+    m.C(i) = colCount[i];
+  }
+}
+
+void DonKnuthAssembler::packNodes(void) {
+
+  if (packedMemory) delete[] packedMemory;
+  packedMemory = 0;
+  packedNodes = packedCounts = 0;
+  packedBits = 0;
+
+  if (layout != NODES_PACKED || !left.size())
+    return;
+
+  unsigned int nodes = left.size();
+
+  /* all indices and counts are smaller than the number of nodes */
+  packedBits = (nodes <= 0x10000) ? 16 : 32;
+
+  unsigned int nodeSize = (packedBits == 16) ? sizeof(packedNode<uint16_t>) : sizeof(packedNode<uint32_t>);
+  unsigned int countSize = packedBits / 8;
+
+  /* nodes and counts both start at a cache line */
+  packedMemory = new unsigned char[nodes * (nodeSize + countSize) + 2 * 64];
+  packedNodes = cacheAlign(packedMemory);
+  packedCounts = cacheAlign((unsigned char *)packedNodes + nodes * nodeSize);
+
+  if (packedBits == 16)
+    fillPacked(PACKED_NODES(uint16_t), left, right, upDown, colCount);
+  else
+    fillPacked(PACKED_NODES(uint32_t), left, right, upDown, colCount);
+}
+
 /* remove column from array, and also all the rows, where the column is one */
-void DonKnuthAssembler::cover(unsigned int col) {
+template <class N>
+void DonKnuthAssembler::cover(N m, unsigned int col) {
   {
-    unsigned int l = left[col];
-    unsigned int r = right[col];
+    unsigned int l = m.L(col);
+    unsigned int r = m.R(col);
 
-    left[r] = l;
-    right[l] = r;
+    m.L(r) = l;
+    m.R(l) = r;
   }
 
 #if 0
@@ -850,16 +1111,16 @@ void DonKnuthAssembler::cover(unsigned int col) {
 
 #else
 
-  for (unsigned int i = down(col); i != col; i = down(i)) {
-    for (unsigned int j = right[i]; j != i; j = right[j]) {
+  for (unsigned int i = m.D(col); i != col; i = m.D(i)) {
+    for (unsigned int j = m.R(i); j != i; j = m.R(j)) {
 
-      unsigned int u = up(j);
-      unsigned int d = down(j);
+      unsigned int u = m.U(j);
+      unsigned int d = m.D(j);
 
-      up(d) = u;
-      down(u) = d;
+      m.U(d) = u;
+      m.D(u) = d;
 
-      colCount[colCount[j]]--;
+      m.C(m.C(j))--;
     }
   }
 
@@ -867,7 +1128,8 @@ void DonKnuthAssembler::cover(unsigned int col) {
 
 }
 
-void DonKnuthAssembler::uncover(unsigned int col) {
+template <class N>
+void DonKnuthAssembler::uncover(N m, unsigned int col) {
 
 #if 0
   // the assembly code below is ca 20% faster than the gcc code
@@ -927,28 +1189,29 @@ void DonKnuthAssembler::uncover(unsigned int col) {
 
 #else
 
-  for (unsigned int i = up(col); i != col; i = up(i)) {
-    for (unsigned int j = left[i]; j != i; j = left[j]) {
+  for (unsigned int i = m.U(col); i != col; i = m.U(i)) {
+    for (unsigned int j = m.L(i); j != i; j = m.L(j)) {
 
-      colCount[colCount[j]]++;
+      m.C(m.C(j))++;
 
-      up(down(j)) = j;
-      down(up(j)) = j;
+      m.U(m.D(j)) = j;
+      m.D(m.U(j)) = j;
     }
   }
 
 #endif
 
-  left[right[col]] = col;
-  right[left[col]] = col;
+  m.L(m.R(col)) = col;
+  m.R(m.L(col)) = col;
 }
 
 /* remove all the columns from the matrix in which the given
  * row contains ones
  */
-void DonKnuthAssembler::cover_row(register unsigned int r) {
-  for (unsigned int j = right[r]; j != r; j = right[j])
-    cover(colCount[j]);
+template <class N>
+void DonKnuthAssembler::cover_row(N m, register unsigned int r) {
+  for (unsigned int j = m.R(r); j != r; j = m.R(j))
+    cover(m, m.C(j));
 }
 
 bool DonKnuthAssembler::try_cover_row(register unsigned int r,
@@ -961,13 +1224,13 @@ bool DonKnuthAssembler::try_cover_row(register unsigned int r,
 
   for (unsigned int j = right[r]; j != r; j = right[j]) {
 
-    cover(colCount[j]);
+    cover(SEPARATE_NODES, colCount[j]);
 
     for (unsigned int k = right[0]; k; k = right[k]) {
 
       if ((columns[k] == 0) && (colCount[k] == 0)) {
         do {
-          uncover(colCount[j]);
+          uncover(SEPARATE_NODES, colCount[j]);
           j = left[j];
         } while (j != r);
 
@@ -979,9 +1242,10 @@ bool DonKnuthAssembler::try_cover_row(register unsigned int r,
   return true;
 }
 
-void DonKnuthAssembler::uncover_row(register unsigned int r) {
-  for (unsigned int j = left[r]; j != r; j = left[j])
-    uncover(colCount[j]);
+template <class N>
+void DonKnuthAssembler::uncover_row(N m, register unsigned int r) {
+  for (unsigned int j = m.L(r); j != r; j = m.L(j))
+    uncover(m, m.C(j));
 }
 
 void DonKnuthAssembler::remove_row(register unsigned int r) {
@@ -1023,6 +1287,98 @@ void DonKnuthAssembler::reinsert_row(register unsigned int r) {
   } while (j != r);
 }
 
+/* the data the threads of the parallel reduce share */
+class DonKnuthReduceShared {
+
+ public:
+
+  boost::mutex mutex;
+
+  /* the next placement to hand out */
+  unsigned int next;
+
+  /* the progress counter of the assembler */
+  unsigned int *checked;
+
+  /* set, when one of the threads failed with an assert */
+  bool failed;
+  assert_exception ae;
+
+  DonKnuthReduceShared(unsigned int *c) : next(0), checked(c), failed(false) {}
+};
+
+/* the number of placements a thread takes at once */
+#define REDUCE_CHUNK 16
+
+void DonKnuthAssembler::reduceCheck(unsigned int piece,
+                                    const std::vector<unsigned int> *placements,
+                                    std::vector<char> *dead,
+                                    DonKnuthReduceShared *shared) {
+
+  unsigned int *columns = new unsigned int[varivoxelEnd];
+
+  try {
+
+    // place the piece and check, if this leads to some
+    // infillable holes or unplaceable pieces or whatever
+    // conditions that make a solution impossible
+    cover(SEPARATE_NODES, piece + 1);
+
+    while (true) {
+
+      unsigned int start, end;
+
+      {
+        boost::mutex::scoped_lock lock(shared->mutex);
+
+        if (shared->failed || shared->next >= placements->size())
+          break;
+
+        start = shared->next;
+        end = std::min(start + REDUCE_CHUNK, (unsigned int)placements->size());
+        shared->next = end;
+      }
+
+      for (unsigned int i = start; i < end; i++) {
+
+        unsigned int r = (*placements)[i];
+
+        // try to do this placement, if the placing goes
+        // wrong already, we don't need to do the deep check
+        if (!try_cover_row(r, columns)) {
+          (*dead)[i] = 1;
+        } else {
+
+          /* and check if that results in a dead end */
+          if (checkmatrix())
+            (*dead)[i] = 1;
+
+          uncover_row(SEPARATE_NODES, r);
+        }
+      }
+
+      boost::mutex::scoped_lock lock(shared->mutex);
+      *shared->checked += end - start;
+    }
+
+    uncover(SEPARATE_NODES, piece + 1);
+  }
+
+  catch (const assert_exception &a) {
+
+    boost::mutex::scoped_lock lock(shared->mutex);
+    shared->failed = true;
+    shared->ae = a;
+  }
+
+  delete[] columns;
+}
+
+void DonKnuthAssembler::getReduceProgress(unsigned int *checked, unsigned int *total) const {
+  *checked = reduceChecked;
+  *total = reducePlacements;
+}
+
 bool DonKnuthAssembler::checkmatrix() {
 
   /* check the number of holes, if they are larger than allowed return */
@@ -1099,45 +1455,74 @@ void DonKnuthAssembler::reduce() {
 
   remCol += clumpify();
 
+  /* with several threads the placements of a piece are checked in parallel, each
+   * thread on its own copy of the matrix, this thread uses the matrix of the
+   * assembler. All removals are done here on the matrix of the assembler and
+   * then repeated on the copies, so that the copies stay identical. The result
+   * is the same as with one thread
+   */
+  std::vector<DonKnuthAssembler *> copies;
+  for (unsigned int t = 1; t < threads; t++)
+    copies.push_back(new DonKnuthAssembler(this));
+
+  /* all the rows that were removed while working on one piece */
+  std::vector<unsigned int> removedRows;
+
   do {
 
     rem_sth = false;
 
+    reduceChecked = 0;
+    unsigned int placementCount = 0;
+    for (unsigned int p = 0; p < piecenumber; p++)
+      placementCount += colCount[p + 1];
+    reducePlacements = placementCount;
+
     /* check all the pieces */
     for (unsigned int p = 0; p < piecenumber; p++) {
 
       reducePiece = p;
-
-      // place the piece and check, if this leads to some
-      // infillable holes or unplaceable pieces or whatever
-      // conditions that make a solution impossible
-      cover(p + 1);
-
-      rowsToRemove.clear();
+      removedRows.clear();
 
       // go over all the placements of the piece and check, if
       // each for possibility
-      for (unsigned int r = down(p + 1); r != p + 1; r = down(r)) {
+      std::vector<unsigned int> pieceRows;
+      for (unsigned int r = down(p + 1); r != p + 1; r = down(r))
+        pieceRows.push_back(r);
 
-        // try to do this placement, if the placing goes
-        // wrong already, we don't need to do the deep check
-        if (!try_cover_row(r, columns)) {
-          rowsToRemove.push_back(r);
-        } else {
+      std::vector<char> dead(pieceRows.size(), 0);
+      DonKnuthReduceShared shared(&reduceChecked);
 
-          /* and check if that results in a dead end */
-          if (checkmatrix())
-            rowsToRemove.push_back(r);
+      {
+        boost::thread_group group;
 
-          uncover_row(r);
-        }
+        if (pieceRows.size() > REDUCE_CHUNK)
+          for (unsigned int t = 0; t < copies.size(); t++)
+            group.create_thread(boost::bind(&DonKnuthAssembler::reduceCheck, copies[t],
+                                            p, &pieceRows, &dead, &shared));
+
+        reduceCheck(p, &pieceRows, &dead, &shared);
+
+        group.join_all();
+      }
+
+      if (shared.failed) {
+        for (unsigned int t = 0; t < copies.size(); t++)
+          delete copies[t];
+        delete[] columns;
+        throw shared.ae;
       }
 
-      uncover(p + 1);
+      rowsToRemove.clear();
+      for (unsigned int i = 0; i < pieceRows.size(); i++)
+        if (dead[i])
+          rowsToRemove.push_back(pieceRows[i]);
 
       for (unsigned int rem = 0; rem < rowsToRemove.size(); rem++)
         remove_row(rowsToRemove[rem]);
 
+      removedRows.insert(removedRows.end(), rowsToRemove.begin(), rowsToRemove.end());
+
       rem_sth |= (rowsToRemove.size() > 0);
       removed += rowsToRemove.size();
 
@@ -1183,18 +1568,29 @@ void DonKnuthAssembler::reduce() {
             remove_row(rowsToRemove[rem]);
           }
 
+          removedRows.insert(removedRows.end(), rowsToRemove.begin(), rowsToRemove.end());
+
           rem_sth |= (rowsToRemove.size() > 0);
           removed += rowsToRemove.size();
 
         }
       }
+
+      for (unsigned int t = 0; t < copies.size(); t++)
+        for (unsigned int rem = 0; rem < removedRows.size(); rem++)
+          copies[t]->remove_row(removedRows[rem]);
     }
   } while (rem_sth);
 
+  for (unsigned int t = 0; t < copies.size(); t++)
+    delete copies[t];
+
   delete[] columns;
 
   remCol += clumpify();
 
+  packNodes();
+
   fprintf(stderr, "removed %i rows and %i columns\n", removed, remCol);
 }
 
@@ -1284,10 +1680,8 @@ void DonKnuthAssembler::solution() {
 /* to understand this function you need to first completely understand the
  * dancing link algorithm.
  */
-void DonKnuthAssembler::iterativeMultiSearch() {
-
-  abbort = false;
-  running = true;
+template <class N>
+void DonKnuthAssembler::iterativeMultiSearch(N m) {
 
   // this variable is used to store if we continue with our loop over
   // the rows or have finished
@@ -1296,9 +1690,19 @@ void DonKnuthAssembler::iterativeMultiSearch() {
   while (!abbort) {
 
     // we have finished if pos negative (or greater than piecenumber because of the
-    // overflow
-    if (pos > piecenumber)
+    // overflow, workers of the parallel search are finished when they leave their subtree
+    if ((pos > piecenumber) || (pos < minPos))
+      break;
+
+    // a part of a split search ends where the next part starts, there
+    // we pretend to have finished the whole search
+    if (partEnd.size() && (pos == partEnd.size()) &&
+        std::equal(partEnd.begin(), partEnd.end(), rows)) {
+      uncoverStack(m);
+      pos = (unsigned int)-1;
+      partEnd.clear();
       break;
+    }
 
     // check, if all pieces are placed and all voxels are filled
     // careful here abort is also modified by another thread
@@ -1307,7 +1711,7 @@ void DonKnuthAssembler::iterativeMultiSearch() {
     // and search halve a day why it didn't work. The value of abort was read
     // then the function called then the new value calculated then the new value
     // written. Meanwhile abort was pressed and abort was changed. This new value got lost.
-    if (!right[0])
+    if (!m.R(0))
       solution();
 
     // the debugger
@@ -1321,8 +1725,13 @@ void DonKnuthAssembler::iterativeMultiSearch() {
     // if all pieces are placed we can not go on even if there are
     // more columns that need attention, all of them should be
     // empty any ways, so we backtrack once and continue there
-    if (pos == piecenumber)
+    // the master of the parallel search does the same at the split level
+    // after it handed the subtree below to the workers
+    if (pos == splitDepth) {
+      if ((splitDepth < piecenumber) && !addTask())
+        break;
       pos--;
+    }
 
     cont = false;
     iterations++;
@@ -1340,23 +1749,23 @@ void DonKnuthAssembler::iterativeMultiSearch() {
        * we also look for piece and result columns that have a count of 0 that value
        * will lead to impossible arrangements
        */
-      unsigned int c = right[0];
-      unsigned int s = colCount[c];
+      unsigned int c = m.R(0);
+      unsigned int s = m.C(c);
 
       if (s) {
-        register unsigned int j = right[c];
+        register unsigned int j = m.R(c);
 
         while (j) {
 
-          if (colCount[j] < s) {
+          if (m.C(j) < s) {
             c = j;
-            s = colCount[c];
+            s = m.C(c);
 
             if (!s)
               break;
           }
 
-          j = right[j];
+          j = m.R(j);
         }
       }
 
@@ -1367,17 +1776,17 @@ void DonKnuthAssembler::iterativeMultiSearch() {
       // it doesn't cost a lot of time, so let's keep it in for the moment
       if (s) {
         unsigned int currentHoles = holes;
-        register unsigned int j = right[varivoxelEnd];
+        register unsigned int j = m.R(varivoxelEnd);
 
         while (j != varivoxelEnd) {
-          if (colCount[j] == 0) {
+          if (m.C(j) == 0) {
             if (currentHoles == 0) {
               s = 0;
               break;
             }
             currentHoles--;
           }
-          j = right[j];
+          j = m.R(j);
         }
       }
 
@@ -1385,7 +1794,7 @@ void DonKnuthAssembler::iterativeMultiSearch() {
 
         // we have found a valid column, start a search
         columns[pos] = c;
-        rows[pos] = down(columns[pos]);
+        rows[pos] = m.D(columns[pos]);
 
         cont = true;
       }
@@ -1397,17 +1806,17 @@ void DonKnuthAssembler::iterativeMultiSearch() {
         continue;
       }
 
-      cover(columns[pos]);
+      cover(m, columns[pos]);
 
     } else {
 
       // continue on a column we have already started, this is inside the loop in the
       // recursive function, after we return from the recursive call
       // we uncover our row, find the next one and continue, if there is a new row
-      uncover_row(rows[pos]);
+      uncover_row(m, rows[pos]);
       cont = true;
 
-      rows[pos] = down(rows[pos]);
+      rows[pos] = m.D(rows[pos]);
 
       if (rows[pos] == columns[pos])
         cont = false;
@@ -1417,21 +1826,339 @@ void DonKnuthAssembler::iterativeMultiSearch() {
     if (cont) {
 
       // cover the row
-      cover_row(rows[pos]);
+      cover_row(m, rows[pos]);
 
       pos++;
 
     } else {
 
       // OK finished this column, uncover it and backtrack
-      uncover(columns[pos]);
+      uncover(m, columns[pos]);
 
       rows[pos] = 0;
       pos--;
     }
   }
+}
 
-  running = false;
+template <class N>
+void DonKnuthAssembler::coverStack(N m) {
+
+  if (pos > piecenumber)
+    return;
+
+  for (unsigned int p = 0; (p <= pos) && (p < piecenumber); p++)
+    if (rows[p]) {
+      cover(m, columns[p]);
+      cover_row(m, rows[p]);
+    }
+}
+
+template <class N>
+void DonKnuthAssembler::uncoverStack(N m) {
+
+  if (pos > piecenumber)
+    return;
+
+  for (int p = (pos < piecenumber) ? pos : piecenumber - 1; p >= 0; p--)
+    if (rows[p]) {
+      uncover_row(m, rows[p]);
+      uncover(m, columns[p]);
+    }
+}
+
+template <class N>
+void DonKnuthAssembler::getFraction(N m, unsigned int depth, float *before, float *weight) const {
+
+  *before = 0;
+  *weight = 1;
+
+  for (unsigned int i = 0; i < depth; i++) {
+
+    unsigned int r = rows[i];
+    unsigned int cnt = m.C(columns[i]);
+    unsigned int idx = 0;
+
+    while (r && (r != m.D(columns[i])) && (idx < cnt)) {
+      idx++;
+      r = m.U(r);
+    }
+
+    *before += *weight * idx / cnt;
+    *weight /= cnt;
+  }
+}
+
+void DonKnuthAssembler::iterativeMultiSearch(void) {
+  switch (packedBits) {
+    case 16: iterativeMultiSearch(PACKED_NODES(uint16_t)); break;
+    case 32: iterativeMultiSearch(PACKED_NODES(uint32_t)); break;
+    default: iterativeMultiSearch(SEPARATE_NODES); break;
+  }
+}
+
+void DonKnuthAssembler::coverStack(void) {
+  switch (packedBits) {
+    case 16: coverStack(PACKED_NODES(uint16_t)); break;
+    case 32: coverStack(PACKED_NODES(uint32_t)); break;
+    default: coverStack(SEPARATE_NODES); break;
+  }
+}
+
+void DonKnuthAssembler::uncoverStack(void) {
+  switch (packedBits) {
+    case 16: uncoverStack(PACKED_NODES(uint16_t)); break;
+    case 32: uncoverStack(PACKED_NODES(uint32_t)); break;
+    default: uncoverStack(SEPARATE_NODES); break;
+  }
+}
+
+void DonKnuthAssembler::getFraction(unsigned int depth, float *before, float *weight) const {
+  switch (packedBits) {
+    case 16: getFraction(PACKED_NODES(uint16_t), depth, before, weight); break;
+    case 32: getFraction(PACKED_NODES(uint32_t), depth, before, weight); break;
+    default: getFraction(SEPARATE_NODES, depth, before, weight); break;
+  }
+}
+
+/* one subtree of the parallel search, it contains the rows and columns
+ * selected on the way to the subtree. When the search within the subtree
+ * is stopped it contains the complete stack of the worker
+ */
+class DonKnuthTask : public AssemblerTask {
+
+ public:
+
+  unsigned int pos;
+  std::vector<unsigned int> rows;
+  std::vector<unsigned int> columns;
+};
+
+/* a worker thread for the parallel search, it has its own copy of the matrix */
+class DonKnuthWorker : public AssemblerWorker, public AssemblerCallbackInterface {
+
+  const DonKnuthAssembler *master;
+  AssemblerThreadPool *pool;
+  DonKnuthAssembler *assm;
+  DonKnuthTask *task;
+
+ public:
+
+  DonKnuthWorker(const DonKnuthAssembler *m, AssemblerThreadPool *p) :
+      master(m), pool(p), assm(m->clone()), task(0) {
+    assm->asm_bc = this;
+    assm->minPos = m->splitDepth;
+  }
+
+  ~DonKnuthWorker(void) { delete assm; }
+
+  bool run(AssemblerTask *t) {
+
+    task = static_cast<DonKnuthTask *>(t);
+
+    assm->uncoverStack();
+    assm->loadStack(task);
+    assm->coverStack();
+
+    assm->iterativeMultiSearch();
+
+    if ((assm->pos > assm->piecenumber) || (assm->pos < assm->minPos))
+      return true;
+
+    assm->saveStack(task);
+    return false;
+  }
+
+  void stop(void) { assm->stop(); }
+
+  float getFinished(void) const { return assm->getFinished(); }
+
+  unsigned long getIterations(void) const { return assm->iterations; }
+
+  unsigned int getDepth(void) const { return assm->pos; }
+
+  bool assembly(Assembly *a) {
+
+    if (master->avoidTransformedAssemblies) {
+
+      // the rotation check uses caches within the shapes of the puzzle
+      boost::mutex::scoped_lock lock(pool->getSharedMutex());
+
+      if (a->smallerRotationExists(master->puzzle,
+                                   master->avoidTransformedPivot,
+                                   master->avoidTransformedMirror,
+                                   master->complete)) {
+        delete a;
+        return true;
+      }
+    }
+
+    pool->assembly(task, a);
+    return true;
+  }
+};
+
+void DonKnuthAssembler::saveStack(DonKnuthTask *t) const {
+
+  t->pos = pos;
+  t->rows.assign(rows, rows + piecenumber);
+  t->columns.assign(columns, columns + piecenumber);
+}
+
+void DonKnuthAssembler::loadStack(const DonKnuthTask *t) {
+
+  pos = t->pos;
+
+  for (unsigned int i = 0; i < piecenumber; i++) {
+    rows[i] = t->rows[i];
+    columns[i] = t->columns[i];
+  }
+}
+
+bool DonKnuthAssembler::addTask(void) {
+
+  DonKnuthTask *t = new DonKnuthTask();
+
+  saveStack(t);
+  getFraction(splitDepth, &t->before, &t->weight);
+
+  if (splitting) {
+    subtrees.push_back(t);
+    return true;
+  }
+
+  return pool->addTask(t);
+}
+
+void DonKnuthAssembler::clearSubtrees(void) {
+
+  for (unsigned int i = 0; i < subtrees.size(); i++)
+    delete subtrees[i];
+
+  subtrees.clear();
+}
+
+unsigned int DonKnuthAssembler::splitSearch(unsigned int parts) {
+
+  // we can only split a search that has not yet started
+  if ((errorsState != ERR_NONE) || (pos != 0) || rows[0] || !parts)
+    return 0;
+
+  unsigned long it = iterations;
+
+  splitting = true;
+  abbort = false;
+  debug = false;
+
+  /* walk the search tree down to the split level and collect the
+   * subtrees there, until there are enough of them
+   */
+  for (splitDepth = 1; splitDepth < piecenumber; splitDepth++) {
+
+    clearSubtrees();
+
+    iterativeMultiSearch();
+
+    // the search is at its end now, so all is uncovered, go back to the start
+    pos = 0;
+    memset(rows, 0, piecenumber * sizeof(int));
+    memset(columns, 0, piecenumber * sizeof(int));
+
+    if (subtrees.size() >= parts)
+      break;
+  }
+
+  splitting = false;
+  splitDepth = piecenumber;
+  iterations = it;
+
+  partCount = (subtrees.size() < parts) ? subtrees.size() : parts;
+
+  return partCount;
+}
+
+void DonKnuthAssembler::selectPart(unsigned int part) {
+
+  bt_assert(part < partCount);
+
+  /* each part contains a range of consecutive subtrees */
+  unsigned int first = part * subtrees.size() / partCount;
+  unsigned int next = (part + 1) * subtrees.size() / partCount;
+
+  uncoverStack();
+  loadStack(subtrees[first]);
+  coverStack();
+
+  partEnd.clear();
+
+  if (next < subtrees.size())
+    partEnd.assign(subtrees[next]->rows.begin(), subtrees[next]->rows.begin() + subtrees[next]->pos);
+}
+
+void DonKnuthAssembler::parallelSearch(void) {
+
+  if (!pool)
+    pool = new AssemblerThreadPool(16 * threads);
+
+  pool->begin(asm_bc, &abbort);
+
+  /* the workers need a copy of the matrix in its initial state */
+  uncoverStack();
+  for (unsigned int i = 0; i < threads; i++)
+    pool->addWorker(new DonKnuthWorker(this, pool));
+  coverStack();
+
+  /* when we continue a search that has been stopped below the split level
+   * the subtree we are in is the first task, and we continue above it
+   */
+  if ((pos <= piecenumber) && (pos >= splitDepth)) {
+
+    DonKnuthTask *t = new DonKnuthTask();
+
+    saveStack(t);
+    getFraction(splitDepth, &t->before, &t->weight);
+
+    if (pool->addTask(t)) {
+
+      uncoverStack();
+
+      for (unsigned int i = splitDepth; i < piecenumber; i++)
+        rows[i] = columns[i] = 0;
+      pos = splitDepth;
+
+      coverStack();
+      pos--;
+    }
+  }
+
+  try {
+    iterativeMultiSearch();
+  }
+  catch (const assert_exception &) {
+    // the workers must not continue with our data
+    pool->stop();
+    pool->finish();
+    throw;
+  }
+
+  pool->finish();
+
+  iterations += pool->getIterations();
+  pool->clearIterations();
+
+  /* when the search was stopped we need to get to the position of the first
+   * subtree that is not finished, that is where the single threaded search
+   * would be, all later subtrees will be searched again
+   */
+  AssemblerTask *t = pool->getFirstUnfinished();
+
+  if (t) {
+    uncoverStack();
+    loadStack(static_cast<DonKnuthTask *>(t));
+    coverStack();
+
+    delete t;
+  }
 }
 
 void DonKnuthAssembler::assemble(AssemblerCallbackInterface *callback) {
@@ -1440,43 +2167,91 @@ void DonKnuthAssembler::assemble(AssemblerCallbackInterface *callback) {
 
   if (errorsState == ERR_NONE) {
     asm_bc = callback;
-    iterativeMultiSearch();
+    abbort = false;
+    running = true;
+
+    splitDepth = requestedSplitDepth ? requestedSplitDepth : 3;
+    // the master needs to reach the level where the end of a part is detected
+    if (splitDepth < partEnd.size())
+      splitDepth = partEnd.size();
+    if (splitDepth >= piecenumber)
+      splitDepth = piecenumber - 1;
+
+    if ((threads > 1) && (splitDepth > 0) && (pos <= piecenumber))
+      parallelSearch();
+    else {
+      splitDepth = piecenumber;
+      iterativeMultiSearch();
+    }
+
+    splitDepth = piecenumber;
+    running = false;
   }
 }
 
-float DonKnuthAssembler::getFinished(void) const {
+void DonKnuthAssembler::setThreads(unsigned int t, unsigned int depth) {
+  threads = t;
+  requestedSplitDepth = depth;
+}
 
-  /* we don't need locking, as I hope that I have written the
-   * code in a way that updated the data so, that it will never
-   * be in an inconsistent state. The thing that will happen is that
-   * the value may jump
-   */
+unsigned long DonKnuthAssembler::getIterations() {
+  return iterations + (pool ? pool->getIterations() : 0);
+}
 
-  if (!rows || !columns || !upDown.size())
-    return 0;
+template <class N>
+float DonKnuthAssembler::getFinished(N m) const {
 
   float erg = 0;
 
   if (pos > piecenumber)
     return 1;
 
-  for (int i = pos - 1; i >= 0; i--) {
+  for (int i = pos - 1; i >= (int)minPos; i--) {
 
     unsigned int r = rows[i];
-    unsigned int l = colCount[columns[i]];
+    unsigned int l = m.C(columns[i]);
 
-    while (l && r && (r != down(columns[i]))) {
+    while (l && r && (r != m.D(columns[i]))) {
       erg += 1;
-      r = up(r);
+      r = m.U(r);
       l--;
     }
 
-    erg /= colCount[columns[i]];
+    erg /= m.C(columns[i]);
   }
 
   return erg;
 }
 
+float DonKnuthAssembler::getFinished(void) const {
+
+  /* we don't need locking, as I hope that I have written the
+   * code in a way that updated the data so, that it will never
+   * be in an inconsistent state. The thing that will happen is that
+   * the value may jump
+   */
+
+  if (!rows || !columns || !upDown.size())
+    return 0;
+
+  if (pool && pool->isActive())
+    return pool->getFinished();
+
+  switch (packedBits) {
+    case 16: return getFinished(PACKED_NODES(uint16_t));
+    case 32: return getFinished(PACKED_NODES(uint32_t));
+    default: return getFinished(SEPARATE_NODES);
+  }
+}
+
+void DonKnuthAssembler::getSearchDepths(std::vector<unsigned int> *depths) const {
+
+  if (pool && pool->isActive())
+    pool->getDepths(depths);
+  else if (rows && (pos <= piecenumber))
+    depths->push_back(pos);
+}
+
 static unsigned int getInt(const char *s, unsigned int *i) {
 
   char *s2;
@@ -1542,6 +2317,28 @@ AssemblerInterface::errState DonKnuthAssembler::setPosition(const char *string,
       if ((i < pos) && (spos >= len)) return ERR_CAN_NOT_RESTORE_SYNTAX;
     }
 
+  /* when we search a part of a split search, the rows where the part ends follow in [] */
+  partEnd.clear();
+
+  while ((spos < len) && (*(string + spos) == ' ')) spos++;
+
+  if ((spos < len) && (*(string + spos) == '[')) {
+    spos++;
+
+    while ((spos < len) && (*(string + spos) != ']')) {
+      unsigned int r;
+      unsigned int l = getInt(string + spos, &r);
+      if (!l) return ERR_CAN_NOT_RESTORE_SYNTAX;
+      spos += l;
+      if (spos >= len) return ERR_CAN_NOT_RESTORE_SYNTAX;
+      if (r > left.size()) return ERR_CAN_NOT_RESTORE_SYNTAX;
+      partEnd.push_back(r);
+      while ((spos < len) && (*(string + spos) == ' ')) spos++;
+    }
+
+    if (partEnd.size() >= piecenumber) return ERR_CAN_NOT_RESTORE_SYNTAX;
+  }
+
   /* check for integrity last read data may contain only preparation for next, so don't check that one */
   for (unsigned int i = 0; i < pos; i++) {
     // for the last piece we can check for the number of nodes
@@ -1553,20 +2350,7 @@ AssemblerInterface::errState DonKnuthAssembler::setPosition(const char *string,
    * saved the position that means we need to cover all rows and columns in the same
    * order as it happened in the original process
    */
-  unsigned int p = 0;
-
-  if (pos <= piecenumber) {
-
-    while (p <= pos) {
-
-      if ((p < piecenumber) && rows[p]) {
-        cover(columns[p]);
-        cover_row(rows[p]);
-      }
-
-      p++;
-    }
-  }
+  coverStack();
 
   return ERR_NONE;
 }
@@ -1586,6 +2370,12 @@ void DonKnuthAssembler::save(XmlWriter &xml) const {
       if (j < pos) str << " ";
     }
 
+  if ((pos <= piecenumber) && partEnd.size()) {
+    str << " [";
+    for (unsigned int j = 0; j < partEnd.size(); j++)
+      str << partEnd[j] << ((j + 1 < partEnd.size()) ? " " : "]");
+  }
+
   xml.endTag("assembler");
 }
 
@@ -1628,7 +2418,10 @@ void DonKnuthAssembler::debug_step(unsigned long num) {
   debug = true;
   debug_loops = num;
   asm_bc = 0;
+  abbort = false;
+  running = true;
   iterativeMultiSearch();
+  running = false;
 }
 
 bool DonKnuthAssembler::canHandle(const Problem *p) {
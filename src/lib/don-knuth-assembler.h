@@ -29,6 +29,10 @@
 
 class GridType;
 class MirrorInfo;
+class AssemblerThreadPool;
+class DonKnuthTask;
+class DonKnuthReduceShared;
+class DonKnuthPrepareJobs;
 
 /**
  * This is an assembler class.
@@ -41,6 +45,14 @@ class MirrorInfo;
  */
 class DonKnuthAssembler : public AssemblerInterface {
 
+ public:
+
+  /** the ways the nodes of the matrix can be stored for the search */
+  enum nodeLayout {
+    NODES_SEPARATE,   ///< one array for each member of the nodes
+    NODES_PACKED      ///< the links of a node next to each other, with 16 bit indices when possible
+  };
+
  protected:
 
   const Problem *puzzle;
@@ -66,17 +78,44 @@ class DonKnuthAssembler : public AssemblerInterface {
 #define up(x) upDown[2*(x)]
 #define down(x) upDown[2*(x)+1]
 
+  /* with the packed layout the 4 links of a node are next to each other in
+   * packedNodes, so that following a row and unlinking its nodes touches
+   * one cache line instead of 3. colCount is in its own array packedCounts
+   * because the counts of the column headers are read all the time when
+   * searching the next column. Both arrays start at a cache line, so the column
+   * headers, which are the first nodes, are at the start of a line.
+   * packedBits is the size of the indices, 16 when the matrix is small enough,
+   * 32 otherwise and 0 when the separate arrays above are used.
+   *
+   * When packed the search only works on the packed nodes, the arrays above
+   * keep the initial matrix for reduce and the placement functions
+   */
+  nodeLayout layout;
+  unsigned int packedBits;
+  unsigned char *packedMemory;
+  void *packedNodes;
+  void *packedCounts;
+
+  /* create the packed nodes from the arrays, when the packed layout is selected
+   * this needs to be done each time the matrix changed
+   */
+  void packNodes(void);
+
   /* used to abort the searching */
   bool abbort;
 
   /* used to save if the search is running */
   bool running;
 
+  /* the functions working on the nodes are templates with an accessor for
+   * the nodes as first parameter, so that the same code is used for all layouts
+   */
+
   /* cover one column:
    * - remove the column from the column header node list,
    * - remove all rows where the given column is 1
    */
-  void cover(unsigned int col);
+  template <class N> void cover(N m, unsigned int col);
 
   /* uncover the given column
    * this is the exact inverse operation of cover. It requires that the
@@ -87,13 +126,13 @@ class DonKnuthAssembler : public AssemblerInterface {
    *
    * will result in the same matrix as before
    */
-  void uncover(unsigned int col);
+  template <class N> void uncover(N m, unsigned int col);
 
   /* 2 helper functions that cover and uncover one
    * selected row
    */
-  void cover_row(register unsigned int r);
-  void uncover_row(register unsigned int r);
+  template <class N> void cover_row(N m, register unsigned int r);
+  template <class N> void uncover_row(N m, register unsigned int r);
 
   /* same as cover row, but aborting
    * as soon as one of the columns does contain a zero
@@ -128,12 +167,77 @@ class DonKnuthAssembler : public AssemblerInterface {
   unsigned int *rows;
   unsigned int *columns;
 
-  void iterativeMultiSearch(void);
+  /* the search places pieces up to this level, for the single threaded search
+   * this is piecenumber. For the parallel search the master thread stops at a lower
+   * level and hands the subtree below to the worker threads
+   */
+  unsigned int splitDepth;
+
+  /* the search ends, when it would backtrack above this level. This is 0
+   * except for the workers of the parallel search, where it is the split level
+   */
+  unsigned int minPos;
+
+  virtual void iterativeMultiSearch(void);
+  template <class N> void iterativeMultiSearch(N m);
+
+  /* cover or uncover all the rows and columns that are selected in the
+   * rows and columns stack up to pos
+   */
+  virtual void coverStack(void);
+  virtual void uncoverStack(void);
+  template <class N> void coverStack(N m);
+  template <class N> void uncoverStack(N m);
+
+  /* calculate the fraction of the search tree that comes before the current
+   * subtree at the given level and the fraction the subtree itself has
+   */
+  virtual void getFraction(unsigned int depth, float *before, float *weight) const;
+  template <class N> void getFraction(N m, unsigned int depth, float *before, float *weight) const;
+
+  template <class N> float getFinished(N m) const;
+
+  /* the number of threads for the search and the level where the search
+   * tree is split into the subtrees for the threads, 0 selects the level
+   * automatically
+   */
+  unsigned int threads;
+  unsigned int requestedSplitDepth;
+
+  /* the pool for the parallel search, it is kept until the assembler is deleted
+   * so that getFinished and getIterations can always access it
+   */
+  AssemblerThreadPool *pool;
+
+  /* the search function used when more than one thread is requested */
+  void parallelSearch(void);
+
+  /* called by the parallel search whenever the master thread reaches
+   * the split level, returns false, when the search has been stopped
+   */
+  bool addTask(void);
+
+  /* copy the search stack into the task and back */
+  void saveStack(DonKnuthTask *t) const;
+  void loadStack(const DonKnuthTask *t);
+
+  /* the subtrees found by splitSearch, when splitting is true addTask only collects
+   * the subtrees here instead of handing them to the pool
+   */
+  std::vector<DonKnuthTask *> subtrees;
+  unsigned int partCount;
+  bool splitting;
+
+  void clearSubtrees(void);
 
-  /* this function checks, if the given piece can be placed
-   * at the given position inside the result
+  /* when searching a part of a split search, this contains the rows of the
+   * subtree where the next part starts, the search ends there. When
+   * this is empty the search goes on until the end
    */
-  bool canPlace(const Voxel *piece, int x, int y, int z) const;
+  std::vector<unsigned int> partEnd;
+
+  friend class DonKnuthWorker;
+  friend class BitsetAssembler;
 
   /* this function creates the matrix for the search function
    * because we need to know how many nodes we need to allocate the
@@ -145,6 +249,11 @@ class DonKnuthAssembler : public AssemblerInterface {
    */
   int prepare(void);
 
+  /* find the placements of the piece orientations in jobs, this runs in all threads
+   * of the preparation at the same time, the orientations are handed out one by one
+   */
+  void preparePlacements(DonKnuthPrepareJobs *jobs);
+
   /* used by reduce to find out if the given position is a dead end
    * and will always lead to non solvable positions
    */
@@ -178,6 +287,19 @@ class DonKnuthAssembler : public AssemblerInterface {
    */
   unsigned int reducePiece;
 
+  /* the number of placements reduce has checked in the current round and
+   * the number of placements there were at the start of the round
+   */
+  unsigned int reduceChecked;
+  unsigned int reducePlacements;
+
+  /* check the given placements of a piece for reduce, dead is set for the placements
+   * that lead to a dead end. With several threads this runs in each thread at the same time,
+   * each on its own copy of the matrix, and the placements are handed out by shared
+   */
+  void reduceCheck(unsigned int piece, const std::vector<unsigned int> *placements,
+                   std::vector<char> *dead, DonKnuthReduceShared *shared);
+
   /* this vector contains the placement (transformation and position) for
    * a piece in a row
    */
@@ -296,6 +418,24 @@ class DonKnuthAssembler : public AssemblerInterface {
   DonKnuthAssembler(void);
   ~DonKnuthAssembler(void);
 
+  /* select the layout of the nodes for the search, this must be done
+   * before createMatrix, the default is the packed layout
+   */
+  void setNodeLayout(nodeLayout l) { layout = l; }
+
+ private:
+
+  /* create a copy of the matrix of another assembler, this is used for the
+   * worker threads of the parallel search, the matrix of the original must be
+   * in its initial state
+   */
+  DonKnuthAssembler(const DonKnuthAssembler *orig);
+
+  /* create such a copy with the right type, used for the worker threads */
+  virtual DonKnuthAssembler *clone(void) const;
+
+ public:
+
   /* functions that are overloaded from AssemblerInterface, for comments see there */
   errState createMatrix(const Problem *puz,
                         bool keepMirror,
@@ -307,13 +447,18 @@ class DonKnuthAssembler : public AssemblerInterface {
   int getErrorsParam() const override { return errorsParam; }
 
   virtual float getFinished(void) const;
+  virtual void getSearchDepths(std::vector<unsigned int> *depths) const;
   virtual void stop() { abbort = true; }
   virtual bool stopped(void) const { return !running; }
   virtual errState setPosition(const char *string, const char *version);
   virtual void save(XmlWriter &xml) const;
   virtual void reduce(void);
   virtual unsigned int getReducePiece(void) const { return reducePiece; }
-  virtual unsigned long getIterations() { return iterations; }
+  virtual void getReduceProgress(unsigned int *checked, unsigned int *total) const;
+  virtual unsigned long getIterations();
+  virtual void setThreads(unsigned int threads, unsigned int splitDepth = 0);
+  virtual unsigned int splitSearch(unsigned int parts);
+  virtual void selectPart(unsigned int part);
 
   /* some more special information to find out possible piece placements */
   bool getPiecePlacementSupported(void) const { return true; }
@@ -21,6 +21,7 @@
 #include "grid-type.h"
 
 #include "don-knuth-assembler.h"
+#include "bitset-assembler.h"
 #include "wei_hwa_huang_assembler.h"
 #include "movementcache_0.h"
 #include "movementcache_1.h"
@@ -209,6 +210,10 @@ unsigned int GridType::getCapabilities(void) const {
 }
 
 AssemblerInterface *GridType::findAssembler(const Problem *p) {
+  if (BitsetAssembler::canHandle(p)) {
+    fprintf(stderr, "using assembler 2\n");
+    return new BitsetAssembler();
+  }
   if (DonKnuthAssembler::canHandle(p)) {
     fprintf(stderr, "using assembler 0\n");
     return new DonKnuthAssembler();
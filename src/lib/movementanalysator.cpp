@@ -42,13 +42,20 @@ void movementAnalysator_c::prepare() {
   int idxCol = cache->numDirections();
   int idxRow = cache->numDirections() * (piecenumber - pieces->size());
 
+  /* get all positions of the node at once, most nodes only contain the difference
+   * to their come-from node and getting the positions one by one is slow
+   */
+  searchPos.resize(4 * pieces->size());
+  searchnode->getPositions(&searchPos[0]);
+  const int16_t *pos = &searchPos[0];
+
   for (unsigned int j = 0; j < pieces->size(); j++) {
     for (unsigned int i = 0; i < pieces->size(); i++) {
       if (i != j)
-        cache->getMoValue(searchnode->getX(j) - searchnode->getX(i),
-                          searchnode->getY(j) - searchnode->getY(i),
-                          searchnode->getZ(j) - searchnode->getZ(i),
-                          searchnode->getTrans(i), searchnode->getTrans(j),
+        cache->getMoValue(pos[4 * j + 0] - pos[4 * i + 0],
+                          pos[4 * j + 1] - pos[4 * i + 1],
+                          pos[4 * j + 2] - pos[4 * i + 2],
+                          (unsigned char) pos[4 * i + 3], (unsigned char) pos[4 * j + 3],
                           (*pieces)[i], (*pieces)[j], idx);
 
       // the diagonals are always zero and will stay that for ever they are initialized
@@ -296,10 +303,11 @@ bool movementAnalysator_c::checkmovement(unsigned int maxPieces,
   return true;
 }
 
-movementAnalysator_c::movementAnalysator_c(const Problem *puz) :
-    piecenumber(puz->pieceNumber()), maxstep((unsigned int) -1) {
+movementAnalysator_c::movementAnalysator_c(const Problem *puz, movementCache_c *c) :
+    piecenumber(puz->pieceNumber()), cache(c), ownCache(!c), maxstep((unsigned int) -1) {
 
-  cache = puz->getGridType()->getMovementCache(puz);
+  if (ownCache)
+    cache = puz->getGridType()->getMovementCache(puz);
   /* we assert that there must be a cache, otherwise no disassembly
    * analysis is possible anyway and this should not
    * have been called
@@ -333,7 +341,8 @@ movementAnalysator_c::~movementAnalysator_c() {
   delete[] movement;
   delete[] matrix;
 
-  delete cache;
+  if (ownCache)
+    delete cache;
   delete[] weights;
   delete nodes;
 }
@@ -381,7 +390,7 @@ disassemblerNode_c *movementAnalysator_c::newNode(unsigned int amount) {
   }
 
   disassemblerNode_c
-      *n = new disassemblerNode_c(pieces->size(), searchnode, nd, amount);
+      *n = disassemblerNode_c::create(pieces->size(), searchnode, nd, amount);
 
   /* create a new state with the pieces moved */
   for (unsigned int i = 0; i < pieces->size(); i++) {
@@ -428,6 +437,11 @@ disassemblerNode_c *movementAnalysator_c::newNode(unsigned int amount) {
     }
   }
 
+  /* the node will be put into hashtables, we know the positions of searchnode
+   * so this is the cheapest time to calculate the hash value
+   */
+  n->hash(&searchPos[0]);
+
   return n;
 }
 
@@ -460,16 +474,29 @@ disassemblerNode_c *movementAnalysator_c::newNodeMerge(const disassemblerNode_c
   int moved = 0;
   bool move0, move1;
 
+  mergePos0.resize(4 * next_pn);
+  mergePos1.resize(4 * next_pn);
+  const int16_t *ps = &searchPos[0];
+
+  // both nodes were created from searchnode
+  bt_assert(n0->getComefrom() == searchnode && n1->getComefrom() == searchnode);
+
+  n0->getPositions(&mergePos0[0], ps);
+  n1->getPositions(&mergePos1[0], ps);
+
+  const int16_t *p0 = &mergePos0[0];
+  const int16_t *p1 = &mergePos1[0];
+
   for (int i = 0; i < next_pn; i++) {
 
     // calculate the movement of the merged node by first finding out if the
     // piece has been moved within one node
-    move0 = ((n0->getX(i) != searchnode->getX(i)) ||
-        (n0->getY(i) != searchnode->getY(i)) ||
-        (n0->getZ(i) != searchnode->getZ(i))) ^ invert0;
-    move1 = ((n1->getX(i) != searchnode->getX(i)) ||
-        (n1->getY(i) != searchnode->getY(i)) ||
-        (n1->getZ(i) != searchnode->getZ(i))) ^ invert1;
+    move0 = ((p0[4 * i + 0] != ps[4 * i + 0]) ||
+        (p0[4 * i + 1] != ps[4 * i + 1]) ||
+        (p0[4 * i + 2] != ps[4 * i + 2])) ^ invert0;
+    move1 = ((p1[4 * i + 0] != ps[4 * i + 0]) ||
+        (p1[4 * i + 1] != ps[4 * i + 1]) ||
+        (p1[4 * i + 2] != ps[4 * i + 2])) ^ invert1;
 
     // and if it has been moved in one of them, it needs
     // to be moved in the new node
@@ -578,7 +605,7 @@ disassemblerNode_c *movementAnalysator_c::find() {
           // but first we check, if we have this node already found (maybe via a merger)
           // and if so we delete it
           if (nodes->insert(n)) {
-            delete n;
+            n->destroy();
             n = 0;
 
           } else {
@@ -630,7 +657,7 @@ disassemblerNode_c *movementAnalysator_c::find() {
           // if the node is valid check if we already know that node, if so
           // delete it
           if (n && nodes->insert(n)) {
-            delete n;
+            n->destroy();
             n = 0;
           }
 
@@ -731,7 +758,7 @@ void movementAnalysator_c::completeFind(disassemblerNode_c *searchnode,
   init_find(searchnode, pieces);
 
   for (unsigned int i = 0; i < result->size(); i++)
-    delete (*result)[i];
+    (*result)[i]->destroy();
   result->clear();
 
   disassemblerNode_c *nd;
@@ -756,6 +783,6 @@ void movementAnalysator_c::completeFind(disassemblerNode_c *searchnode,
   maxstep = (unsigned int) -1;
 
   for (unsigned int i = 0; i < toremove.size(); i++)
-    delete toremove[i];
+    toremove[i]->destroy();
 }
 
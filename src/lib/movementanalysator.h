@@ -23,6 +23,8 @@
 
 #include <vector>
 
+#include <stdint.h>
+
 class Problem;
 class disassemblerNode_c;
 class movementCache_c;
@@ -55,6 +57,7 @@ class movementAnalysator_c {
   unsigned int piecenumber;
 
   movementCache_c *cache;
+  bool ownCache;   // true, when the cache was created by us and we need to delete it
 
   countingNodeHash *nodes;
 
@@ -68,6 +71,11 @@ class movementAnalysator_c {
   disassemblerNode_c *searchnode;
   const std::vector<unsigned int> *pieces;
 
+  /* the positions of the pieces in searchnode and the 2 nodes merged
+   * in newNodeMerge, as returned by disassemblerNode_c::getPositions
+   */
+  std::vector<int16_t> searchPos, mergePos0, mergePos1;
+
   void prepare(void);
   bool checkmovement(unsigned int maxPieces, unsigned int nextstep);
   disassemblerNode_c *newNode(unsigned int amount);
@@ -80,8 +88,13 @@ class movementAnalysator_c {
    * construct the analysator for this concrete problem.
    * This can not be changed, once you done that but you can analyse
    * many positions
+   *
+   * The movement cache can be shared between several analysators for the same
+   * problem, also when they run in different threads. If cache is 0 the analysator
+   * creates its own cache, otherwise the given cache is used and it must stay
+   * alive until the analysator is deleted
    */
-  movementAnalysator_c(const Problem *puz);
+  movementAnalysator_c(const Problem *puz, movementCache_c *cache = 0);
   ~movementAnalysator_c(void);
 
   /* you use either the 2 functions below, or completeFind
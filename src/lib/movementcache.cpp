@@ -24,6 +24,22 @@
 #include "problem.h"
 
 #include <string.h>
+#include <stdio.h>
+#include <map>
+
+#ifdef WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+/* the default memory limit for the dense tables */
+#define DENSE_LIMIT (32ul * 1024 * 1024)
+
+/* the file format for the values kept in a file, see setFile */
+#define FILE_MAGIC "BTMC"
+#define FILE_VERSION 1
 
 /* the hash function. I don't know how well it performs, but it seems to be okay */
 static unsigned int moHashValue(unsigned int s1,
@@ -45,48 +61,71 @@ static unsigned int moHashValue(unsigned int s1,
 
 /* double the hash table size and copy the old elements into
  * the new table
+ *
+ * other threads might still be searching through the old table, so we
+ * must not change the entries in there. Instead the new table gets copies of
+ * the entries, which share the movement values with the old ones
  */
 void movementCache_c::moRehash() {
-  unsigned int oldSize = moTableSize;
+  const moTable *old = moHash.load(std::memory_order_relaxed);
 
   /* the new size, roughly twice the old size but odd */
-  moTableSize = 2 * moTableSize + 1;
-
-  /* allocate new table */
-  moEntry **newHash = new moEntry *[moTableSize];
-  memset(newHash, 0, moTableSize * sizeof(moEntry *));
+  moTable *t = new moTable;
+  t->size = 2 * old->size + 1;
+  t->buckets = new std::atomic<const moEntry *>[t->size];
+  for (unsigned int i = 0; i < t->size; i++)
+    t->buckets[i].store(0, std::memory_order_relaxed);
 
   /* copy the elements */
-  for (unsigned int i = 0; i < oldSize; i++) {
+  for (unsigned int i = 0; i < old->size; i++)
+    for (const moEntry *o = old->buckets[i].load(std::memory_order_relaxed); o; o = o->next) {
 
-    while (moHash[i]) {
+      moEntry *e = new moEntry(*o);
 
-      /* remove from old table */
-      moEntry *e = moHash[i];
-      moHash[i] = e->next;
-
-      /* enter into new one */
       unsigned int h =
           moHashValue(e->s1, e->s2, e->dx, e->dy, e->dz, e->t1, e->t2)
-              % moTableSize;
-      e->next = newHash[h];
-      newHash[h] = e;
+              % t->size;
+      e->next = t->buckets[h].load(std::memory_order_relaxed);
+      t->buckets[h].store(e, std::memory_order_relaxed);
     }
-  }
 
-  /* delete the old table and make the new table the current one */
-  delete[] moHash;
-  moHash = newHash;
+  /* keep the old table and make the new table the current one, the release
+   * makes sure that threads that see the new table also see its entries
+   */
+  moOldTables.push_back(moHash.load(std::memory_order_relaxed));
+  moHash.store(t, std::memory_order_release);
+}
+
+const movementCache_c::moEntry *movementCache_c::moFind(const moTable *t,
+                                                        unsigned int h,
+                                                        unsigned int s1,
+                                                        unsigned int s2,
+                                                        int dx,
+                                                        int dy,
+                                                        int dz,
+                                                        unsigned char t1,
+                                                        unsigned char t2) {
+
+  const moEntry *e = t->buckets[h % t->size].load(std::memory_order_acquire);
+
+  /* check the list of nodes in the current hash bucket */
+  while (e && (e->dx != dx || e->dy != dy || e->dz != dz ||
+      e->t1 != t1 || e->t2 != t2 || e->s1 != s1 || e->s2 != s2))
+    e = e->next;
+
+  return e;
 }
 
 movementCache_c::movementCache_c(const Problem *puzzle)
-    : gt(puzzle->getGridType()) {
+    : moEntries(0), moDenseBytes(0), moDenseLimit(DENSE_LIMIT), moFileDirs(0), moHits(0), moMisses(0), gt(puzzle->getGridType()) {
 
   /* initial table */
-  moTableSize = 101;
-  moHash = new moEntry *[moTableSize];
-  memset(moHash, 0, moTableSize * sizeof(moEntry *));
-  moEntries = 0;
+  moTable *t = new moTable;
+  t->size = 101;
+  t->buckets = new std::atomic<const moEntry *>[t->size];
+  for (unsigned int i = 0; i < t->size; i++)
+    t->buckets[i].store(0, std::memory_order_relaxed);
+  moHash.store(t, std::memory_order_relaxed);
 
   /* initialize the shape array with the shapes from the
    * puzzle problem. The shape with transformation 0 is just
@@ -97,13 +136,30 @@ movementCache_c::movementCache_c(const Problem *puzzle)
   num_transformations =
       puzzle->getGridType()->getSymmetries()->getNumTransformations();
 
-  shapes = new const Voxel **[num_shapes];
+  shapes = new std::atomic<const Voxel *> *[num_shapes];
   for (unsigned int s = 0; s < num_shapes; s++) {
-    shapes[s] = new const Voxel *[num_transformations];
-    memset(shapes[s], 0, num_transformations * sizeof(Voxel *));
-    shapes[s][0] = puzzle->getShapeShape(s);
+    shapes[s] = new std::atomic<const Voxel *>[num_transformations];
+    for (unsigned int t = 1; t < num_transformations; t++)
+      shapes[s][t].store(0, std::memory_order_relaxed);
+    shapes[s][0].store(puzzle->getShapeShape(s), std::memory_order_relaxed);
   }
 
+  /* the array for the dense tables, when this alone takes a good part of the
+   * memory limit, we don't use dense tables
+   */
+  unsigned long blocks = (unsigned long)num_shapes * num_shapes * num_transformations * num_transformations;
+
+  if (blocks * sizeof(std::atomic<const moBlock *>) <= moDenseLimit / 4) {
+    moBlocks = new std::atomic<const moBlock *>[blocks];
+    for (unsigned long i = 0; i < blocks; i++)
+      moBlocks[i].store(0, std::memory_order_relaxed);
+    moDenseBytes = blocks * sizeof(std::atomic<const moBlock *>);
+  } else
+    moBlocks = 0;
+
+  /* the marker for missing tables contains no offsets */
+  memset(&moNoBlock, 0, sizeof(moNoBlock));
+
   /* initialize the piece array */
   pieces = new unsigned int[puzzle->pieceNumber()];
 
@@ -117,18 +173,50 @@ movementCache_c::movementCache_c(const Problem *puzzle)
 
 movementCache_c::~movementCache_c() {
 
-  /* delete the hash nodes */
-  for (unsigned int i = 0; i < moTableSize; i++) {
+  /* save the values not yet in the file */
+  if (!moFileName.empty())
+    moWriteFile();
+
+  /* delete the hash nodes, the movement values are shared between the entries
+   * of all tables, so only delete them with the entries of the current table
+   */
+  moOldTables.push_back(moHash.load(std::memory_order_relaxed));
+
+  for (unsigned int j = 0; j < moOldTables.size(); j++) {
+
+    moTable *t = moOldTables[j];
+    bool current = (j + 1 == moOldTables.size());
+
+    for (unsigned int i = 0; i < t->size; i++) {
+
+      const moEntry *e = t->buckets[i].load(std::memory_order_relaxed);
+
+      while (e) {
+        const moEntry *n = e->next;
 
-    while (moHash[i]) {
-      moEntry *e = moHash[i];
-      moHash[i] = e->next;
+        if (current)
+          delete[] e->move;
+        delete e;
 
-      delete[] e->move;
-      delete e;
+        e = n;
+      }
     }
+    delete[] t->buckets;
+    delete t;
+  }
+
+  /* delete the dense tables */
+  if (moBlocks) {
+    unsigned long blocks = (unsigned long)num_shapes * num_shapes * num_transformations * num_transformations;
+    for (unsigned long i = 0; i < blocks; i++) {
+      const moBlock *b = moBlocks[i].load(std::memory_order_relaxed);
+      if (b && b != &moNoBlock) {
+        delete[] b->values;
+        delete b;
+      }
+    }
+    delete[] moBlocks;
   }
-  delete[] moHash;
 
   /* the shape with transformation 0 is just
    * a pointer into the puzzle, so don't delete them
@@ -137,8 +225,8 @@ movementCache_c::~movementCache_c() {
    */
   for (unsigned int s = 0; s < num_shapes; s++) {
     for (unsigned int t = 1; t < num_transformations; t++)
-      if (shapes[s][t])
-        delete shapes[s][t];
+      if (shapes[s][t].load(std::memory_order_relaxed))
+        delete shapes[s][t].load(std::memory_order_relaxed);
     delete[] shapes[s];
   }
 
@@ -149,17 +237,381 @@ movementCache_c::~movementCache_c() {
 const Voxel *movementCache_c::getTransformedShape(unsigned int s,
                                                   unsigned char t) {
 
-  if (!shapes[s][t]) {
+  const Voxel *res = shapes[s][t].load(std::memory_order_acquire);
+
+  if (!res) {
     // our required orientation doesn't exist, so we calculate it
 
-    Voxel *sh = gt->getVoxel(shapes[s][0]);
+    Voxel *sh = gt->getVoxel(shapes[s][0].load(std::memory_order_relaxed));
     bt_assert2(sh->transform(t));
 
-    // in the single threaded case simply enter our new shape
-    shapes[s][t] = sh;
+    /* enter our new shape, when another thread was faster, use its shape instead
+     * and throw ours away
+     */
+    if (shapes[s][t].compare_exchange_strong(res, sh, std::memory_order_acq_rel))
+      res = sh;
+    else
+      delete sh;
+  }
+
+  return res;
+}
+
+const movementCache_c::moBlock *movementCache_c::moNewBlock(unsigned int s1,
+                                                             unsigned char t1,
+                                                             unsigned int s2,
+                                                             unsigned char t2) {
+
+  boost::mutex::scoped_lock lock(moMutex);
+
+  std::atomic<const moBlock *> &slot = moBlocks[((s1 * num_transformations + t1) * num_shapes + s2) * num_transformations + t2];
+
+  /* another thread might have been faster */
+  if (slot.load(std::memory_order_relaxed))
+    return slot.load(std::memory_order_relaxed);
+
+  const Voxel *sh1 = getTransformedShape(s1, t1);
+  const Voxel *sh2 = getTransformedShape(s2, t2);
+
+  /* the offsets are relative to the hotspots, the range is so that the bounding boxes
+   * are at most one unit apart
+   */
+  int x1 = (int)sh1->boundX1() - (int)sh2->boundX2() - 1 - (sh1->getHx() - sh2->getHx());
+  int x2 = (int)sh1->boundX2() - (int)sh2->boundX1() + 1 - (sh1->getHx() - sh2->getHx());
+  int y1 = (int)sh1->boundY1() - (int)sh2->boundY2() - 1 - (sh1->getHy() - sh2->getHy());
+  int y2 = (int)sh1->boundY2() - (int)sh2->boundY1() + 1 - (sh1->getHy() - sh2->getHy());
+  int z1 = (int)sh1->boundZ1() - (int)sh2->boundZ2() - 1 - (sh1->getHz() - sh2->getHz());
+  int z2 = (int)sh1->boundZ2() - (int)sh2->boundZ1() + 1 - (sh1->getHz() - sh2->getHz());
+
+  unsigned int dirs = numDirections();
+  unsigned long size = (unsigned long)(x2 - x1 + 1) * (y2 - y1 + 1) * (z2 - z1 + 1) * dirs;
+  unsigned long bytes = sizeof(moBlock) + size * sizeof(std::atomic<uint16_t>);
+
+  if (moDenseBytes + bytes > moDenseLimit) {
+    slot.store(&moNoBlock, std::memory_order_release);
+    return &moNoBlock;
+  }
+
+  moBlock *b = new moBlock;
+  b->s1 = s1;
+  b->s2 = s2;
+  b->t1 = t1;
+  b->t2 = t2;
+  b->x1 = x1;
+  b->y1 = y1;
+  b->z1 = z1;
+  b->sx = x2 - x1 + 1;
+  b->sy = y2 - y1 + 1;
+  b->sz = z2 - z1 + 1;
+  b->dirs = dirs;
+  b->values = new std::atomic<uint16_t>[size];
+  for (unsigned long i = 0; i < size; i++)
+    b->values[i].store(moUnknown, std::memory_order_relaxed);
+
+  moDenseBytes += bytes;
+
+  slot.store(b, std::memory_order_release);
+  return b;
+}
+
+/* a hash of all the properties of a shape that influence the movement values:
+ * the size, the hotspot and the state of all voxels. The FNV-1a hash
+ */
+static uint64_t shapeHash(const Voxel *v) {
+
+  uint64_t h = 14695981039346656037ull;
+
+  int head[6] = { (int)v->getX(), (int)v->getY(), (int)v->getZ(), v->getHx(), v->getHy(), v->getHz() };
+
+  for (unsigned int i = 0; i < 6; i++)
+    for (unsigned int b = 0; b < 4; b++) {
+      h ^= (head[i] >> (8 * b)) & 0xFF;
+      h *= 1099511628211ull;
+    }
+
+  for (unsigned int i = 0; i < v->getXYZ(); i++) {
+    h ^= v->getState(i);
+    h *= 1099511628211ull;
+  }
+
+  return h;
+}
+
+/* the size of one record in the file: the 2 shape hashes, the 2 orientations,
+ * the offset and the values
+ */
+static unsigned int recordSize(unsigned int dirs) {
+  return 2 * sizeof(uint64_t) + 2 * sizeof(uint8_t) + 3 * sizeof(int16_t) + dirs * sizeof(uint16_t);
+}
+
+/* cut the file to the given size, returns false when that fails */
+static bool truncateFile(const char *name, long size) {
+#ifdef WIN32
+  int fd = _open(name, _O_RDWR | _O_BINARY);
+  if (fd < 0)
+    return false;
+  bool res = _chsize(fd, size) == 0;
+  _close(fd);
+  return res;
+#else
+  return truncate(name, size) == 0;
+#endif
+}
+
+bool movementCache_c::setFile(const char *name) {
+
+  moFileDirs = numDirections();
+
+  moShapeHashes.resize(num_shapes);
+  for (unsigned int s = 0; s < num_shapes; s++)
+    moShapeHashes[s] = shapeHash(shapes[s][0].load(std::memory_order_relaxed));
+
+  /* the shapes with a given hash, several shapes of the puzzle might be identical */
+  std::multimap<uint64_t, unsigned int> shapeIds;
+  for (unsigned int s = 0; s < num_shapes; s++)
+    shapeIds.insert(std::make_pair(moShapeHashes[s], s));
+
+  FILE *f = fopen(name, "rb");
+
+  if (f) {
+
+    char magic[4];
+    uint32_t head[3];
+
+    /* the length of the file up to the end of the last complete record, a
+     * write that was interrupted may have left a part of a record or header behind
+     */
+    long valid = 0;
+
+    size_t magicLen = fread(magic, 1, 4, f);
+
+    if (magicLen == 4 && fread(head, sizeof(uint32_t), 3, f) == 3) {
+
+      if (memcmp(magic, FILE_MAGIC, 4) != 0 || head[0] != FILE_VERSION ||
+          head[1] != (uint32_t)gt->getType() || head[2] != moFileDirs) {
+        fclose(f);
+        return false;
+      }
+
+      /* read the records, a partial record at the end is ignored */
+      std::vector<unsigned char> rec(recordSize(moFileDirs));
+
+      valid = 4 + 3 * sizeof(uint32_t);
+
+      while (fread(&rec[0], rec.size(), 1, f) == 1) {
+
+        valid += rec.size();
+
+        uint64_t h1, h2;
+        int16_t d[3];
+
+        const unsigned char *r = &rec[0];
+        memcpy(&h1, r, sizeof(uint64_t)); r += sizeof(uint64_t);
+        memcpy(&h2, r, sizeof(uint64_t)); r += sizeof(uint64_t);
+        unsigned char t1 = *r++;
+        unsigned char t2 = *r++;
+        memcpy(d, r, 3 * sizeof(int16_t)); r += 3 * sizeof(int16_t);
+
+        if (t1 >= num_transformations || t2 >= num_transformations)
+          continue;
+
+        std::multimap<uint64_t, unsigned int>::const_iterator i1 = shapeIds.lower_bound(h1);
+        std::multimap<uint64_t, unsigned int>::const_iterator e1 = shapeIds.upper_bound(h1);
+
+        for (; i1 != e1; i1++) {
+
+          std::multimap<uint64_t, unsigned int>::const_iterator i2 = shapeIds.lower_bound(h2);
+          std::multimap<uint64_t, unsigned int>::const_iterator e2 = shapeIds.upper_bound(h2);
+
+          for (; i2 != e2; i2++) {
+
+            unsigned int *move = new unsigned int[moFileDirs];
+            for (unsigned int i = 0; i < moFileDirs; i++) {
+              uint16_t m;
+              memcpy(&m, r + i * sizeof(uint16_t), sizeof(uint16_t));
+              move[i] = m;
+            }
+
+            moEnter(i1->second, t1, i2->second, t2, d[0], d[1], d[2], move);
+          }
+        }
+      }
+
+    } else if (memcmp(magic, FILE_MAGIC, magicLen) != 0) {
+      // too short for a header and not the start of one, this is not our file
+      fclose(f);
+      return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+
+    fclose(f);
+
+    /* the new records are appended, so the rest must go, otherwise they would
+     * be misaligned, without a complete header the file starts anew
+     */
+    if (size > valid && !truncateFile(name, valid))
+      return false;
+  }
+
+  moFileName = name;
+  return true;
+}
+
+void movementCache_c::moRecord(unsigned int s1,
+                               unsigned char t1,
+                               unsigned int s2,
+                               unsigned char t2,
+                               int dx,
+                               int dy,
+                               int dz,
+                               const unsigned int *move) {
+
+  /* values that don't fit into the record are not saved */
+  if (dx < INT16_MIN || dx > INT16_MAX || dy < INT16_MIN || dy > INT16_MAX || dz < INT16_MIN || dz > INT16_MAX)
+    return;
+
+  for (unsigned int i = 0; i < moFileDirs; i++)
+    if (move[i] > UINT16_MAX)
+      return;
+
+  std::vector<unsigned char> rec(recordSize(moFileDirs));
+  unsigned char *r = &rec[0];
+
+  int16_t d[3] = { (int16_t)dx, (int16_t)dy, (int16_t)dz };
+
+  memcpy(r, &moShapeHashes[s1], sizeof(uint64_t)); r += sizeof(uint64_t);
+  memcpy(r, &moShapeHashes[s2], sizeof(uint64_t)); r += sizeof(uint64_t);
+  *r++ = t1;
+  *r++ = t2;
+  memcpy(r, d, 3 * sizeof(int16_t)); r += 3 * sizeof(int16_t);
+  for (unsigned int i = 0; i < moFileDirs; i++) {
+    uint16_t m = move[i];
+    memcpy(r + i * sizeof(uint16_t), &m, sizeof(uint16_t));
   }
 
-  return shapes[s][t];
+  boost::mutex::scoped_lock lock(moMutex);
+
+  moFileRecords.insert(moFileRecords.end(), rec.begin(), rec.end());
+
+  /* don't collect too much, so that not too much is lost when the program is stopped */
+  if (moFileRecords.size() > 1024 * 1024)
+    moWriteFile();
+}
+
+void movementCache_c::moWriteFile(void) {
+
+  if (moFileRecords.empty())
+    return;
+
+  FILE *f = fopen(moFileName.c_str(), "ab");
+
+  if (f) {
+
+    /* a new file gets the header first */
+    fseek(f, 0, SEEK_END);
+
+    if (ftell(f) == 0) {
+      uint32_t head[3] = { FILE_VERSION, (uint32_t)gt->getType(), moFileDirs };
+      fwrite(FILE_MAGIC, 1, 4, f);
+      fwrite(head, sizeof(uint32_t), 3, f);
+    }
+
+    fwrite(&moFileRecords[0], 1, moFileRecords.size(), f);
+    fclose(f);
+  }
+
+  moFileRecords.clear();
+}
+
+std::atomic<uint16_t> *movementCache_c::moDenseCell(unsigned int s1,
+                                                   unsigned char t1,
+                                                   unsigned int s2,
+                                                   unsigned char t2,
+                                                   int dx,
+                                                   int dy,
+                                                   int dz) {
+  if (!moBlocks)
+    return 0;
+
+  const moBlock *b = moBlocks[((s1 * num_transformations + t1) * num_shapes + s2) * num_transformations + t2].load(std::memory_order_acquire);
+
+  if (!b)
+    b = moNewBlock(s1, t1, s2, t2);
+
+  unsigned int x = dx - b->x1;
+  unsigned int y = dy - b->y1;
+  unsigned int z = dz - b->z1;
+
+  if (x < b->sx && y < b->sy && z < b->sz)
+    return b->values + ((z * b->sy + y) * b->sx + x) * b->dirs;
+
+  return 0;
+}
+
+void movementCache_c::moEnter(unsigned int s1,
+                              unsigned char t1,
+                              unsigned int s2,
+                              unsigned char t2,
+                              int dx,
+                              int dy,
+                              int dz,
+                              unsigned int *move) {
+
+  unsigned int dirs = numDirections();
+
+  /* when the values belong into a dense table, enter them there, when they
+   * don't fit into the table, which doesn't happen with the current grids,
+   * use the hash table
+   */
+  std::atomic<uint16_t> *v = moDenseCell(s1, t1, s2, t2, dx, dy, dz);
+
+  if (v) {
+
+    bool fits = true;
+    for (unsigned int d = 0; d < dirs; d++)
+      if (move[d] >= moUnknown)
+        fits = false;
+
+    if (fits) {
+      for (unsigned int d = 0; d < dirs; d++)
+        v[d].store(move[d], std::memory_order_relaxed);
+      delete[] move;
+      return;
+    }
+  }
+
+  unsigned int h = moHashValue(s1, s2, dx, dy, dz, t1, t2);
+
+  boost::mutex::scoped_lock lock(moMutex);
+
+  /* another thread might have entered the same values in the meantime
+   * and the table might have been rehashed, so search again in the current table
+   */
+  if (moFind(moHash.load(std::memory_order_relaxed), h, s1, s2, dx, dy, dz, t1, t2)) {
+    delete[] move;
+    return;
+  }
+
+  /* enter a new node into the table */
+  moEntry *n = new moEntry;
+  n->dx = dx;
+  n->dy = dy;
+  n->dz = dz;
+  n->t1 = t1;
+  n->t2 = t2;
+  n->s1 = s1;
+  n->s2 = s2;
+  n->move = move;
+
+  if (++moEntries > moHash.load(std::memory_order_relaxed)->size) moRehash();
+
+  moTable *t = moHash.load(std::memory_order_relaxed);
+
+  /* the release makes sure that other threads that find the entry also see its content */
+  n->next = t->buckets[h % t->size].load(std::memory_order_relaxed);
+  t->buckets[h % t->size].store(n, std::memory_order_release);
 }
 
 void movementCache_c::getMoValue(int dx,
@@ -174,38 +626,51 @@ void movementCache_c::getMoValue(int dx,
   unsigned int s1 = pieces[p1];
   unsigned int s2 = pieces[p2];
 
-  unsigned int h = moHashValue(s1, s2, dx, dy, dz, t1, t2);
+  /* first try the dense table */
+  std::atomic<uint16_t> *v = moDenseCell(s1, t1, s2, t2, dx, dy, dz);
 
-  moEntry *e = moHash[h % moTableSize];
+  if (v) {
 
-  /* check the list of nodes in the current hash bucket */
-  while (e && (e->dx != dx || e->dy != dy || e->dz != dz ||
-      e->t1 != t1 || e->t2 != t2 || e->s1 != s1 || e->s2 != s2))
-    e = e->next;
+    /* the values are independent of each other, so it is enough that each
+     * is either unknown or correct
+     */
+    unsigned int dirs = numDirections();
+    unsigned int d = 0;
+
+    while (d < dirs) {
+      uint16_t m = v[d].load(std::memory_order_relaxed);
+      if (m == moUnknown) break;
+      movements[d] = m;
+      d++;
+    }
 
-  /* check, if we found the required node */
-  if (!e) {
-    /* no is not found, enter a new node into the table */
-    e = new moEntry;
-    e->dx = dx;
-    e->dy = dy;
-    e->dz = dz;
-    e->t1 = t1;
-    e->t2 = t2;
-    e->s1 = s1;
-    e->s2 = s2;
-    e->move = moCalcValues(getTransformedShape(s1, t1),
-                           getTransformedShape(s2, t2),
-                           dx,
-                           dy,
-                           dz);
-
-    if (++moEntries > moTableSize) moRehash();
-
-    e->next = moHash[h % moTableSize];
-    moHash[h % moTableSize] = e;
+    if (d == dirs) {
+      moHits.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+  } else {
+
+    const moEntry *e = moFind(moHash.load(std::memory_order_acquire),
+                              moHashValue(s1, s2, dx, dy, dz, t1, t2),
+                              s1, s2, dx, dy, dz, t1, t2);
+
+    if (e) {
+      memcpy(movements, e->move, numDirections() * sizeof(unsigned int));
+      moHits.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
   }
 
-  /* return the values */
-  memcpy(movements, e->move, numDirections() * sizeof(unsigned int));
+  moMisses.fetch_add(1, std::memory_order_relaxed);
+
+  /* not found, calculate the values without holding the lock and enter them */
+  unsigned int *move = moCalcValues(s1, t1, s2, t2, dx, dy, dz);
+
+  memcpy(movements, move, numDirections() * sizeof(unsigned int));
+
+  if (!moFileName.empty())
+    moRecord(s1, t1, s2, t2, dx, dy, dz, move);
+
+  moEnter(s1, t1, s2, t2, dx, dy, dz, move);
 }
@@ -21,6 +21,14 @@
 #ifndef __MOVEMENTCACHE_H__
 #define __MOVEMENTCACHE_H__
 
+#include <atomic>
+#include <vector>
+#include <string>
+
+#include <stdint.h>
+
+#include <boost/thread/mutex.hpp>
+
 class Voxel;
 class Problem;
 class GridType;
@@ -40,6 +48,18 @@ class GridType;
  * are not inside the table.
  *
  * So only the derived classes do actually calculate something.
+ *
+ * The cache can be shared by several threads, e.g. the disassemblers of one
+ * problem running in parallel. Looking up values doesn't lock, entries are
+ * never changed or removed once they are in the table. Only adding new
+ * entries is done while holding a mutex, the calculation of the values
+ * itself is done without the lock.
+ *
+ * Most lookups are for pieces whose bounding boxes touch or overlap. For these
+ * offsets there is a dense table for each combination of shapes and orientations,
+ * so that the lookup is a simple array access. The values in these tables are
+ * calculated when they are first required. When the dense tables would use more
+ * than a given amount of memory, the remaining values are stored in the hash table.
  */
 class movementCache_c {
 
@@ -68,23 +88,101 @@ class movementCache_c {
     /** the possible movement in positive directions */
     unsigned int *move;
 
-    /** next in the linked list of the hash table */
-    struct moEntry *next;
+    /** next in the linked list of the hash table, this is set before the entry is entered into the table */
+    const struct moEntry *next;
 
   } moEntry;
 
-  /** the hash table */
-  moEntry **moHash;
+  /** a hash table, the buckets point to the first entry of the linked list */
+  typedef struct {
+    unsigned int size;
+    std::atomic<const moEntry *> *buckets;
+  } moTable;
+
+  /** the current hash table */
+  std::atomic<moTable *> moHash;
+
+  /**
+   * the tables replaced by moRehash. Other threads might still be searching
+   * through them, so they and their entries are only freed in the destructor.
+   * The tables grow by a factor of 2, so these take at most as much memory as the
+   * current table
+   */
+  std::vector<moTable *> moOldTables;
 
-  unsigned int moTableSize; ///< size of the hash table
   unsigned int moEntries;   ///< number of entries in the table
 
+  /** held while entering values into the table and while creating dense tables */
+  boost::mutex moMutex;
+
+  /**
+   * a dense table for one combination of shapes and orientations, it contains the values
+   * for all offsets inside a box, that is large enough so that the bounding boxes
+   * of the 2 shapes touch or overlap
+   */
+  typedef struct {
+    unsigned int s1, s2;   ///< the 2 shapes
+    unsigned char t1, t2;  ///< and their orientations
+
+    int x1, y1, z1;           ///< the smallest offset inside the table
+    unsigned int sx, sy, sz;  ///< the number of offsets in each direction
+    unsigned int dirs;        ///< the number of values for one offset
+
+    /** the values, moUnknown for values not yet calculated */
+    std::atomic<uint16_t> *values;
+  } moBlock;
+
+  static const uint16_t moUnknown = 0xFFFF;
+
+  /**
+   * the dense tables, one for each combination of 2 shapes and 2 orientations,
+   * 0 when it has not yet been created, moNoBlock when it didn't fit into the memory limit.
+   * The whole array is 0 when not even this array fits. moNoBlock is empty, so
+   * lookups in it always fail
+   */
+  std::atomic<const moBlock *> *moBlocks;
+  moBlock moNoBlock;
+
+  unsigned long moDenseBytes;  ///< memory used by the dense tables, changed while holding moMutex
+  unsigned long moDenseLimit;  ///< and the maximum
+
+  /** create the dense table, returns moNoBlock when the table doesn't fit, takes moMutex */
+  const moBlock *moNewBlock(unsigned int s1, unsigned char t1, unsigned int s2, unsigned char t2);
+
+  /** the values for the given offset inside the dense table, or 0 when they are not inside a dense table */
+  std::atomic<uint16_t> *moDenseCell(unsigned int s1, unsigned char t1, unsigned int s2, unsigned char t2,
+                                     int dx, int dy, int dz);
+
+  /** enter calculated values into the dense or the hash table, move is then owned by the cache */
+  void moEnter(unsigned int s1, unsigned char t1, unsigned int s2, unsigned char t2,
+               int dx, int dy, int dz, unsigned int *move);
+
+  /** the file the values are saved in, empty when none is used */
+  std::string moFileName;
+
+  /** the number of values per record in the file, and a hash of each shape to identify it in the file */
+  unsigned int moFileDirs;
+  std::vector<uint64_t> moShapeHashes;
+
+  /** records not yet written into the file, changed while holding moMutex */
+  std::vector<unsigned char> moFileRecords;
+
+  /** add the values to the records for the file, takes moMutex */
+  void moRecord(unsigned int s1, unsigned char t1, unsigned int s2, unsigned char t2,
+                int dx, int dy, int dz, const unsigned int *move);
+
+  /** append the records to the file, call with moMutex held */
+  void moWriteFile(void);
+
+  /** the counters for getStatistics */
+  std::atomic<unsigned long> moHits, moMisses;
+
   /**
    * Saves the shapes in all orientations.
    * The voxel spaces are calculated on demand. The entry at the zero-th position are
    * pointers into the puzzle, so we must not free them
    */
-  const Voxel ***shapes;
+  std::atomic<const Voxel *> **shapes;
 
   /** the mapping of piece numbers to shape ids */
   unsigned int *pieces;
@@ -95,11 +193,28 @@ class movementCache_c {
   /** number of possible transformations for each shape */
   unsigned int num_transformations;
 
-  void moRehash(void); ///< this function resizes the hash table to roughly twice the size
+  void moRehash(void); ///< this function resizes the hash table to roughly twice the size, call with moMutex held
+
+  /** find an entry in the given table, returns 0 when it is not in there */
+  static const moEntry *moFind(const moTable *t,
+                               unsigned int h,
+                               unsigned int s1,
+                               unsigned int s2,
+                               int dx,
+                               int dy,
+                               int dz,
+                               unsigned char t1,
+                               unsigned char t2);
 
-  /** when the entry is not inside the table, this function calculates the values for the movement info */
-  virtual unsigned int *moCalcValues(const Voxel *sh1,
-                                     const Voxel *sh2,
+  /**
+   * when the entry is not inside the table, this function calculates the values for the movement info
+   * for shape s2 in orientation t2 at offset dx, dy, dz relative to shape s1 in orientation t1.
+   * This is called without holding moMutex, so it may be called by several threads at the same time
+   */
+  virtual unsigned int *moCalcValues(unsigned int s1,
+                                     unsigned char t1,
+                                     unsigned int s2,
+                                     unsigned char t2,
                                      int dx,
                                      int dy,
                                      int dz) = 0;
@@ -107,9 +222,15 @@ class movementCache_c {
   /// the gridtype used. We need this to make copies and transformations of the shapes
   const GridType *gt;
 
-  /// get the transformed shape from the shapes array, calculating missing ones
+ protected:
+
+  /// get the transformed shape from the shapes array, calculating missing ones, this can be called by several threads
   const Voxel *getTransformedShape(unsigned int s, unsigned char t);
 
+  /// the number of shapes and orientations, the ids given to moCalcValues are below these values
+  unsigned int getNumShapes(void) const { return num_shapes; }
+  unsigned int getNumTransformations(void) const { return num_transformations; }
+
  public:
 
   /** create the cache. The cache is then fixed to the puzzle and the problem, it can
@@ -119,12 +240,35 @@ class movementCache_c {
 
   virtual ~movementCache_c(void);
 
+  /**
+   * set the memory in bytes that the dense tables may use, 0 stops creating new dense tables.
+   * This only affects tables created afterwards, so call it before the first getMoValue
+   */
+  void setDenseLimit(unsigned long bytes) { moDenseLimit = bytes; }
+
+  /**
+   * keep the values in a file, so that later runs don't need to calculate them again.
+   *
+   * The values in the file are entered into the cache and the values calculated
+   * afterwards are appended to the file. A partial record at the end, left by a
+   * write that was interrupted, is cut off. The shapes are identified by their content,
+   * so one file can be used for many puzzles and problems, they only need to use the same grid.
+   * Returns false when the file can not be used because it is for another grid or
+   * was written on a machine with a different byte order, the cache then works
+   * without file.
+   *
+   * Call it before the first getMoValue
+   */
+  bool setFile(const char *name);
+
   /**
    * return the values, that are:
    * how far can the 2nd piece be moved in positive x, y and z direction, when
    * the 2nd piece is offset by dx, dy and dz relative to the first,
    * the 2 pieces are the pieces p1 and p2 from the puzzle and problem defined in the constructor
    * and the 2 pieces are transformed by t1 and t2
+   *
+   * this function may be called by several threads at the same time
    */
   void getMoValue(int dx,
                   int dy,
@@ -144,6 +288,15 @@ class movementCache_c {
   /** return the movement vector of the given direction */
   virtual void getDirection(unsigned int dir, int *x, int *y, int *z) = 0;
 
+  /**
+   * the number of calls to getMoValue that found the values in the table and the number
+   * of calls that had to calculate them. This can be called at any time by any thread
+   */
+  void getStatistics(unsigned long *hits, unsigned long *misses) const {
+    *hits = moHits;
+    *misses = moMisses;
+  }
+
  private:
 
   // no copying and assigning
@@ -22,22 +22,236 @@
 
 #include "voxel.h"
 
+#include <string.h>
+
 #define NUM_DIRECTIONS 3
 
 movementCache_0_c::movementCache_0_c(const Problem *puz)
     : movementCache_c(puz) {
+
+  unsigned int n = getNumShapes() * getNumTransformations();
+
+  shapeRowCache = new std::atomic<const shapeRows *>[n];
+  for (unsigned int i = 0; i < n; i++)
+    shapeRowCache[i].store(0, std::memory_order_relaxed);
+}
+
+movementCache_0_c::~movementCache_0_c(void) {
+
+  unsigned int n = getNumShapes() * getNumTransformations();
+
+  for (unsigned int i = 0; i < n; i++) {
+    const shapeRows *r = shapeRowCache[i].load(std::memory_order_relaxed);
+    if (r) {
+      for (unsigned int a = 0; a < 3; a++)
+        delete[] r->rows[a];
+      delete r;
+    }
+  }
+
+  delete[] shapeRowCache;
 }
 
 static int min(int a, int b) { if (a < b) return a; else return b; }
 static int max(int a, int b) { if (a > b) return a; else return b; }
 
+/* the position of the lowest set bit of a word that is not 0 */
+static inline int lowestBit(uint64_t s) {
+#ifdef __GNUC__
+  return __builtin_ctzll(s);
+#else
+  int res = 0;
+
+  while (!(s & 1)) {
+    s >>= 1;
+    res++;
+  }
+
+  return res;
+#endif
+}
+
+/* the position of the highest set bit of a word that is not 0 */
+static inline int highestBit(uint64_t s) {
+#ifdef __GNUC__
+  return 63 - __builtin_clzll(s);
+#else
+  int res = 63;
+
+  while (!(s & (1ull << 63))) {
+    s <<= 1;
+    res--;
+  }
+
+  return res;
+#endif
+}
+
+/* the largest shapes that fit into the rows, 2 overlapping rows must fit into 64 bits */
+#define MAX_ROW 32
+
+const movementCache_0_c::shapeRows *movementCache_0_c::getRows(unsigned int s, unsigned char t) {
+
+  std::atomic<const shapeRows *> &slot = shapeRowCache[s * getNumTransformations() + t];
+
+  const shapeRows *res = slot.load(std::memory_order_acquire);
+
+  if (res)
+    return res;
+
+  const Voxel *sh = getTransformedShape(s, t);
+
+  shapeRows *r = new shapeRows;
+
+  r->lo[0] = sh->boundX1();
+  r->lo[1] = sh->boundY1();
+  r->lo[2] = sh->boundZ1();
+  r->size[0] = sh->boundX2() - sh->boundX1() + 1;
+  r->size[1] = sh->boundY2() - sh->boundY1() + 1;
+  r->size[2] = sh->boundZ2() - sh->boundZ1() + 1;
+  r->hot[0] = sh->getHx();
+  r->hot[1] = sh->getHy();
+  r->hot[2] = sh->getHz();
+
+  r->fits = r->size[0] <= MAX_ROW && r->size[1] <= MAX_ROW && r->size[2] <= MAX_ROW;
+
+  if (r->fits) {
+
+    r->rows[0] = new uint64_t[r->size[1] * r->size[2]];
+    r->rows[1] = new uint64_t[r->size[0] * r->size[2]];
+    r->rows[2] = new uint64_t[r->size[0] * r->size[1]];
+
+    memset(r->rows[0], 0, r->size[1] * r->size[2] * sizeof(uint64_t));
+    memset(r->rows[1], 0, r->size[0] * r->size[2] * sizeof(uint64_t));
+    memset(r->rows[2], 0, r->size[0] * r->size[1] * sizeof(uint64_t));
+
+    for (int z = 0; z < r->size[2]; z++)
+      for (int y = 0; y < r->size[1]; y++)
+        for (int x = 0; x < r->size[0]; x++)
+          if (sh->isFilled2(x + r->lo[0], y + r->lo[1], z + r->lo[2])) {
+            r->rows[0][z * r->size[1] + y] |= 1ull << x;
+            r->rows[1][z * r->size[0] + x] |= 1ull << y;
+            r->rows[2][y * r->size[0] + x] |= 1ull << z;
+          }
+
+  } else
+    r->rows[0] = r->rows[1] = r->rows[2] = 0;
+
+  /* when another thread was faster use its rows */
+  if (slot.compare_exchange_strong(res, r, std::memory_order_acq_rel))
+    return r;
+
+  for (unsigned int a = 0; a < 3; a++)
+    delete[] r->rows[a];
+  delete r;
+
+  return res;
+}
+
+/* find the smallest gap in positive direction of axis a from a voxel of the first to a voxel
+ * of the second piece, when the second piece is placed at offset d relative to the first,
+ * with the offset between the voxel spaces, not the hotspots. The result is at most max
+ */
+static unsigned int rowGap(const int *lo1, const int *size1, const uint64_t *rows1,
+                           const int *lo2, const int *size2, const uint64_t *rows2,
+                           const int *d, unsigned int a, unsigned int max) {
+
+  /* the other 2 axes, the rows are indexed by c * size b + b */
+  static const unsigned int other[3][2] = {{1, 2}, {0, 2}, {0, 1}};
+  unsigned int b = other[a][0];
+  unsigned int c = other[a][1];
+
+  /* the lines that both pieces have in common */
+  int b1 = ::max(lo1[b], lo2[b] + d[b]);
+  int b2 = ::min(lo1[b] + size1[b], lo2[b] + d[b] + size2[b]);
+  int c1 = ::max(lo1[c], lo2[c] + d[c]);
+  int c2 = ::min(lo1[c] + size1[c], lo2[c] + d[c] + size2[c]);
+
+  /* where the rows start along the axis, if the pieces overlap along the axis
+   * both rows fit into one word starting at the smaller start, otherwise
+   * all voxels of one piece are in front of all voxels of the other piece
+   */
+  int startA = lo1[a];
+  int startB = lo2[a] + d[a];
+  int start = ::min(startA, startB);
+  bool overlap = (startA + size1[a] - start <= 64) && (startB + size2[a] - start <= 64);
+
+  for (int cc = c1; cc < c2; cc++)
+    for (int bb = b1; bb < b2; bb++) {
+
+      uint64_t A = rows1[(cc - lo1[c]) * size1[b] + (bb - lo1[b])];
+      uint64_t B = rows2[(cc - d[c] - lo2[c]) * size2[b] + (bb - d[b] - lo2[b])];
+
+      if (!A || !B) continue;
+
+      if (overlap) {
+
+        /* voxels filled by both pieces count for the first one, then
+         * the gap for each voxel of the second piece is the distance to
+         * the nearest voxel of the first piece below it
+         */
+        A <<= startA - start;
+        B <<= startB - start;
+        B &= ~A;
+
+        while (B) {
+
+          int p = lowestBit(B);
+          uint64_t below = A & ((1ull << p) - 1);
+
+          if (below) {
+            unsigned int gap = p - highestBit(below) - 1;
+            if (gap < max) max = gap;
+          }
+
+          B &= B - 1;
+        }
+
+      } else if (startB > startA) {
+
+        /* the gap between the last voxel of the first and the first voxel of the second piece */
+        unsigned int gap = (startB + lowestBit(B)) - (startA + highestBit(A)) - 1;
+        if (gap < max) max = gap;
+      }
+    }
+
+  return max;
+}
+
 /* calculate the required movement possibilities */
-unsigned int *movementCache_0_c::moCalcValues(const Voxel *sh1,
-                                              const Voxel *sh2,
+unsigned int *movementCache_0_c::moCalcValues(unsigned int s1,
+                                              unsigned char t1,
+                                              unsigned int s2,
+                                              unsigned char t2,
                                               int dx,
                                               int dy,
                                               int dz) {
 
+  const shapeRows *r1 = getRows(s1, t1);
+  const shapeRows *r2 = getRows(s2, t2);
+
+  if (r1->fits && r2->fits) {
+
+    /* because the dx, dy and dz values are calculated using the hotspot we need to reverse
+     * that process
+     */
+    int d[3];
+    d[0] = dx + r1->hot[0] - r2->hot[0];
+    d[1] = dy + r1->hot[1] - r2->hot[1];
+    d[2] = dz + r1->hot[2] - r2->hot[2];
+
+    unsigned int *move = new unsigned int[NUM_DIRECTIONS];
+
+    for (unsigned int a = 0; a < NUM_DIRECTIONS; a++)
+      move[a] = rowGap(r1->lo, r1->size, r1->rows[a], r2->lo, r2->size, r2->rows[a], d, a, 32000);
+
+    return move;
+  }
+
+  /* the shapes are too large for the rows, check voxel by voxel */
+  const Voxel *sh1 = getTransformedShape(s1, t1);
+  const Voxel *sh2 = getTransformedShape(s2, t2);
+
   /* because the dx, dy and dz values are calculated using the hotspot we need to reverse
    * that process
    */
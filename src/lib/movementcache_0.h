@@ -24,16 +24,50 @@
 #include "movementcache.h"
 
 /** the movement cache for the cube grid */
+/**
+ * the movement cache for cubes.
+ *
+ * The values are calculated using rows of bits: for each orientation of each
+ * shape and each of the 3 axes there is a 64 bit word for each line of voxels
+ * along that axis with one bit for each filled voxel. The gap between 2 pieces
+ * along a line is then found with a few shifts and ands instead of looking at
+ * each voxel. Shapes that are larger than 32 voxels in one direction don't fit
+ * into the words, for those the voxels are checked one by one.
+ */
 class movementCache_0_c : public movementCache_c {
 
  public:
 
   movementCache_0_c(const Problem *puz);
+  ~movementCache_0_c(void);
 
  private:
 
-  unsigned int *moCalcValues(const Voxel *sh1,
-                             const Voxel *sh2,
+  /** the rows of bits of one orientation of one shape */
+  typedef struct {
+    bool fits;                ///< false, when the shape is too large for the rows, the rest is unused then
+    int lo[3];                ///< the lower corner of the bounding box
+    int size[3];              ///< the size of the bounding box
+    int hot[3];               ///< the hotspot
+
+    /**
+     * the rows along each axis, bit 0 is the voxel at the lower end of the bounding box.
+     * The rows along x are indexed by (z - lo z) * size y + (y - lo y), the rows along y by
+     * (z - lo z) * size x + (x - lo x) and the rows along z by (y - lo y) * size x + (x - lo x)
+     */
+    uint64_t *rows[3];
+  } shapeRows;
+
+  /** the rows for each shape and orientation, 0 when not yet calculated */
+  std::atomic<const shapeRows *> *shapeRowCache;
+
+  /** get the rows, calculating them, when necessary, this can be called by several threads */
+  const shapeRows *getRows(unsigned int s, unsigned char t);
+
+  unsigned int *moCalcValues(unsigned int s1,
+                             unsigned char t1,
+                             unsigned int s2,
+                             unsigned char t2,
                              int dx,
                              int dy,
                              int dz);
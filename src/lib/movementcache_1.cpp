@@ -67,12 +67,17 @@ movementCache_1_c::movementCache_1_c(const Problem *puz)
 }
 
 /* calculate the required movement possibilities */
-unsigned int *movementCache_1_c::moCalcValues(const Voxel *sh1,
-                                              const Voxel *sh2,
+unsigned int *movementCache_1_c::moCalcValues(unsigned int s1,
+                                              unsigned char t1,
+                                              unsigned int s2,
+                                              unsigned char t2,
                                               int dx,
                                               int dy,
                                               int dz) {
 
+  const Voxel *sh1 = getTransformedShape(s1, t1);
+  const Voxel *sh2 = getTransformedShape(s2, t2);
+
   /* because the dx, dy and dz values are calculated using the hotspot we need to reverse
    * that process
    */
@@ -32,8 +32,10 @@ class movementCache_1_c : public movementCache_c {
 
  private:
 
-  unsigned int *moCalcValues(const Voxel *sh1,
-                             const Voxel *sh2,
+  unsigned int *moCalcValues(unsigned int s1,
+                             unsigned char t1,
+                             unsigned int s2,
+                             unsigned char t2,
                              int dx,
                              int dy,
                              int dz);
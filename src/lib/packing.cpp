@@ -0,0 +1,342 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "packing.h"
+
+#include "assembly.h"
+#include "disassembly.h"
+#include "grid-type.h"
+#include "symmetries.h"
+
+void PackWriter::putUnsigned(uint64_t v) {
+  while (v >= 0x80) {
+    buf.push_back((v & 0x7F) | 0x80);
+    v >>= 7;
+  }
+  buf.push_back(v);
+}
+
+void PackWriter::putSigned(int64_t v) {
+  putUnsigned(((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+void PackWriter::putAssembly(const Assembly *a) {
+
+  putUnsigned(a->placementCount());
+
+  for (unsigned int i = 0; i < a->placementCount(); i++)
+    if (a->isPlaced(i)) {
+      putByte(a->getTransformation(i));
+      putSigned(a->getX(i));
+      putSigned(a->getY(i));
+      putSigned(a->getZ(i));
+    } else
+      putByte(UNPLACED_TRANS);
+}
+
+void PackWriter::putSeparation(const Separation *s) {
+
+  unsigned int pn = s->getPieceNumber();
+
+  putUnsigned(pn);
+  for (unsigned int i = 0; i < pn; i++)
+    putSigned((int64_t)s->getPieceName(i) - (i ? s->getPieceName(i - 1) : 0));
+
+  putUnsigned(s->getMoves() + 1);
+
+  const State *st = s->getState(0);
+
+  for (unsigned int i = 0; i < pn; i++) {
+    putSigned(st->getX(i));
+    putSigned(st->getY(i));
+    putSigned(st->getZ(i));
+  }
+
+  std::vector<int> dx(pn), dy(pn), dz(pn);
+  std::vector<bool> done(pn);
+
+  for (unsigned int m = 1; m <= s->getMoves(); m++) {
+
+    const State *prev = st;
+    st = s->getState(m);
+
+    unsigned int shifts = 0;
+
+    for (unsigned int i = 0; i < pn; i++) {
+      dx[i] = st->getX(i) - prev->getX(i);
+      dy[i] = st->getY(i) - prev->getY(i);
+      dz[i] = st->getZ(i) - prev->getZ(i);
+      done[i] = !dx[i] && !dy[i] && !dz[i];
+    }
+
+    // count the different shifts, normally there is only one
+    for (unsigned int i = 0; i < pn; i++)
+      if (!done[i]) {
+        shifts++;
+        for (unsigned int j = i + 1; j < pn; j++)
+          if (dx[j] == dx[i] && dy[j] == dy[i] && dz[j] == dz[i])
+            done[j] = true;
+      }
+
+    putUnsigned(shifts);
+
+    for (unsigned int i = 0; i < pn; i++)
+      done[i] = !dx[i] && !dy[i] && !dz[i];
+
+    for (unsigned int i = 0; i < pn; i++)
+      if (!done[i]) {
+
+        putSigned(dx[i]);
+        putSigned(dy[i]);
+        putSigned(dz[i]);
+
+        // the bitmap of the pieces with this shift, pieces in front of i can not
+        // have it, otherwise i would have been handled with them
+        for (unsigned int j = 0; j < pn; j += 8) {
+          unsigned int bits = 0;
+          for (unsigned int k = j; k < pn && k < j + 8; k++)
+            if (dx[k] == dx[i] && dy[k] == dy[i] && dz[k] == dz[i]) {
+              bits |= 1 << (k - j);
+              done[k] = true;
+            }
+          putByte(bits);
+        }
+      }
+  }
+
+  putByte((s->getRemoved() ? 1 : 0) | (s->getLeft() ? 2 : 0));
+
+  if (s->getRemoved()) putSeparation(s->getRemoved());
+  if (s->getLeft()) putSeparation(s->getLeft());
+}
+
+void PackWriter::putSeparationInfo(const SeparationInfo *s) {
+
+  putUnsigned(s->values.size());
+
+  for (unsigned int i = 0; i < s->values.size(); i++)
+    putUnsigned(s->values[i]);
+}
+
+unsigned int PackReader::getByte(void) {
+
+  if (pos >= size)
+    throw packException_c("packed data ends too early");
+
+  return data[pos++];
+}
+
+void PackReader::skip(uint64_t n) {
+
+  if (n > size - pos)
+    throw packException_c("packed data ends too early");
+
+  pos += n;
+}
+
+uint64_t PackReader::getUnsigned(void) {
+
+  uint64_t v = 0;
+
+  for (unsigned int shift = 0; ; shift += 7) {
+
+    if (shift >= 64)
+      throw packException_c("packed number too long");
+
+    unsigned int b = getByte();
+    v |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80))
+      return v;
+  }
+}
+
+int64_t PackReader::getSigned(void) {
+  uint64_t v = getUnsigned();
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+Assembly *PackReader::getAssembly(const GridType *gt) {
+
+  uint64_t placements = getUnsigned();
+
+  // each placement takes at least one byte
+  if (placements > size - pos)
+    throw packException_c("packed assembly ends too early");
+
+  unsigned int transformations = gt->getSymmetries()->getNumTransformations();
+
+  Assembly *a = new Assembly(gt);
+
+  try {
+
+    for (unsigned int i = 0; i < placements; i++) {
+      unsigned char trans = getByte();
+      if (trans == UNPLACED_TRANS)
+        a->addNonPlacement();
+      else if (trans < transformations) {
+        int x = getSigned();
+        int y = getSigned();
+        int z = getSigned();
+        a->addPlacement(trans, x, y, z);
+      } else
+        throw packException_c("packed assembly has an invalid transformation");
+    }
+  }
+
+  catch (...) {
+    delete a;
+    throw;
+  }
+
+  return a;
+}
+
+Separation *PackReader::getSeparation(void) {
+
+  uint64_t pn = getUnsigned();
+
+  // the first state takes at least 3 bytes per piece
+  if (pn == 0 || pn > (size - pos) / 3)
+    throw packException_c("packed separation has an invalid number of pieces");
+
+  std::vector<unsigned int> pieces(pn);
+  for (unsigned int i = 0; i < pn; i++)
+    pieces[i] = getSigned() + (i ? pieces[i - 1] : 0);
+
+  // each state after the first one takes at least one byte
+  uint64_t cnt = getUnsigned();
+  if (cnt == 0 || cnt - 1 > size - pos)
+    throw packException_c("packed separation has an invalid number of states");
+
+  std::vector<State *> states;
+  Separation *removed = 0;
+  Separation *left = 0;
+
+  try {
+
+    states.push_back(new State(pn));
+    for (unsigned int i = 0; i < pn; i++) {
+      int x = getSigned();
+      int y = getSigned();
+      int z = getSigned();
+      states[0]->set(i, x, y, z);
+    }
+
+    for (unsigned int m = 1; m < cnt; m++) {
+
+      states.push_back(new State(states[m - 1], pn));
+
+      uint64_t shifts = getUnsigned();
+      if (shifts > pn)
+        throw packException_c("packed separation has too many shifts");
+
+      for (unsigned int s = 0; s < shifts; s++) {
+
+        int dx = getSigned();
+        int dy = getSigned();
+        int dz = getSigned();
+
+        unsigned int bits = 0;
+
+        for (unsigned int i = 0; i < pn; i++) {
+
+          if ((i & 7) == 0)
+            bits = getByte();
+
+          if (bits & (1 << (i & 7)))
+            states[m]->set(i,
+                           states[m - 1]->getX(i) + dx,
+                           states[m - 1]->getY(i) + dy,
+                           states[m - 1]->getZ(i) + dz);
+        }
+      }
+    }
+
+    unsigned int flags = getByte();
+
+    if (flags & ~3u)
+      throw packException_c("packed separation has invalid flags");
+
+    if (flags) {
+
+      /* the sub separations contain the pieces that are removed and the ones
+       * that are left at the end, like when loading from XML there must be both
+       */
+      unsigned int removedPc = 0;
+      for (unsigned int i = 0; i < pn; i++)
+        if (states[cnt - 1]->pieceRemoved(i))
+          removedPc++;
+
+      if (removedPc == 0 || removedPc == pn)
+        throw packException_c("packed separation has pieces in only one part of the tree");
+
+      if (flags & 1) {
+        removed = getSeparation();
+        if (removed->getPieceNumber() != removedPc)
+          throw packException_c("packed separation has the wrong number of removed pieces");
+      }
+
+      if (flags & 2) {
+        left = getSeparation();
+        if (left->getPieceNumber() != pn - removedPc)
+          throw packException_c("packed separation has the wrong number of left pieces");
+      }
+    }
+  }
+
+  catch (...) {
+    for (unsigned int i = 0; i < states.size(); i++)
+      delete states[i];
+    delete removed;
+    delete left;
+    throw;
+  }
+
+  Separation *s = new Separation(removed, left, pieces);
+
+  // addstate adds at the front
+  for (unsigned int m = cnt; m > 0; m--)
+    s->addstate(states[m - 1]);
+
+  return s;
+}
+
+SeparationInfo *PackReader::getSeparationInfo(void) {
+
+  // each value takes at least one byte
+  uint64_t cnt = getUnsigned();
+  if (cnt > size - pos)
+    throw packException_c("packed separation information ends too early");
+
+  SeparationInfo *s = new SeparationInfo();
+
+  try {
+    s->values.resize(cnt);
+    for (unsigned int i = 0; i < cnt; i++)
+      s->values[i] = getUnsigned();
+  }
+
+  catch (...) {
+    delete s;
+    throw;
+  }
+
+  return s;
+}
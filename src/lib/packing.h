@@ -0,0 +1,135 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#ifndef __PACKING_H__
+#define __PACKING_H__
+
+/** \file packing.h
+ * a compact binary form for assemblies and disassemblies
+ */
+
+#include <vector>
+#include <cstddef>
+#include <exception>
+#include <inttypes.h>
+
+class Assembly;
+class Separation;
+class SeparationInfo;
+class GridType;
+
+/** this gets thrown by the PackReader when the packed data is damaged */
+class packException_c : public std::exception {
+
+ public:
+
+  const char *comment;
+
+  packException_c(const char *c) : comment(c) {}
+
+  const char *what(void) const throw() { return comment; }
+};
+
+/**
+ * Packs assemblies and disassemblies into a compact byte sequence.
+ *
+ * All numbers are variable length, 7 bits per byte with the high bit set when
+ * more bytes follow, signed numbers are zigzag coded before that, so small numbers of
+ * either sign need only one byte.
+ *
+ * An assembly is the number of placements followed by the placements. Each placement
+ * is the transformation byte, and for placed pieces the signed position. The
+ * positions are relative to the result shape, so they are small.
+ *
+ * A separation is the number of pieces, the piece numbers as differences to the previous
+ * one, the number of states, the first state with all positions and then each following
+ * state as difference to the state before it. As a move shifts some pieces all by the same
+ * amount a state difference is the number of different shifts followed by each shift
+ * and a bitmap of the pieces that make it. Then follows a byte telling which sub
+ * separations follow and those.
+ *
+ * A separationInfo is the number of values followed by the values.
+ */
+class PackWriter {
+
+  std::vector<unsigned char> &buf;
+
+ public:
+
+  /** the packed data is appended to b */
+  PackWriter(std::vector<unsigned char> &b) : buf(b) {}
+
+  void putByte(unsigned int v) { buf.push_back(v); }
+  void putUnsigned(uint64_t v);
+  void putSigned(int64_t v);
+
+  void putAssembly(const Assembly *a);
+  void putSeparation(const Separation *s);
+  void putSeparationInfo(const SeparationInfo *s);
+
+ private:
+
+  // no copying and assigning
+  PackWriter(const PackWriter &);
+  void operator=(const PackWriter &);
+};
+
+/**
+ * Unpacks what the PackWriter created. The data is not copied, so it must stay
+ * while the reader is used. Reading more than there is or data that doesn't make sense
+ * throws a packException_c, so damaged files can be detected, the data is not
+ * trusted even in release builds.
+ *
+ * The get functions that return objects create them with new, the caller owns them.
+ */
+class PackReader {
+
+  const unsigned char *data;
+  size_t size;
+  size_t pos;
+
+ public:
+
+  PackReader(const unsigned char *d, size_t s) : data(d), size(s), pos(0) {}
+
+  unsigned int getByte(void);
+  uint64_t getUnsigned(void);
+  int64_t getSigned(void);
+
+  Assembly *getAssembly(const GridType *gt);
+  Separation *getSeparation(void);
+  SeparationInfo *getSeparationInfo(void);
+
+  /** skip over n bytes */
+  void skip(uint64_t n);
+
+  /** the number of bytes read so far */
+  size_t getPos(void) const { return pos; }
+
+  bool atEnd(void) const { return pos == size; }
+
+ private:
+
+  // no copying and assigning
+  PackReader(const PackReader &);
+  void operator=(const PackReader &);
+};
+
+#endif
@@ -0,0 +1,250 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "packing.h"
+#include "assembly.h"
+#include "disassembly.h"
+#include "grid-type.h"
+#include <boost/test/unit_test.hpp>
+
+/* a separation of 3 pieces: piece 5 is removed first, then piece 9 is removed from 7 */
+static Separation *createSeparation(void) {
+
+  std::vector<unsigned int> leftPieces;
+  leftPieces.push_back(7);
+  leftPieces.push_back(9);
+
+  Separation *left = new Separation(0, 0, leftPieces);
+
+  State *s = new State(2);
+  s->set(0, 0, 0, 0);
+  s->set(1, 30000, 0, 0);
+  left->addstate(s);
+
+  s = new State(2);
+  s->set(0, 0, 0, 0);
+  s->set(1, 0, 0, 0);
+  left->addstate(s);
+
+  std::vector<unsigned int> pieces;
+  pieces.push_back(5);
+  pieces.push_back(7);
+  pieces.push_back(9);
+
+  Separation *sep = new Separation(0, left, pieces);
+
+  // addstate adds at the front, so the last state comes first
+  s = new State(3);
+  s->set(0, 0, 0, 30000);
+  s->set(1, 0, 0, 0);
+  s->set(2, 0, 0, 0);
+  sep->addstate(s);
+
+  s = new State(3);
+  s->set(0, 0, -2, 1);
+  s->set(1, 0, 0, 0);
+  s->set(2, 0, 0, 0);
+  sep->addstate(s);
+
+  s = new State(3);
+  s->set(0, 0, 0, 1);
+  s->set(1, 0, 0, 0);
+  s->set(2, 0, 0, 0);
+  sep->addstate(s);
+
+  s = new State(3);
+  s->set(0, 0, 0, 0);
+  s->set(1, 0, 0, 0);
+  s->set(2, 0, 0, 0);
+  sep->addstate(s);
+
+  return sep;
+}
+
+static void checkSameSeparation(const Separation *a, const Separation *b) {
+
+  BOOST_REQUIRE( a->getPieceNumber() == b->getPieceNumber());
+  BOOST_REQUIRE( a->getMoves() == b->getMoves());
+
+  for (unsigned int i = 0; i < a->getPieceNumber(); i++)
+    BOOST_CHECK( a->getPieceName(i) == b->getPieceName(i));
+
+  for (unsigned int m = 0; m <= a->getMoves(); m++)
+    for (unsigned int i = 0; i < a->getPieceNumber(); i++) {
+      BOOST_CHECK( a->getState(m)->getX(i) == b->getState(m)->getX(i));
+      BOOST_CHECK( a->getState(m)->getY(i) == b->getState(m)->getY(i));
+      BOOST_CHECK( a->getState(m)->getZ(i) == b->getState(m)->getZ(i));
+    }
+
+  BOOST_REQUIRE( !a->getRemoved() == !b->getRemoved());
+  BOOST_REQUIRE( !a->getLeft() == !b->getLeft());
+
+  if (a->getRemoved()) checkSameSeparation(a->getRemoved(), b->getRemoved());
+  if (a->getLeft()) checkSameSeparation(a->getLeft(), b->getLeft());
+}
+
+BOOST_AUTO_TEST_CASE( packing_number_test )
+{
+  const uint64_t values[] = { 0, 1, 127, 128, 300, 16383, 16384, 0xFFFFFFFFull, 0xFFFFFFFFFFFFFFFFull };
+  const unsigned int lengths[] = { 1, 1, 1, 2, 2, 2, 3, 5, 10 };
+  const unsigned int count = sizeof(values) / sizeof(values[0]);
+
+  for (unsigned int i = 0; i < count; i++) {
+
+    std::vector<unsigned char> buf;
+    PackWriter w(buf);
+    w.putUnsigned(values[i]);
+
+    BOOST_CHECK( buf.size() == lengths[i]);
+
+    PackReader r(&buf[0], buf.size());
+    BOOST_CHECK( r.getUnsigned() == values[i]);
+    BOOST_CHECK( r.atEnd());
+
+    // without the last byte the number is incomplete
+    PackReader t(&buf[0], buf.size() - 1);
+    BOOST_CHECK_THROW( t.getUnsigned(), packException_c);
+  }
+
+  const int64_t signedValues[] = { 0, 1, -1, 63, -64, 64, -65, 2147483647, -2147483647 - 1 };
+  const unsigned int signedCount = sizeof(signedValues) / sizeof(signedValues[0]);
+
+  std::vector<unsigned char> buf;
+  PackWriter w(buf);
+
+  for (unsigned int i = 0; i < signedCount; i++)
+    w.putSigned(signedValues[i]);
+
+  PackReader r(&buf[0], buf.size());
+
+  for (unsigned int i = 0; i < signedCount; i++)
+    BOOST_CHECK( r.getSigned() == signedValues[i]);
+
+  BOOST_CHECK( r.atEnd());
+  BOOST_CHECK_THROW( r.getByte(), packException_c);
+  BOOST_CHECK_THROW( r.skip(1), packException_c);
+
+  // a number can not be longer than 64 bits
+  std::vector<unsigned char> tooLong(11, 0xFF);
+  tooLong.push_back(0);
+
+  PackReader l(&tooLong[0], tooLong.size());
+  BOOST_CHECK_THROW( l.getUnsigned(), packException_c);
+}
+
+BOOST_AUTO_TEST_CASE( packing_assembly_test )
+{
+  GridType gt;
+
+  Assembly a(&gt);
+  a.addPlacement(0, 0, 0, 0);
+  a.addNonPlacement();
+  a.addPlacement(23, -3, 200, 70000);
+  a.addPlacement(5, -1, 0, 1);
+
+  std::vector<unsigned char> buf;
+  PackWriter w(buf);
+  w.putAssembly(&a);
+
+  PackReader r(&buf[0], buf.size());
+  Assembly *b = r.getAssembly(&gt);
+
+  BOOST_CHECK( r.atEnd());
+  BOOST_REQUIRE( b->placementCount() == a.placementCount());
+
+  for (unsigned int i = 0; i < a.placementCount(); i++) {
+    BOOST_REQUIRE( b->isPlaced(i) == a.isPlaced(i));
+    if (a.isPlaced(i)) {
+      BOOST_CHECK( b->getTransformation(i) == a.getTransformation(i));
+      BOOST_CHECK( b->getX(i) == a.getX(i));
+      BOOST_CHECK( b->getY(i) == a.getY(i));
+      BOOST_CHECK( b->getZ(i) == a.getZ(i));
+    }
+  }
+
+  delete b;
+
+  // every shorter piece of the data is rejected
+  for (unsigned int l = 0; l < buf.size(); l++) {
+    PackReader t(l ? &buf[0] : 0, l);
+    BOOST_CHECK_THROW( t.getAssembly(&gt), packException_c);
+  }
+
+  // as is a transformation that doesn't exist
+  buf[1] = 200;
+  PackReader t(&buf[0], buf.size());
+  BOOST_CHECK_THROW( t.getAssembly(&gt), packException_c);
+}
+
+BOOST_AUTO_TEST_CASE( packing_separation_test )
+{
+  Separation *sep = createSeparation();
+
+  std::vector<unsigned char> buf;
+  PackWriter w(buf);
+  w.putSeparation(sep);
+
+  PackReader r(&buf[0], buf.size());
+  Separation *res = r.getSeparation();
+
+  BOOST_CHECK( r.atEnd());
+  checkSameSeparation(sep, res);
+
+  delete res;
+
+  // every shorter piece of the data is rejected
+  for (unsigned int l = 0; l < buf.size(); l++) {
+    PackReader t(l ? &buf[0] : 0, l);
+    BOOST_CHECK_THROW( t.getSeparation(), packException_c);
+  }
+
+  delete sep;
+
+  // the sub separation needs to have the pieces that are left
+  std::vector<unsigned int> leftPieces;
+  leftPieces.push_back(7);
+
+  Separation *left = new Separation(0, 0, leftPieces);
+
+  State *s = new State(1);
+  s->set(0, 0, 0, 0);
+  left->addstate(s);
+
+  std::vector<unsigned int> pieces;
+  pieces.push_back(5);
+  pieces.push_back(7);
+  pieces.push_back(9);
+
+  sep = new Separation(0, left, pieces);
+
+  s = new State(3);
+  s->set(0, 30000, 0, 0);
+  s->set(1, 0, 0, 0);
+  s->set(2, 0, 0, 0);
+  sep->addstate(s);
+
+  buf.clear();
+  w.putSeparation(sep);
+
+  PackReader t(&buf[0], buf.size());
+  BOOST_CHECK_THROW( t.getSeparation(), packException_c);
+
+  delete sep;
+}
@@ -0,0 +1,208 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "placement-masks.h"
+
+#include "bt_assert.h"
+#include "problem.h"
+#include "voxel.h"
+
+/* one voxel of a piece orientation that needs to be checked: the position
+ * inside the piece and the plane of the result it must be on
+ */
+typedef struct {
+  unsigned int x, y, z;
+  unsigned int plane;
+} pieceVoxel;
+
+PlacementMasks::PlacementMasks(const Problem *puz) : puzzle(puz) {
+
+  const Voxel *result = puzzle->getResultShape();
+
+  sx = result->getX();
+  sy = result->getY();
+  sz = result->getZ();
+  words = (sx + 63) / 64;
+
+  /* find the colours used by the pieces, only those that are not allowed
+   * on all voxels of the result need planes
+   */
+  unsigned int colours = 0;
+
+  for (unsigned int pc = 0; pc < puzzle->partNumber(); pc++) {
+    const Voxel *v = puzzle->getShapeShape(pc);
+    for (unsigned int i = 0; i < v->getXYZ(); i++)
+      if (v->getColor(i) >= colours)
+        colours = v->getColor(i) + 1;
+  }
+
+  colourPlanes.resize(colours, 0);
+
+  std::vector<bool> used(colours, false);
+
+  for (unsigned int pc = 0; pc < puzzle->partNumber(); pc++) {
+    const Voxel *v = puzzle->getShapeShape(pc);
+    for (unsigned int i = 0; i < v->getXYZ(); i++)
+      used[v->getColor(i)] = true;
+  }
+
+  unsigned int planeCount = 1;
+
+  for (unsigned int c = 1; c < colours; c++)
+    if (used[c])
+      for (unsigned int i = 0; i < result->getXYZ(); i++)
+        if (!puzzle->placementAllowed(c, result->getColor(i))) {
+          colourPlanes[c] = planeCount;
+          planeCount += 2;
+          break;
+        }
+
+  planes.resize(planeCount * sy * sz * words, 0);
+
+  for (unsigned int z = 0; z < sz; z++)
+    for (unsigned int y = 0; y < sy; y++)
+      for (unsigned int x = 0; x < sx; x++) {
+
+        bool notEmpty = result->getState(x, y, z) != Voxel::VX_EMPTY;
+        uint64_t bit = 1ull << (x & 63);
+        unsigned int w = x >> 6;
+
+        if (notEmpty)
+          planes[(z * sy + y) * words + w] |= bit;
+
+        for (unsigned int c = 1; c < colours; c++)
+          if (colourPlanes[c] && puzzle->placementAllowed(c, result->getColor(x, y, z))) {
+            planes[((colourPlanes[c] * sz + z) * sy + y) * words + w] |= bit;
+            if (notEmpty)
+              planes[(((colourPlanes[c] + 1) * sz + z) * sy + y) * words + w] |= bit;
+          }
+      }
+}
+
+void PlacementMasks::findPlacements(const Voxel *piece, std::vector<int> *positions) const {
+
+  const Voxel *result = puzzle->getResultShape();
+
+  int x1 = (int) result->boundX1() - (int) piece->boundX1();
+  int x2 = (int) result->boundX2() - (int) piece->boundX2();
+  int y1 = (int) result->boundY1() - (int) piece->boundY1();
+  int y2 = (int) result->boundY2() - (int) piece->boundY2();
+  int z1 = (int) result->boundZ1() - (int) piece->boundZ1();
+  int z2 = (int) result->boundZ2() - (int) piece->boundZ2();
+
+  if (x1 > x2 || y1 > y2 || z1 > z2)
+    return;
+
+  /* collect the voxels of the piece that need to be checked: filled voxels must
+   * not be on empty voxels of the result and all voxels with a colour must
+   * be on voxels where the colour is allowed
+   */
+  std::vector<pieceVoxel> vox;
+
+  for (unsigned int pz = piece->boundZ1(); pz <= piece->boundZ2(); pz++)
+    for (unsigned int py = piece->boundY1(); py <= piece->boundY2(); py++)
+      for (unsigned int px = piece->boundX1(); px <= piece->boundX2(); px++) {
+
+        bool filled = piece->getState(px, py, pz) == Voxel::VX_FILLED;
+        unsigned int c = piece->getColor(px, py, pz);
+
+        bt_assert(c == 0 || c < colourPlanes.size());
+
+        pieceVoxel v;
+        v.x = px - piece->boundX1();
+        v.y = py;
+        v.z = pz;
+
+        if (c && colourPlanes[c])
+          v.plane = colourPlanes[c] + (filled ? 1 : 0);
+        else if (filled)
+          v.plane = 0;
+        else
+          continue;
+
+        vox.push_back(v);
+      }
+
+  /* the possible start positions of the bounding box of the piece along the
+   * x-axis, these are the bits we start with
+   */
+  std::vector<uint64_t> start(words, 0);
+  for (unsigned int s = result->boundX1(); s <= result->boundX2() + piece->boundX1() - piece->boundX2(); s++)
+    start[s >> 6] |= 1ull << (s & 63);
+
+  /* now calculate the positions along x for each y and z position of the piece */
+  unsigned int ny = y2 - y1 + 1;
+  unsigned int nz = z2 - z1 + 1;
+  std::vector<uint64_t> valid(ny * nz * words);
+
+  for (unsigned int zi = 0; zi < nz; zi++)
+    for (unsigned int yi = 0; yi < ny; yi++) {
+
+      uint64_t *v = &valid[(zi * ny + yi) * words];
+
+      for (unsigned int w = 0; w < words; w++)
+        v[w] = start[w];
+
+      for (unsigned int i = 0; i < vox.size(); i++) {
+
+        const uint64_t *r = row(vox[i].plane, y1 + yi + vox[i].y, z1 + zi + vox[i].z);
+
+        /* the bit for position s must be and-ed with the bit of the voxel
+         * at s + x, so shift the row right by x
+         */
+        unsigned int ws = vox[i].x >> 6;
+        unsigned int bs = vox[i].x & 63;
+        uint64_t any = 0;
+
+        for (unsigned int w = 0; w < words; w++) {
+
+          uint64_t s = 0;
+
+          if (w + ws < words) {
+            s = r[w + ws] >> bs;
+            if (bs && (w + ws + 1 < words))
+              s |= r[w + ws + 1] << (64 - bs);
+          }
+
+          v[w] &= s;
+          any |= v[w];
+        }
+
+        if (!any)
+          break;
+      }
+    }
+
+  /* finally output the positions in the order of the loops x, y, z */
+  for (int x = x1; x <= x2; x++) {
+
+    unsigned int s = x + piece->boundX1();
+    unsigned int w = s >> 6;
+    uint64_t bit = 1ull << (s & 63);
+
+    for (int y = y1; y <= y2; y++)
+      for (int z = z1; z <= z2; z++)
+        if ((valid[((z - z1) * ny + (y - y1)) * words + w] & bit) && piece->onGrid(x, y, z)) {
+          positions->push_back(x);
+          positions->push_back(y);
+          positions->push_back(z);
+        }
+  }
+}
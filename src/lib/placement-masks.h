@@ -0,0 +1,97 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#ifndef __PLACEMENT_MASKS_H__
+#define __PLACEMENT_MASKS_H__
+
+/** \file placement-masks.h
+ * contains a class that finds all the positions where a piece fits into the result
+ */
+
+#include <vector>
+#include <inttypes.h>
+
+class Problem;
+class Voxel;
+
+/**
+ * Finds the positions of piece orientations inside the result of a problem.
+ *
+ * The result is stored as bit planes: for each line of voxels along the x-axis
+ * a row of bits, one per voxel. There is one plane containing the voxels
+ * that a filled piece voxel may occupy (FILLED and VARIABLE voxels) and, when
+ * the problem has colour constraints, one plane for each colour of the pieces
+ * containing the voxels the colour is allowed on.
+ *
+ * For an orientation of a piece the bits of all x positions along a line are then
+ * calculated at once: the rows of the planes the piece voxels need are shifted by
+ * the x offset of the voxel inside the piece and and-ed together. Only the bits
+ * that stay set are positions where the piece fits. This is the same as checking
+ * each voxel of the piece at each position on its own, but works on 64 positions
+ * at a time.
+ *
+ * The planes are created in the constructor, afterwards the class is not changed
+ * anymore, so several threads can use it at the same time.
+ */
+class PlacementMasks {
+
+  const Problem *puzzle;
+
+  /* size of the result and number of 64 bit words of one row of a plane */
+  unsigned int sx, sy, sz;
+  unsigned int words;
+
+  /* the planes one after the other, each plane contains sy*sz rows of words words.
+   * Plane 0 contains the voxels that are not empty. The planes for colours come after
+   * that, first a plane for empty piece voxels of the colour, then one for filled
+   * piece voxels of the colour
+   */
+  std::vector<uint64_t> planes;
+
+  /* the index of the first of the 2 planes for each colour, 0 when the colour has
+   * no planes because it can go everywhere
+   */
+  std::vector<unsigned int> colourPlanes;
+
+  /* the words of the given row of the given plane */
+  const uint64_t *row(unsigned int plane, unsigned int y, unsigned int z) const {
+    return &planes[((plane * sz + z) * sy + y) * words];
+  }
+
+ public:
+
+  PlacementMasks(const Problem *puz);
+
+  /**
+   * find all positions where the orientation piece can be placed into the result.
+   * The positions are appended to positions as x, y, z triples in the order x, y, z
+   * with z changing fastest. The positions are the position of the origin of the piece
+   * voxel, not the hotspot. Positions that are not on the grid of the voxel are left out
+   */
+  void findPlacements(const Voxel *piece, std::vector<int> *positions) const;
+
+ private:
+
+  // no copying and assigning
+  PlacementMasks(const PlacementMasks &);
+  void operator=(const PlacementMasks &);
+};
+
+#endif
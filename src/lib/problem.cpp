@@ -25,8 +25,11 @@
 #include "disassembly.h"
 #include "puzzle.h"
 #include "solution.h"
+#include "solution-spill.h"
+#include "packing.h"
 
 #include "../tools/xml.h"
+#include "../tools/mappedfile.h"
 
 #include <algorithm>
 
@@ -75,16 +78,20 @@ class Part {
 Problem::Problem(Puzzle &puz) :
     puzzle(puz), result(0xFFFFFFFF),
     assm(0), solveState(SS_UNSOLVED), numAssemblies(0),
-    numSolutions(0), usedTime(0), maxHoles(0xFFFFFFFF) {}
+    numSolutions(0), usedTime(0), maxHoles(0xFFFFFFFF), spill(0) {}
 
 Problem::~Problem() {
   if (assm)
     delete assm;
+
+  // the solutions unregister from the spill, so they must go first
+  solutions_.clear();
+  delete spill;
 }
 
 Problem::Problem(const Problem *orig, Puzzle &puz) :
     puzzle(puz), result(orig->result),
-    solveState(SS_UNSOLVED), numAssemblies(0), numSolutions(0), usedTime(0) {
+    solveState(SS_UNSOLVED), numAssemblies(0), numSolutions(0), usedTime(0), spill(0) {
   assm = 0;
 
   for (std::set<uint32_t>::iterator i = orig->colorConstraints.begin();
@@ -104,7 +111,7 @@ Problem::Problem(const Problem *orig, Puzzle &puz) :
   // likely give a new name any way
 }
 
-void Problem::save(XmlWriter &xml) const {
+void Problem::save(XmlWriter &xml, bool withSolutions) const {
   xml.newTag("problem");
 
   if (name.length() > 0)
@@ -184,7 +191,7 @@ void Problem::save(XmlWriter &xml) const {
     }
   }
 
-  if (solutions_.size()) {
+  if (withSolutions && solutions_.size()) {
     xml.newTag("solutions");
     for (unsigned int i = 0; i < solutions_.size(); i++)
       solutions_[i]->save(xml);
@@ -195,7 +202,7 @@ void Problem::save(XmlWriter &xml) const {
 }
 
 Problem::Problem(Puzzle &puz, XmlParser &pars)
-    : puzzle(puz), result(0xFFFFFFFF), assm(0) {
+    : puzzle(puz), result(0xFFFFFFFF), assm(0), spill(0) {
   pars.require(XmlParser::START_TAG, "problem");
 
   name = pars.getAttributeValue("name");
@@ -768,6 +775,9 @@ void Problem::addSolution(Assembly *assm) {
   bt_assert(solveState == SS_SOLVING);
 
   solutions_.push_back(std::make_unique<Solution>(assm, numAssemblies));
+
+  if (spill)
+    spill->add(solutions_.back().get());
 }
 
 void Problem::addSolution(Assembly *assm,
@@ -777,15 +787,15 @@ void Problem::addSolution(Assembly *assm,
   bt_assert(solveState == SS_SOLVING);
 
   // if the given index is behind the number of solutions add at the end
-  if (pos < solutions_.size())
-    solutions_.insert(solutions_.begin() + pos,
-                      std::make_unique<Solution>(assm, numAssemblies, disasm,
-                                                 numSolutions));
-  else
-    solutions_.push_back(std::make_unique<Solution>(assm,
-                                                    numAssemblies,
-                                                    disasm,
-                                                    numSolutions));
+  if (pos >= solutions_.size())
+    pos = solutions_.size();
+
+  solutions_.insert(solutions_.begin() + pos,
+                    std::make_unique<Solution>(assm, numAssemblies, disasm,
+                                               numSolutions));
+
+  if (spill)
+    spill->add(solutions_[pos].get());
 }
 
 void Problem::addSolution(Assembly *assm,
@@ -795,15 +805,15 @@ void Problem::addSolution(Assembly *assm,
   bt_assert(solveState == SS_SOLVING);
 
   // if the given index is behind the number of solutions add at the end
-  if (pos < solutions_.size())
-    solutions_.insert(solutions_.begin() + pos,
-                      std::make_unique<Solution>(assm, numAssemblies, disasm,
-                                                 numSolutions));
-  else
-    solutions_.push_back(std::make_unique<Solution>(assm,
-                                                    numAssemblies,
-                                                    disasm,
-                                                    numSolutions));
+  if (pos >= solutions_.size())
+    pos = solutions_.size();
+
+  solutions_.insert(solutions_.begin() + pos,
+                    std::make_unique<Solution>(assm, numAssemblies, disasm,
+                                               numSolutions));
+
+  if (spill)
+    spill->add(solutions_[pos].get());
 }
 
 void Problem::removeAllSolutions() {
@@ -822,6 +832,120 @@ void Problem::removeSolution(unsigned int sol) {
   solutions_.erase(solutions_.begin() + sol);
 }
 
+void Problem::mergeSolutions(Problem &other) {
+  bt_assert(solveState == SS_SOLVED);
+  bt_assert(other.solveState == SS_SOLVED);
+
+  // solutions that are in a spill can not move to another problem
+  bt_assert(!other.spill);
+
+  for (unsigned int i = 0; i < other.solutions_.size(); i++) {
+    other.solutions_[i]->addToNumbers(numAssemblies, numSolutions);
+    solutions_.push_back(std::move(other.solutions_[i]));
+
+    if (spill)
+      spill->add(solutions_.back().get());
+  }
+  other.solutions_.clear();
+
+  numAssemblies += other.numAssemblies;
+  numSolutions += other.numSolutions;
+  usedTime += other.usedTime;
+}
+
+bool Problem::setSolutionSpill(const char *fname, unsigned int window) {
+  bt_assert(!spill);
+
+  SolutionSpill *s = new SolutionSpill(puzzle.getGridType(), window);
+
+  if (fname && !s->setFile(fname)) {
+    delete s;
+    return false;
+  }
+
+  spill = s;
+
+  for (unsigned int i = 0; i < solutions_.size(); i++)
+    spill->add(solutions_[i].get());
+
+  return true;
+}
+
+void Problem::saveBinarySolutions(std::ostream &out) const {
+
+  std::vector<unsigned char> buf;
+  PackWriter w(buf);
+
+  w.putUnsigned(solutions_.size());
+
+  for (unsigned int i = 0; i < solutions_.size(); i++) {
+
+    solutions_[i]->saveBinary(buf);
+
+    // write in pieces, so that there is never more than a bit of the solutions in memory
+    if (buf.size() > 0x10000) {
+      out.write((const char *)&buf[0], buf.size());
+      buf.clear();
+    }
+  }
+
+  if (buf.size())
+    out.write((const char *)&buf[0], buf.size());
+}
+
+bool Problem::loadBinarySolutions(std::shared_ptr<const MappedFile> map, uint64_t pos, uint64_t size, unsigned int window) {
+  bt_assert(!spill);
+  bt_assert(solutions_.empty());
+
+  // the section and all records must be inside of the file, the
+  // content of the records is checked when they are unpacked
+  if (pos > map->getSize() || size > map->getSize() - pos)
+    return false;
+
+  spill = new SolutionSpill(puzzle.getGridType(), window);
+  spill->setMapping(map);
+
+  // only the numbers and the positions of the records are read, the records
+  // are skipped and unpacked when the solution is used
+  PackReader rd(map->getData() + pos, size);
+
+  try {
+
+    // each solution takes at least 3 bytes
+    uint64_t count = rd.getUnsigned();
+    if (count > size / 3)
+      throw packException_c("too many solutions");
+
+    for (uint64_t i = 0; i < count; i++) {
+
+      unsigned int assmNum = rd.getUnsigned();
+      unsigned int solNum = rd.getUnsigned();
+
+      uint64_t recordPos = pos + rd.getPos();
+
+      // skip checks, that the record is inside of the section
+      rd.skip(rd.getUnsigned());
+
+      solutions_.push_back(std::unique_ptr<Solution>(spill->addMapped(assmNum, solNum, recordPos)));
+    }
+
+    if (!rd.atEnd())
+      throw packException_c("data after the solutions");
+  }
+
+  catch (packException_c &) {
+
+    // the solutions unregister from the spill, so they must go first
+    solutions_.clear();
+    delete spill;
+    spill = 0;
+
+    return false;
+  }
+
+  return true;
+}
+
 AssemblerInterface::errState Problem::setAssembler(AssemblerInterface *assm) {
 
   if (assemblerState.length()) {
@@ -949,6 +1073,53 @@ void Problem::sortSolutions(int by) {
   });
 }
 
+/* compare 2 disassemblies by 1=level or 2=sumMoves, like sortSolutions, >0 when d1 is larger */
+static int compareSolutions(const Disassembly *d1, const Disassembly *d2, int by) {
+
+  if (by == 1)
+    return d1->compare(d2);
+
+  if (d1->sumMoves() > d2->sumMoves()) return 1;
+  if (d1->sumMoves() < d2->sumMoves()) return -1;
+  return 0;
+}
+
+bool Problem::solutionsSorted(int by) const {
+
+  bt_assert(by == 1 || by == 2);
+
+  for (unsigned int i = 0; i < solutions_.size(); i++) {
+
+    if (!solutions_[i]->getDisassemblyInfo())
+      return false;
+
+    if (i > 0 && compareSolutions(solutions_[i - 1]->getDisassemblyInfo(), solutions_[i]->getDisassemblyInfo(), by) > 0)
+      return false;
+  }
+
+  return true;
+}
+
+unsigned int Problem::solutionPosition(const Disassembly *d, int by) const {
+
+  bt_assert(by == 1 || by == 2);
+
+  unsigned int lo = 0;
+  unsigned int hi = solutions_.size();
+
+  while (lo < hi) {
+
+    unsigned int mid = lo + (hi - lo) / 2;
+
+    if (compareSolutions(solutions_[mid]->getDisassemblyInfo(), d, by) > 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  return lo;
+}
+
 void Problem::editProblem(void) {
   if (solveState == SS_SOLVING || solveState == SS_SOLVED)
     makeUnknown();
@@ -30,8 +30,10 @@
 #include <stdint.h>
 #include <memory>
 #include <vector>
+#include <deque>
 #include <set>
 #include <string>
+#include <ostream>
 
 class Voxel;
 class Separation;
@@ -42,8 +44,10 @@ class GridType;
 class Puzzle;
 class Part;
 class Solution;
+class SolutionSpill;
 class XmlWriter;
 class XmlParser;
+class MappedFile;
 
 /**
  * this state reflects how far we are with solving this problem
@@ -90,8 +94,11 @@ class Problem {
    * (some of) the found solutions. Not all of even none might be
    * in this vector if the user decides to only count, or not keep them
    * all. This vector contains the solutions that were kept
+   *
+   * it is a deque because when the number of solutions is limited the
+   * smallest, front most solution is removed for every added solution
    */
-  std::vector<std::unique_ptr<Solution>> solutions_;
+  std::deque<std::unique_ptr<Solution>> solutions_;
 
   /**
    * this set contains the pairs of colours that are allowed when a piece
@@ -162,6 +169,12 @@ class Problem {
    */
   unsigned int maxHoles;
 
+  /**
+   * when set the content of the solutions is kept in a file and only
+   * a window of recently used solutions stays in memory, see setSolutionSpill
+   */
+  SolutionSpill *spill;
+
   /** called, when the problem gets changed */
   void editProblem(void);
 
@@ -186,9 +199,10 @@ class Problem {
   ~Problem(void);
 
   /**
-   * save the problem into the returned XML node
+   * save the problem into the returned XML node, the solutions can be
+   * left out, binary puzzle files save them separately
    */
-  void save(XmlWriter &xml) const;
+  void save(XmlWriter &xml, bool withSolutions = true) const;
 
   /**
    * return the current set grid type for this puzzle.
@@ -509,8 +523,53 @@ class Problem {
   /** remove the i-th solution from the solution list */
   void removeSolution(unsigned int sol);
 
+  /**
+   * add the results of another problem, that has been solved separately, e.g. one
+   * part of a split search (see AssemblerInterface::splitSearch). Both problems
+   * must be solved. The solutions of the other problem are moved to the end of our
+   * list and get numbers that follow ours, assembly and solution counters and the time are added
+   */
+  void mergeSolutions(Problem &other);
+
   /** sort solutions by 0=assembly, 1=level, 2=sumMoves, 3=pieces */
   void sortSolutions(int by);
+
+  /**
+   * check if the solutions are sorted by 1=level or 2=sumMoves and all
+   * have disassembly information
+   */
+  bool solutionsSorted(int by) const;
+
+  /**
+   * find the position where a solution with the given disassembly needs to be inserted
+   * to keep the solutions sorted by 1=level or 2=sumMoves, that is behind all solutions
+   * that are not larger. This is a binary search, so solutionsSorted must be true
+   */
+  unsigned int solutionPosition(const Disassembly *d, int by) const;
+
+  /**
+   * keep the solutions packed, only the window most recently added or used solutions stay
+   * unpacked. This is meant for searches that keep millions of solutions. The packed
+   * solutions are kept in memory or, when fname is not 0, in that file. The file is
+   * temporary and is removed when the problem is deleted, saving the problem still
+   * writes all solutions. Returns false, when the file can not be created. Can only be called once.
+   *
+   * The assemblies and disassemblies returned by the solutions are only valid until
+   * window other solutions have been used, so window must be at least 2
+   */
+  bool setSolutionSpill(const char *fname, unsigned int window);
+
+  /** write the solutions for a binary puzzle file, see binary-puzzle.h */
+  void saveBinarySolutions(std::ostream &out) const;
+
+  /**
+   * take over the solutions saved by saveBinarySolutions, they are at pos in the mapped
+   * file and take size bytes. The solutions stay packed in the mapped file until they
+   * are used, window is as in setSolutionSpill. There must be no solutions.
+   * Returns false, when the records are not inside of the section, the problem then
+   * has no solutions
+   */
+  bool loadBinarySolutions(std::shared_ptr<const MappedFile> map, uint64_t pos, uint64_t size, unsigned int window);
   //@}
 
  private:
@@ -180,7 +180,7 @@ void Puzzle::getColor(unsigned int idx,
   *b = (colors[idx] >> 16) & 0xFF;
 }
 
-void Puzzle::save(XmlWriter &xml) const {
+void Puzzle::save(XmlWriter &xml, bool withSolutions) const {
   xml.newTag("puzzle");
   xml.newAttrib("version", "2");
 
@@ -205,7 +205,7 @@ void Puzzle::save(XmlWriter &xml) const {
 
   xml.newTag("problems");
   for (unsigned int i = 0; i < problems.size(); i++)
-    problems[i]->save(xml);
+    problems[i]->save(xml, withSolutions);
   xml.endTag("problems");
 
   xml.newTag("comment");
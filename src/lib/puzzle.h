@@ -110,9 +110,10 @@ class Puzzle {
   explicit Puzzle(XmlParser &pars);
 
   /**
-   * save the puzzle into a XML node that is returned
+   * save the puzzle into a XML node that is returned, the solutions
+   * can be left out, binary puzzle files save them separately
    */
-  void save(XmlWriter &xml) const;
+  void save(XmlWriter &xml, bool withSolutions = true) const;
 
   /**
    * Destructor.
@@ -118,7 +118,7 @@ Separation *SimpleDisassembler::disassemble_rec(const std::vector<unsigned int>
          * isn't use anywhere else, we can delete it here
          */
         if (st->decRefCount())
-          delete st;
+          st->destroy();
 
         continue;
       }
@@ -136,7 +136,7 @@ Separation *SimpleDisassembler::disassemble_rec(const std::vector<unsigned int>
         // and st hold one count of the node, once we get to use boost smart
         // ponters this here will become simpler
         if (st->decRefCount())
-          delete st;
+          st->destroy();
 
         continue;
       }
@@ -147,7 +147,7 @@ Separation *SimpleDisassembler::disassemble_rec(const std::vector<unsigned int>
       Separation *res = checkSubproblems(st, pieces);
 
       if (st->decRefCount())
-        delete st;
+        st->destroy();
 
       return res;
 
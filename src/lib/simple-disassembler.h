@@ -54,7 +54,7 @@ class SimpleDisassembler : public BaseDisassembler {
 
  public:
 
-  SimpleDisassembler(const Problem *puz) : BaseDisassembler(puz) {}
+  SimpleDisassembler(const Problem *puz, movementCache_c *cache = 0) : BaseDisassembler(puz, cache) {}
   ~SimpleDisassembler() {}
 
  private:
@@ -0,0 +1,316 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "solution-spill.h"
+
+#include "bt_assert.h"
+#include "solution.h"
+#include "assembly.h"
+#include "disassembly.h"
+#include "packing.h"
+
+#include "../tools/mappedfile.h"
+
+#include <cstdio>
+#include <cstring>
+
+/* the file starts with this, so that position 0 is never a record */
+static const char spillMagic[8] = { 'B', 'T', 'S', 'S', 2, 0, 0, 0 };
+
+/* a record is its length followed by the packed assembly and a byte telling what follows:
+ * 0 nothing, 1 a separation or 2 a separationInfo, see PackWriter.
+ */
+
+void SolutionSpill::unpack(PackReader &rd, const GridType *gt, Assembly **a, Separation **t, SeparationInfo **ti) {
+
+  *a = rd.getAssembly(gt);
+  *t = 0;
+  *ti = 0;
+
+  try {
+
+    switch (rd.getByte()) {
+      case 0:
+        break;
+      case 1:
+        *t = rd.getSeparation();
+        break;
+      case 2:
+        *ti = rd.getSeparationInfo();
+        break;
+      default:
+        throw packException_c("solution record has an invalid type");
+    }
+
+    if (!rd.atEnd())
+      throw packException_c("solution record is too long");
+  }
+
+  catch (...) {
+    delete *a;
+    delete *t;
+    delete *ti;
+    *a = 0;
+    *t = 0;
+    *ti = 0;
+    throw;
+  }
+}
+
+SolutionSpill::SolutionSpill(const GridType *g, unsigned int w) : gt(g), window(w), fileEnd(0) {
+  // at least 2, because code compares solutions with each other
+  bt_assert(window >= 2);
+}
+
+SolutionSpill::~SolutionSpill(void) {
+
+  bt_assert(loaded.empty());
+
+  if (file.is_open()) {
+    file.close();
+    std::remove(name.c_str());
+  }
+}
+
+bool SolutionSpill::setFile(const char *n) {
+
+  bt_assert(!file.is_open());
+  bt_assert(!mapping);
+  bt_assert(loaded.empty());
+
+  file.open(n, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+
+  if (!file.is_open())
+    return false;
+
+  file.write(spillMagic, sizeof(spillMagic));
+
+  if (!file) {
+    file.close();
+    std::remove(n);
+    return false;
+  }
+
+  name = n;
+  fileEnd = sizeof(spillMagic);
+
+  return true;
+}
+
+void SolutionSpill::setMapping(std::shared_ptr<const MappedFile> map) {
+
+  bt_assert(!file.is_open());
+  bt_assert(!mapping);
+
+  mapping = map;
+}
+
+void SolutionSpill::pack(std::vector<unsigned char> &buf, const Assembly *a, const Separation *t, const SeparationInfo *ti) {
+
+  std::vector<unsigned char> body;
+  PackWriter w(body);
+
+  w.putAssembly(a);
+
+  if (t) {
+    w.putByte(1);
+    w.putSeparation(t);
+  } else if (ti) {
+    w.putByte(2);
+    w.putSeparationInfo(ti);
+  } else
+    w.putByte(0);
+
+  PackWriter l(buf);
+
+  l.putUnsigned(body.size());
+  buf.insert(buf.end(), body.begin(), body.end());
+}
+
+void SolutionSpill::write(Solution *s) {
+
+  std::vector<unsigned char> buf;
+
+  pack(buf, s->assembly, s->tree, s->treeInfo);
+
+  if (file.is_open()) {
+
+    file.seekp(fileEnd);
+    file.write((const char *)&buf[0], buf.size());
+    bt_assert(file);
+
+    s->spillPos = fileEnd;
+    fileEnd += buf.size();
+
+  } else {
+
+    s->packed = new unsigned char[buf.size()];
+    memcpy(s->packed, &buf[0], buf.size());
+  }
+}
+
+void SolutionSpill::dropRecord(Solution *s) {
+  delete [] s->packed;
+  s->packed = 0;
+  s->spillPos = 0;
+}
+
+void SolutionSpill::read(const Solution *s, Assembly **a, Separation **t, SeparationInfo **ti) {
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  readRecord(s, a, t, ti);
+}
+
+void SolutionSpill::readRecord(const Solution *s, Assembly **a, Separation **t, SeparationInfo **ti) {
+
+  if (s->packed) {
+
+    // the length is at most 10 bytes and the record follows it
+    PackReader len(s->packed, 10);
+    size_t l = len.getUnsigned();
+
+    PackReader rd(s->packed + len.getPos(), l);
+    unpack(rd, gt, a, t, ti);
+
+    return;
+  }
+
+  bt_assert(s->spillPos);
+
+  if (mapping) {
+
+    if (s->spillPos >= mapping->getSize())
+      throw packException_c("solution record is outside of the file");
+
+    PackReader len(mapping->getData() + s->spillPos, mapping->getSize() - s->spillPos);
+    uint64_t l = len.getUnsigned();
+
+    if (l > mapping->getSize() - s->spillPos - len.getPos())
+      throw packException_c("solution record is outside of the file");
+
+    PackReader rd(mapping->getData() + s->spillPos + len.getPos(), l);
+    unpack(rd, gt, a, t, ti);
+
+    return;
+  }
+
+  file.seekg(s->spillPos);
+
+  unsigned char lenBuf[10];
+  unsigned int lenSize = 0;
+
+  do {
+    if (lenSize >= sizeof(lenBuf))
+      throw packException_c("solution record has an invalid length");
+    lenBuf[lenSize] = file.get();
+    if (!file)
+      throw packException_c("solution record can not be read");
+  } while (lenBuf[lenSize++] & 0x80);
+
+  PackReader len(lenBuf, lenSize);
+  std::vector<unsigned char> buf(len.getUnsigned());
+
+  if (buf.size())
+    file.read((char *)&buf[0], buf.size());
+  if (!file)
+    throw packException_c("solution record can not be read");
+
+  PackReader rd(buf.size() ? &buf[0] : 0, buf.size());
+  unpack(rd, gt, a, t, ti);
+}
+
+void SolutionSpill::evict(void) {
+
+  while (loaded.size() > window) {
+
+    Solution *s = loaded.front();
+    loaded.pop_front();
+
+    // only write the solution when there is no record with the current content
+    if (!s->spillPos && !s->packed)
+      write(s);
+
+    delete s->assembly;
+    delete s->tree;
+    delete s->treeInfo;
+
+    s->assembly = 0;
+    s->tree = 0;
+    s->treeInfo = 0;
+  }
+}
+
+void SolutionSpill::add(Solution *s) {
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  bt_assert(s->assembly);
+  bt_assert(!s->spill);
+
+  s->spill = this;
+  s->spillPos = 0;
+  s->packed = 0;
+  s->spillEntry = loaded.insert(loaded.end(), s);
+
+  evict();
+}
+
+Solution *SolutionSpill::addMapped(unsigned int assmNum, unsigned int solNum, uint64_t pos) {
+
+  bt_assert(mapping);
+  bt_assert(pos);
+
+  return new Solution(this, pos, assmNum, solNum);
+}
+
+void SolutionSpill::use(const Solution *sol) {
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  Solution *s = const_cast<Solution *>(sol);
+
+  if (s->assembly) {
+    loaded.splice(loaded.end(), loaded, s->spillEntry);
+    return;
+  }
+
+  readRecord(s, &s->assembly, &s->tree, &s->treeInfo);
+  s->spillEntry = loaded.insert(loaded.end(), s);
+
+  evict();
+}
+
+void SolutionSpill::changed(Solution *s) {
+  boost::mutex::scoped_lock lock(mutex);
+  dropRecord(s);
+}
+
+void SolutionSpill::remove(const Solution *sol) {
+
+  boost::mutex::scoped_lock lock(mutex);
+
+  Solution *s = const_cast<Solution *>(sol);
+
+  if (s->assembly)
+    loaded.erase(s->spillEntry);
+
+  dropRecord(s);
+}
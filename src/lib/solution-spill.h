@@ -0,0 +1,162 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#ifndef __SOLUTION_SPILL_H__
+#define __SOLUTION_SPILL_H__
+
+/** \file solution-spill.h
+ * contains a class that keeps the solutions of a problem packed
+ */
+
+#include <list>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <inttypes.h>
+
+#include <boost/thread/mutex.hpp>
+
+class Solution;
+class Assembly;
+class Separation;
+class SeparationInfo;
+class GridType;
+class MappedFile;
+class PackReader;
+
+/**
+ * Keeps solutions packed, in memory or in a file.
+ *
+ * Only the solutions that were added or used most recently, the window, keep
+ * their assembly and disassembly as objects. When more solutions are used
+ * the oldest ones are packed into a record (see PackWriter), if they don't
+ * already have one with their current content, and their objects are freed.
+ * The Solution objects with their numbers stay, so the solutions can still be
+ * accessed by index and when one of them is used again its content is unpacked.
+ *
+ * Without a file each solution keeps its record in memory. With a file the records
+ * are appended to it. When a solution is changed after it has been written its next
+ * record is appended behind all others and the old one is no longer used.
+ *
+ * The records can also be in a mapped binary puzzle file (see binary-puzzle.h). The
+ * solutions loaded from there start with only their record and are unpacked on
+ * their first use. Records of changed solutions are then kept in memory.
+ *
+ * The file is a temporary file, it is removed when the spill is destroyed, saving
+ * the puzzle writes all solutions into the puzzle file
+ */
+class SolutionSpill {
+
+  const GridType *gt;
+
+  /** the number of solutions whose content is kept unpacked */
+  unsigned int window;
+
+  std::string name;
+  std::fstream file;
+
+  /** position of the end of the file, where the next record goes */
+  uint64_t fileEnd;
+
+  /** the mapped file the records of loaded solutions are in */
+  std::shared_ptr<const MappedFile> mapping;
+
+  /** the solver and the user interface may use solutions at the same time */
+  boost::mutex mutex;
+
+  /**
+   * the solutions that have their content unpacked, the least recently used first.
+   * The solutions know their entry in here, so moving them to the end is quick
+   */
+  std::list<Solution *> loaded;
+
+  /** pack the content of the solution into a new record */
+  void write(Solution *s);
+
+  /** make room in the window by packing the least recently used solutions */
+  void evict(void);
+
+  /** forget the record of the solution */
+  void dropRecord(Solution *s);
+
+  void readRecord(const Solution *s, Assembly **a, Separation **t, SeparationInfo **ti);
+
+ public:
+
+  SolutionSpill(const GridType *gt, unsigned int window);
+  ~SolutionSpill(void);
+
+  /**
+   * keep the records in a file instead of in memory, an existing file is
+   * overwritten. Must be called before solutions are added.
+   * Returns false when that is not possible
+   */
+  bool setFile(const char *name);
+
+  /**
+   * the records of the solutions added with addMapped are in this file, it
+   * is kept until the spill is destroyed
+   */
+  void setMapping(std::shared_ptr<const MappedFile> map);
+
+  /**
+   * create a solution whose content is the record at pos in the mapped file,
+   * the record is not checked before the solution is used. A damaged record
+   * then throws a packException_c, see use
+   */
+  Solution *addMapped(unsigned int assmNum, unsigned int solNum, uint64_t pos);
+
+  /** let the spill handle this solution, the solution must have its content */
+  void add(Solution *s);
+
+  /**
+   * the solution has just been used, unpack its content when necessary.
+   * When the record is damaged or can not be read a packException_c is thrown
+   * and the solution stays without content
+   */
+  void use(const Solution *s);
+
+  /** the content of the solution has been changed, its record is outdated */
+  void changed(Solution *s);
+
+  /** the solution is deleted, forget about it */
+  void remove(const Solution *s);
+
+  /**
+   * unpack the record of a solution without loading it into the solution, the caller
+   * gets the returned objects, t and ti may be set to 0
+   */
+  void read(const Solution *s, Assembly **a, Separation **t, SeparationInfo **ti);
+
+  /** append a record with the given content to buf */
+  static void pack(std::vector<unsigned char> &buf, const Assembly *a, const Separation *t, const SeparationInfo *ti);
+
+  /** unpack a record without its length, throws a packException_c when it is damaged */
+  static void unpack(PackReader &rd, const GridType *gt, Assembly **a, Separation **t, SeparationInfo **ti);
+
+ private:
+
+  // no copying and assigning
+  SolutionSpill(const SolutionSpill &);
+  void operator=(const SolutionSpill &);
+};
+
+#endif
@@ -23,12 +23,14 @@
 #include "bt_assert.h"
 #include "disassembly.h"
 #include "assembly.h"
+#include "solution-spill.h"
+#include "packing.h"
 
 #include "../tools/xml.h"
 
 Solution::Solution(XmlParser &pars, unsigned int pieces, const GridType *gt)
     :
-    tree(0), treeInfo(0), assemblyNum(0), solutionNum(0) {
+    assembly(0), tree(0), treeInfo(0), assemblyNum(0), solutionNum(0), spill(0), spillPos(0), packed(0) {
   pars.require(XmlParser::START_TAG, "solution");
 
   std::string str;
@@ -84,7 +86,22 @@ Solution::Solution(XmlParser &pars, unsigned int pieces, const GridType *gt)
   }
 }
 
-void Solution::save(XmlWriter &xml) const {
+void Solution::use(void) const {
+  if (spill)
+    spill->use(this);
+}
+
+void Solution::changed(void) {
+  if (spill)
+    spill->changed(this);
+}
+
+static void saveSolution(XmlWriter &xml,
+                         unsigned int assemblyNum,
+                         unsigned int solutionNum,
+                         const Assembly *assembly,
+                         const Separation *tree,
+                         const SeparationInfo *treeInfo) {
   xml.newTag("solution");
 
   if (assemblyNum) {
@@ -105,7 +122,58 @@ void Solution::save(XmlWriter &xml) const {
   xml.endTag("solution");
 }
 
+void Solution::save(XmlWriter &xml) const {
+
+  if (assembly) {
+    saveSolution(xml, assemblyNum, solutionNum, assembly, tree, treeInfo);
+    return;
+  }
+
+  /* the content is only in the spill, read it for the save but don't
+   * load it into the solution, so that saving doesn't fill the memory
+   */
+  Assembly *a;
+  Separation *t;
+  SeparationInfo *ti;
+
+  spill->read(this, &a, &t, &ti);
+
+  saveSolution(xml, assemblyNum, solutionNum, a, t, ti);
+
+  delete a;
+  delete t;
+  delete ti;
+}
+
+void Solution::saveBinary(std::vector<unsigned char> &buf) const {
+
+  PackWriter w(buf);
+
+  w.putUnsigned(assemblyNum);
+  w.putUnsigned(solutionNum);
+
+  if (assembly) {
+    SolutionSpill::pack(buf, assembly, tree, treeInfo);
+    return;
+  }
+
+  Assembly *a;
+  Separation *t;
+  SeparationInfo *ti;
+
+  spill->read(this, &a, &t, &ti);
+
+  SolutionSpill::pack(buf, a, t, ti);
+
+  delete a;
+  delete t;
+  delete ti;
+}
+
 Solution::~Solution() {
+  if (spill)
+    spill->remove(this);
+
   if (tree)
     delete tree;
 
@@ -117,6 +185,9 @@ Solution::~Solution() {
 }
 
 void Solution::exchangeShape(unsigned int s1, unsigned int s2) {
+  use();
+  changed();
+
   if (assembly)
     assembly->exchangeShape(s1, s2);
   if (tree)
@@ -124,18 +195,16 @@ void Solution::exchangeShape(unsigned int s1, unsigned int s2) {
 }
 
 const Disassembly *Solution::getDisassemblyInfo(void) const {
-  if (tree) return tree;
-  if (treeInfo) return treeInfo;
-  return 0;
-}
-
-Disassembly *Solution::getDisassemblyInfo(void) {
+  use();
   if (tree) return tree;
   if (treeInfo) return treeInfo;
   return 0;
 }
 
 void Solution::removeDisassembly(void) {
+  use();
+  changed();
+
   if (tree) {
     if (!treeInfo)
       treeInfo = new SeparationInfo(tree);
@@ -146,6 +215,9 @@ void Solution::removeDisassembly(void) {
 }
 
 void Solution::setDisassembly(Separation *sep) {
+  use();
+  changed();
+
   if (tree) delete tree;
   tree = sep;
 
@@ -154,6 +226,9 @@ void Solution::setDisassembly(Separation *sep) {
 }
 
 void Solution::removePieces(unsigned int start, unsigned int count) {
+  use();
+  changed();
+
   if (assembly)
     assembly->removePieces(start, count);
   if (tree)
@@ -161,6 +236,9 @@ void Solution::removePieces(unsigned int start, unsigned int count) {
 }
 
 void Solution::addNonPlacedPieces(unsigned int start, unsigned int count) {
+  use();
+  changed();
+
   if (assembly)
     assembly->addNonPlacedPieces(start, count);
   if (tree)
@@ -21,6 +21,10 @@
 #ifndef __SOLUTION_H__
 #define __SOLUTION_H__
 
+#include <list>
+#include <vector>
+#include <inttypes.h>
+
 class Assembly;
 class Separation;
 class SeparationInfo;
@@ -28,6 +32,7 @@ class XmlParser;
 class XmlWriter;
 class GridType;
 class Disassembly;
+class SolutionSpill;
 
 /**
  * This class stores the information for one solution for a
@@ -35,19 +40,23 @@ class Disassembly;
  */
 class Solution {
   /* the assembly contains the pieces so that they
-   * do assemble into the result shape */
-  Assembly *assembly;
+   * do assemble into the result shape
+   *
+   * when the solution is handled by a SolutionSpill this and the
+   * disassembly are 0 while the content is only in the file
+   */
+  mutable Assembly *assembly;
 
   /* the disassembly tree, only not NULL, if we
    * have disassembled the puzzle
    */
-  Separation *tree;
+  mutable Separation *tree;
 
   /* if no separation is given, maybe we have a separationInfo
    * that contains only some of the information of a full separation
    * but requires a lot less memory
    */
-  SeparationInfo *treeInfo;
+  mutable SeparationInfo *treeInfo;
 
   /* as it is now possible to not save all solutions
    * it might be useful to know the exact number and sequence
@@ -58,6 +67,35 @@ class Solution {
   unsigned int assemblyNum;
   unsigned int solutionNum;
 
+  /* the spill that handles this solution, or 0. The current record of the solution
+   * is either at spillPos in the file or in packed, when the spill keeps the
+   * records in memory. spillPos is 0 and packed is 0 when there is no record.
+   * spillEntry is the entry in the list of loaded solutions of the spill
+   */
+  SolutionSpill *spill;
+  uint64_t spillPos;
+  unsigned char *packed;
+  std::list<Solution *>::iterator spillEntry;
+
+  /* load the content from the spill, if necessary */
+  void use(void) const;
+
+  /* the content has been changed, so the record in the spill is outdated */
+  void changed(void);
+
+  friend class SolutionSpill;
+
+  /** create a solution whose content is only the record at pos of the spill */
+  Solution(SolutionSpill *s, uint64_t pos, unsigned int assmNum, unsigned int solNum) :
+      assembly(0),
+      tree(0),
+      treeInfo(0),
+      assemblyNum(assmNum),
+      solutionNum(solNum),
+      spill(s),
+      spillPos(pos),
+      packed(0) {}
+
  public:
 
   /** create a solution with a proper separation */
@@ -69,7 +107,10 @@ class Solution {
       tree(t),
       treeInfo(0),
       assemblyNum(assmNum),
-      solutionNum(solNum) {}
+      solutionNum(solNum),
+      spill(0),
+      spillPos(0),
+      packed(0) {}
 
   /** create a solution with only separation information */
   Solution(Assembly *assm,
@@ -80,7 +121,10 @@ class Solution {
       tree(0),
       treeInfo(ti),
       assemblyNum(assmNum),
-      solutionNum(solNum) {}
+      solutionNum(solNum),
+      spill(0),
+      spillPos(0),
+      packed(0) {}
 
   /** creat a solution with assembly only, no disassembly */
   Solution(Assembly *assm, unsigned int assmNum) :
@@ -88,7 +132,10 @@ class Solution {
       tree(0),
       treeInfo(0),
       assemblyNum(assmNum),
-      solutionNum(0) {}
+      solutionNum(0),
+      spill(0),
+      spillPos(0),
+      packed(0) {}
 
   /** load a solution from file */
   Solution(XmlParser &pars, unsigned int pieces, const GridType *gt);
@@ -98,16 +145,29 @@ class Solution {
   /** save the solution to the XML file */
   void save(XmlWriter &xml) const;
 
-  /** get the assembly from this solution, it will always be not NULL */
-  Assembly *getAssembly() { return assembly; }
-  const Assembly *getAssembly(void) const { return assembly; }
+  /** append the solution in the format of binary puzzle files to buf */
+  void saveBinary(std::vector<unsigned char> &buf) const;
+
+  /**
+   * get the assembly from this solution, it will always be not NULL.
+   *
+   * Changes are only possible with the functions of the solution, so that a spill
+   * knows about them. When the solution is handled by a spill the returned objects of
+   * this and the 2 following functions are only valid until the spill unloads the solution,
+   * see Problem::setSolutionSpill, whoever needs them longer must make a copy
+   */
+  const Assembly *getAssembly(void) const {
+    use();
+    return assembly;
+  }
 
   /** get the full disassembly or 0 if there is none */
-  Separation *getDisassembly() { return tree; }
-  const Separation *getDisassembly(void) const { return tree; }
+  const Separation *getDisassembly(void) const {
+    use();
+    return tree;
+  }
 
   /** get either the disassembly or the disassembly information or nothing */
-  Disassembly *getDisassemblyInfo(void);
   const Disassembly *getDisassemblyInfo(void) const;
 
   /** get the assembly number */
@@ -115,6 +175,12 @@ class Solution {
   /** get the solution number (0 if this solution has no disassembly */
   unsigned int getSolutionNumber(void) const { return solutionNum; }
 
+  /** add the given values to the assembly and solution number, used when merging solution lists */
+  void addToNumbers(unsigned int assm, unsigned int sol) {
+    assemblyNum += assm;
+    solutionNum += sol;
+  }
+
   /** remove an existing disassembly, and replace it by disassembly information */
   void removeDisassembly(void);
   /** add a new disassembly to this solution, deleting an old one, in
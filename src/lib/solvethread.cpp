@@ -24,6 +24,8 @@
 #include "problem.h"
 #include "assembly.h"
 #include "simple-disassembler.h"
+#include "movementcache.h"
+#include "grid-type.h"
 #include "solution.h"
 
 void SolveThread::run(void) {
@@ -40,8 +42,9 @@ void SolveThread::run(void) {
 
       /* otherwise we have to create a new one
        */
-      action = SolveThread::ACT_PREPARATION;
+      setAction(SolveThread::ACT_PREPARATION);
       assm = puzzle->getGridType()->findAssembler(puzzle);
+      assm->setThreads(threads, splitDepth);
 
       errState = assm->createMatrix(puzzle,
                                     parameters & PAR_KEEP_MIRROR,
@@ -51,7 +54,7 @@ void SolveThread::run(void) {
 
         errParam = assm->getErrorsParam();
 
-        action = SolveThread::ACT_ERROR;
+        setAction(SolveThread::ACT_ERROR);
 
         delete assm;
         return;
@@ -60,7 +63,7 @@ void SolveThread::run(void) {
       if (parameters & PAR_REDUCE) {
 
         if (!stopPressed)
-          action = SolveThread::ACT_REDUCE;
+          setAction(SolveThread::ACT_REDUCE);
 
         assm->reduce();
       }
@@ -72,30 +75,33 @@ void SolveThread::run(void) {
        */
       errState = puzzle->setAssembler(assm);
       if (errState != AssemblerInterface::ERR_NONE) {
-        action = SolveThread::ACT_ERROR;
+        setAction(SolveThread::ACT_ERROR);
         return;
       }
     }
 
     if (return_after_prep) {
-      action = SolveThread::ACT_PAUSING;
+      setAction(SolveThread::ACT_PAUSING);
       return;
     }
 
     if (!stopPressed) {
 
-      action = SolveThread::ACT_ASSEMBLING;
+      setAction(SolveThread::ACT_ASSEMBLING);
+      assm->setThreads(threads, splitDepth);
+      startDisassemblers();
       assm->assemble(this);
+      finishDisassembly();
       puzzle->addTime(time(0) - startTime);
 
       if (assm->getFinished() >= 1) {
-        action = SolveThread::ACT_FINISHED;
+        setAction(SolveThread::ACT_FINISHED);
         puzzle->finishedSolving();
       } else
-        action = SolveThread::ACT_PAUSING;
+        setAction(SolveThread::ACT_PAUSING);
 
     } else {
-      action = SolveThread::ACT_PAUSING;
+      setAction(SolveThread::ACT_PAUSING);
       puzzle->addTime(time(0) - startTime);
     }
 
@@ -103,8 +109,10 @@ void SolveThread::run(void) {
 
   catch (assert_exception a) {
 
+    stopDisassemblers();
+
     ae = a;
-    action = SolveThread::ACT_ASSERT;
+    setAction(SolveThread::ACT_ASSERT);
     if (puzzle->getAssembler())
       puzzle->removeAllSolutions();
   }
@@ -112,30 +120,95 @@ void SolveThread::run(void) {
 
 SolveThread::SolveThread(Problem *puz, int par) :
     action(ACT_PREPARATION),
+    statActionStart(0),
+    statAssemblies(0),
+    statSolutions(0),
+    statQueue(0),
+    pollTime(0),
+    pollIterations(0),
+    pollAssemblies(0),
+    pollSolutions(0),
     puzzle(puz),
     parameters(par),
     sortMethod(SRT_COMPLETE_MOVES),
+    sortedBy(0),
+    threads(1),
+    splitDepth(0),
+    disassemblerThreads(1),
     solutionLimit(10),
     solutionDrop(1),
     disassm(0),
-    assm(0) {
+    assm(0),
+    movementCache(0),
+    nextJob(0),
+    pipelined(false),
+    jobsFinished(false) {
+
+  if (par & PAR_DISASSM) {
+    movementCache = puzzle->getGridType()->getMovementCache(puzzle);
+    disassm = newDisassembler();
+  }
 
-  if (par & PAR_DISASSM)
-    disassm = new SimpleDisassembler(puz);
+  for (unsigned int i = 0; i <= ACT_WAIT_TO_STOP; i++)
+    statActionTime[i] = 0;
 }
 
 SolveThread::~SolveThread() {
 
   kill();
 
+  stopDisassemblers();
+
+  // the first one is disassm
+  for (unsigned int i = 1; i < disassemblers.size(); i++)
+    delete disassemblers[i];
+
   if (disassm) {
     delete disassm;
     disassm = 0;
   }
+
+  delete movementCache;
 }
 
 bool SolveThread::assembly(Assembly *a) {
 
+  if (pipelined) {
+    queueAssembly(a);
+    return true;
+  }
+
+  Separation *s = 0;
+  bool disassembled = false;
+
+  // when the assembly has only 1 piece, we don't need
+  // to disassemble, the disassembler will return 0 anyway
+  if ((parameters & PAR_DISASSM) && (a->placementCount() > 1)) {
+
+    // try to disassemble
+    setAction(ACT_DISASSEMBLING);
+    disassembled = disassemble(disassm, a, &s);
+    setAction(ACT_ASSEMBLING);
+  }
+
+  addAssembly(a, s, disassembled);
+
+  return true;
+}
+
+bool SolveThread::disassemble(DisassemblerInterface *d, const Assembly *a, Separation **s) const {
+
+  // when we only count the solutions nobody will ever look at the
+  // disassembly, so don't let the disassembler create it
+  if (parameters & PAR_JUST_COUNT)
+    return d->disassemblable(a);
+
+  *s = d->disassemble(a);
+  return *s != 0;
+}
+
+void SolveThread::addAssembly(Assembly *a, Separation *s, bool disassembled) {
+
   enum {
     SOL_COUNT_ASM,
     SOL_SAVE_ASM,
@@ -169,18 +242,15 @@ bool SolveThread::assembly(Assembly *a) {
         // only one piece, that is always a solution, so increment number
         // of solutions but save only the assembly
         puzzle->addSolution(a);
+        sortedBy = 0;
         puzzle->incNumSolutions();
+        statSolutions++;
 
         break;
       }
 
-      // try to disassemble
-      action = ACT_DISASSEMBLING;
-      Separation *s = disassm->disassemble(a);
-      action = ACT_ASSEMBLING;
-
       // check, if we found a disassembly sequence
-      if (!s) {
+      if (!disassembled) {
         // no disassembly sequence found, delete assembly
         delete a;
 
@@ -196,6 +266,7 @@ bool SolveThread::assembly(Assembly *a) {
 
         // yes, the puzzle is disassembable count solutions
         puzzle->incNumSolutions();
+        statSolutions++;
 
         break;
       }
@@ -203,67 +274,39 @@ bool SolveThread::assembly(Assembly *a) {
       // find the place to insert and insert the new solution so that
       // they are sorted by the complexity of the disassembly
 
-      bool ins = false;
-
       switch (sortMethod) {
-        case SRT_COMPLETE_MOVES: {
-          unsigned int lev = s->sumMoves();
+        case SRT_COMPLETE_MOVES:
+        case SRT_LEVEL: {
 
-          for (unsigned int i = 0; i < puzzle->solutionNumber(); i++) {
+          // the key for Problem::sortSolutions
+          int by = (sortMethod == SRT_LEVEL) ? 1 : 2;
 
-            const Disassembly *s2 = puzzle->getSolution(i)->getDisassembly();
+          // the saved solutions are normally sorted as they have all been added here,
+          // then we can use a binary search to find the place, otherwise
+          // take the position before the first larger solution
+          if (sortedBy != by && puzzle->solutionsSorted(by))
+            sortedBy = by;
 
-            if (s2 && s2->sumMoves() > lev) {
-              if (parameters & PAR_DROP_DISASSEMBLIES) {
-                puzzle->addSolution(a, new SeparationInfo(s), i);
-                delete s;
-              } else
-                puzzle->addSolution(a, s, i);
-              ins = true;
-              break;
-            }
-          }
-        }
+          unsigned int pos = puzzle->solutionNumber();
 
-          if (!ins) {
-            if (parameters & PAR_DROP_DISASSEMBLIES) {
-              puzzle->addSolution(a, new SeparationInfo(s));
-              delete s;
-            } else
-              puzzle->addSolution(a, s);
-          }
+          if (sortedBy == by)
+            pos = puzzle->solutionPosition(s, by);
+          else
+            for (unsigned int i = 0; i < puzzle->solutionNumber(); i++) {
 
-          // remove the front most solution, if we only want to save
-          // a limited number of solutions, as the front most
-          // solutions are the more unimportant ones
-          if (solutionLimit && (puzzle->solutionNumber() > solutionLimit))
-            puzzle->removeSolution(0);
+              const Disassembly *s2 = puzzle->getSolution(i)->getDisassemblyInfo();
 
-          break;
-        case SRT_LEVEL: {
-          for (unsigned int i = 0; i < puzzle->solutionNumber(); i++) {
-
-            const Disassembly
-                *s2 = puzzle->getSolution(i)->getDisassemblyInfo();
-
-            if (s2 && (s2->compare(s) > 0)) {
-              if (parameters & PAR_DROP_DISASSEMBLIES) {
-                puzzle->addSolution(a, new SeparationInfo(s), i);
-                delete s;
-              } else
-                puzzle->addSolution(a, s, i);
-              ins = true;
-              break;
+              if (s2 && ((by == 1) ? (s2->compare(s) > 0) : (s2->sumMoves() > s->sumMoves()))) {
+                pos = i;
+                break;
+              }
             }
-          }
 
-          if (!ins) {
-            if (parameters & PAR_DROP_DISASSEMBLIES) {
-              puzzle->addSolution(a, new SeparationInfo(s));
-              delete s;
-            } else
-              puzzle->addSolution(a, s);
-          }
+          if (parameters & PAR_DROP_DISASSEMBLIES) {
+            puzzle->addSolution(a, new SeparationInfo(s), pos);
+            delete s;
+          } else
+            puzzle->addSolution(a, s, pos);
         }
 
           // remove the front most solution, if we only want to save
@@ -292,12 +335,15 @@ bool SolveThread::assembly(Assembly *a) {
 
       // yes, the puzzle is disassembably, count solutions
       puzzle->incNumSolutions();
+      statSolutions++;
     }
       break;
   }
 
   puzzle->incNumAssemblies();
 
+  statAssemblies++;
+
   // this is the case for assembly only or unsorted disassembly solutions
   // we need to thin out the list
   if (solutionLimit && (puzzle->solutionNumber() > solutionLimit)) {
@@ -313,8 +359,253 @@ bool SolveThread::assembly(Assembly *a) {
 
     puzzle->removeSolution(idx + 1);
   }
+}
 
-  return true;
+void SolveThread::mergeSolutions(Problem *other) {
+
+  puzzle->mergeSolutions(*other);
+
+  if (parameters & PAR_JUST_COUNT)
+    return;
+
+  if ((parameters & PAR_DISASSM) && (sortMethod != SRT_UNSORT)) {
+
+    /* the sort is stable and the parts are in the order of the search, so
+     * equal solutions stay in the order they were found, like in addAssembly
+     * the front most solutions are removed
+     */
+    puzzle->sortSolutions((sortMethod == SRT_LEVEL) ? 1 : 2);
+
+    while (solutionLimit && (puzzle->solutionNumber() > solutionLimit))
+      puzzle->removeSolution(0);
+
+    return;
+  }
+
+  if (!solutionLimit)
+    return;
+
+  /* find out which solutions addAssembly keeps when it gets all of them in one
+   * go. Only the solutions that are added matter, as only those change the list,
+   * so we can jump from one to the next
+   */
+  bool assemblies = !(parameters & PAR_DISASSM);
+  unsigned int count = assemblies ? puzzle->getNumAssemblies() : puzzle->getNumSolutions();
+
+  std::vector<unsigned int> keep;
+  unsigned int mult = 1;
+
+  for (unsigned long idx = 0; idx < count; ) {
+
+    keep.push_back(idx);
+
+    if (keep.size() > solutionLimit) {
+
+      unsigned int i = (idx % (solutionLimit * solutionDrop * mult)) / (solutionDrop * mult);
+
+      if (i == solutionLimit - 1)
+        mult *= 2;
+
+      keep.erase(keep.begin() + i + 1);
+    }
+
+    idx = (idx / (solutionDrop * mult) + 1) * (solutionDrop * mult);
+  }
+
+  /* the part that found a solution the single search keeps might have dropped it while
+   * thinning out its own list, then the next solution found after it takes its place
+   */
+  puzzle->sortSolutions(0);
+
+  unsigned int k = 0;
+  bool taken = false;
+
+  for (unsigned int i = 0; i < puzzle->solutionNumber(); ) {
+
+    const Solution *s = puzzle->getSolution(i);
+    unsigned int num = assemblies ? s->getAssemblyNumber() : s->getSolutionNumber();
+
+    while (k + 1 < keep.size() && keep[k + 1] <= num) {
+      k++;
+      taken = false;
+    }
+
+    if (!taken) {
+      taken = true;
+      i++;
+    } else
+      puzzle->removeSolution(i);
+  }
+}
+
+DisassemblerInterface *SolveThread::newDisassembler(void) const {
+  return new SimpleDisassembler(puzzle, movementCache);
+}
+
+bool SolveThread::setMovementCacheFile(const char *name) {
+  return movementCache ? movementCache->setFile(name) : false;
+}
+
+void SolveThread::startDisassemblers(void) {
+
+  if (!(parameters & PAR_DISASSM) || (disassemblerThreads <= 1))
+    return;
+
+  /* create all disassemblers here, the constructors fill some caches
+   * of the puzzle that are not safe to be filled by several threads at once
+   */
+  if (disassemblers.empty())
+    disassemblers.push_back(disassm);
+
+  while (disassemblers.size() < disassemblerThreads)
+    disassemblers.push_back(newDisassembler());
+
+  nextJob = 0;
+  jobsFinished = false;
+  pipelined = true;
+
+  for (unsigned int i = 0; i < disassemblerThreads; i++)
+    disassemblerGroup.create_thread(boost::bind(&SolveThread::disassemblerThread, this, disassemblers[i]));
+}
+
+void SolveThread::stopDisassemblers(void) {
+
+  if (!pipelined)
+    return;
+
+  {
+    boost::mutex::scoped_lock lock(jobMutex);
+    jobsFinished = true;
+    jobCond.notify_all();
+  }
+
+  disassemblerGroup.join_all();
+
+  /* whatever is left here will never be added, this only happens
+   * when something went wrong
+   */
+  for (unsigned int i = 0; i < jobs.size(); i++) {
+    delete jobs[i]->assembly;
+    delete jobs[i]->separation;
+    delete jobs[i];
+  }
+  jobs.clear();
+
+  pipelined = false;
+}
+
+void SolveThread::disassemblerThread(DisassemblerInterface *d) {
+
+  boost::mutex::scoped_lock lock(jobMutex);
+
+  while (true) {
+
+    while (!jobsFinished && (nextJob >= jobs.size()))
+      jobCond.wait(lock);
+
+    if (jobsFinished)
+      break;
+
+    DisassemblyJob *j = jobs[nextJob++];
+
+    // jobs that need no disassembly are done right away
+    if (j->done)
+      continue;
+
+    lock.unlock();
+
+    try {
+      j->disassembled = disassemble(d, j->assembly, &j->separation);
+    }
+    catch (assert_exception &a) {
+      j->ae = a;
+      j->failed = true;
+    }
+
+    lock.lock();
+
+    j->done = true;
+    jobCond.notify_all();
+  }
+}
+
+void SolveThread::commitJobs(boost::mutex::scoped_lock &lock) {
+
+  while (!jobs.empty() && jobs.front()->done) {
+
+    DisassemblyJob *j = jobs.front();
+    jobs.pop_front();
+    if (nextJob > 0) nextJob--;
+
+    // the puzzle is only ever changed by the thread owning the lock, but the
+    // disassemblers should not wait for us
+    lock.unlock();
+
+    if (j->failed) {
+      assert_exception a = j->ae;
+      delete j->assembly;
+      delete j;
+      lock.lock();
+      throw a;
+    }
+
+    addAssembly(j->assembly, j->separation, j->disassembled);
+    delete j;
+
+    lock.lock();
+  }
+
+  statQueue = jobs.size();
+}
+
+void SolveThread::queueAssembly(Assembly *a) {
+
+  DisassemblyJob *j = new DisassemblyJob(a);
+
+  // when the assembly has only 1 piece, we don't need to disassemble
+  j->done = a->placementCount() <= 1;
+
+  boost::mutex::scoped_lock lock(jobMutex);
+
+  jobs.push_back(j);
+  statQueue = jobs.size();
+  jobCond.notify_all();
+
+  commitJobs(lock);
+
+  /* when all disassemblers are busy and a few more assemblies
+   * are waiting, the assembler needs to wait
+   */
+  while (jobs.size() >= 2 * disassemblerThreads) {
+
+    setAction(ACT_DISASSEMBLING);
+    jobCond.wait(lock);
+    commitJobs(lock);
+  }
+
+  if (action == ACT_DISASSEMBLING)
+    setAction(ACT_ASSEMBLING);
+}
+
+void SolveThread::finishDisassembly(void) {
+
+  if (!pipelined)
+    return;
+
+  {
+    boost::mutex::scoped_lock lock(jobMutex);
+
+    /* the position of the assembler is already behind the assemblies that are
+     * still waiting, so they need to be finished, even when stop has been pressed
+     */
+    while (true) {
+      commitJobs(lock);
+      if (jobs.empty()) break;
+      jobCond.wait(lock);
+    }
+  }
+
+  stopDisassemblers();
 }
 
 void SolveThread::stop() {
@@ -326,7 +617,7 @@ void SolveThread::stop() {
       )
     return;
 
-  action = ACT_WAIT_TO_STOP;
+  setAction(ACT_WAIT_TO_STOP);
 
   if (puzzle->getAssembler())
     puzzle->getAssembler()->stop();
@@ -340,6 +631,24 @@ bool SolveThread::start(bool stop_after_prep) {
   return_after_prep = stop_after_prep;
   startTime = time(0);
 
+  {
+    boost::mutex::scoped_lock lock(statMutex);
+
+    statStart = std::chrono::steady_clock::now();
+    statActionStart = 0;
+    for (unsigned int i = 0; i <= ACT_WAIT_TO_STOP; i++)
+      statActionTime[i] = 0;
+    statAssemblies = 0;
+    statSolutions = 0;
+    statQueue = 0;
+
+    pollTime = 0;
+    pollIterations = 0;
+    pollAssemblies = 0;
+    pollSolutions = 0;
+    pollDepths.clear();
+  }
+
   // calculate dropMultiplicator
 
   dropMultiplicator = 1;
@@ -382,3 +691,82 @@ unsigned int SolveThread::currentActionParameter() {
     default:return 0;
   }
 }
+
+void SolveThread::reduceProgress(unsigned int *checked, unsigned int *total) {
+
+  if (assm && (action == ACT_REDUCE))
+    assm->getReduceProgress(checked, total);
+  else
+    *checked = *total = 0;
+}
+
+uint64_t SolveThread::statNow(void) const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - statStart).count();
+}
+
+void SolveThread::setAction(unsigned int a) {
+
+  uint64_t now = statNow();
+  uint64_t start = statActionStart.exchange(now);
+
+  statActionTime[action] += now - start;
+  action = a;
+}
+
+void SolveThread::getStatistics(Statistics *s) {
+
+  boost::mutex::scoped_lock lock(statMutex);
+
+  uint64_t now = statNow();
+
+  s->action = action;
+  s->time = now * 1e-6;
+
+  for (unsigned int i = 0; i <= ACT_WAIT_TO_STOP; i++)
+    s->actionTime[i] = statActionTime[i] * 1e-6;
+
+  /* the current activity also gets the time since it started */
+  uint64_t start = statActionStart;
+  if (now > start)
+    s->actionTime[s->action] += (now - start) * 1e-6;
+
+  AssemblerInterface *a = puzzle->getAssembler();
+
+  if (a && ((s->action == ACT_ASSEMBLING) || (s->action == ACT_DISASSEMBLING))) {
+
+    std::vector<unsigned int> depths;
+    a->getSearchDepths(&depths);
+
+    for (unsigned int i = 0; i < depths.size(); i++) {
+      if (depths[i] >= pollDepths.size())
+        pollDepths.resize(depths[i] + 1, 0);
+      pollDepths[depths[i]]++;
+    }
+  }
+
+  s->finished = a ? a->getFinished() : 0;
+  s->iterations = a ? a->getIterations() : 0;
+  s->assemblies = statAssemblies;
+  s->solutions = statSolutions;
+  s->disassemblyQueue = statQueue;
+  s->depthHistogram = pollDepths;
+
+  if (movementCache)
+    movementCache->getStatistics(&s->movementCacheHits, &s->movementCacheMisses);
+  else
+    s->movementCacheHits = s->movementCacheMisses = 0;
+
+  double interval = (now - pollTime) * 1e-6;
+
+  if (interval > 0) {
+    s->iterationsPerSecond = (s->iterations >= pollIterations) ? (s->iterations - pollIterations) / interval : 0;
+    s->assembliesPerSecond = (s->assemblies - pollAssemblies) / interval;
+    s->solutionsPerSecond = (s->solutions - pollSolutions) / interval;
+  } else
+    s->iterationsPerSecond = s->assembliesPerSecond = s->solutionsPerSecond = 0;
+
+  pollTime = now;
+  pollIterations = s->iterations;
+  pollAssemblies = s->assemblies;
+  pollSolutions = s->solutions;
+}
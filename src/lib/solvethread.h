@@ -26,9 +26,19 @@
 #include "bt_assert.h"
 #include "thread.h"
 
+#include <boost/thread.hpp>
+
 #include <time.h>
+#include <inttypes.h>
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <chrono>
 
 class Problem;
+class Separation;
+class movementCache_c;
 
 /* this class will handle the solving of one problem of the puzzle, it can also
  * be used to continue an already started solution, so that you can save you results
@@ -51,8 +61,13 @@ class SolveThread : public AssemblerCallbackInterface, public Thread {
   };
 
  private:
-  /* what is currently happening the the assembler thread */
-  unsigned int action;
+  /* what is currently happening the the assembler thread, this is also read
+   * by other threads, so it is atomic. It must only be changed with setAction
+   * so that the time spent in each activity is counted
+   */
+  std::atomic<unsigned int> action;
+
+  void setAction(unsigned int a);
 
  public:
   /* return the current activity */
@@ -61,6 +76,9 @@ class SolveThread : public AssemblerCallbackInterface, public Thread {
   /* some activities might have a parameter, return that */
   unsigned int currentActionParameter(void);
 
+  /* the progress of reduce, see AssemblerInterface::getReduceProgress */
+  void reduceProgress(unsigned int *checked, unsigned int *total);
+
  private:
 
   AssemblerInterface::errState errState;
@@ -86,6 +104,72 @@ class SolveThread : public AssemblerCallbackInterface, public Thread {
   /* how much time has passed since calling start */
   unsigned long getTime() { return time(0) - startTime; }
 
+  /* a snapshot of the statistics of the solving process, see getStatistics */
+  struct Statistics {
+
+    /* the current activity and the seconds since start */
+    unsigned int action;
+    double time;
+
+    /* the seconds spent in each of the activities since start */
+    double actionTime[ACT_WAIT_TO_STOP + 1];
+
+    /* the finished fraction of the search and the number of iterations of the assembler */
+    float finished;
+    unsigned long iterations;
+
+    /* assemblies and solutions found since start */
+    unsigned long assemblies;
+    unsigned long solutions;
+
+    /* the rates since the previous call of getStatistics, or since start for the first call */
+    double iterationsPerSecond;
+    double assembliesPerSecond;
+    double solutionsPerSecond;
+
+    /* the number of assemblies waiting for or being analysed by the disassembler threads */
+    unsigned int disassemblyQueue;
+
+    /* how often each level of the search tree was the current level of one of
+     * the assembler threads when getStatistics was called
+     */
+    std::vector<unsigned long> depthHistogram;
+
+    /* the lookups in the movement cache shared by the disassemblers that found
+     * the values and those that had to calculate them
+     */
+    unsigned long movementCacheHits;
+    unsigned long movementCacheMisses;
+  };
+
+  /* fill in the statistics, this can be called by any thread at any time. The
+   * solver itself only updates some atomic counters, so polling doesn't slow it down.
+   * The depth histogram and the rates are calculated by the polling, so call this
+   * regularly, e.g. once a second, to get meaningful values
+   */
+  void getStatistics(Statistics *s);
+
+ private:
+
+  /* the counters updated by the solver */
+  std::chrono::steady_clock::time_point statStart;
+  std::atomic<uint64_t> statActionStart;   // microseconds after statStart the current action started
+  std::atomic<uint64_t> statActionTime[ACT_WAIT_TO_STOP + 1];   // microseconds
+  std::atomic<unsigned long> statAssemblies;
+  std::atomic<unsigned long> statSolutions;
+  std::atomic<unsigned int> statQueue;
+
+  /* the state of getStatistics, only used while holding statMutex */
+  boost::mutex statMutex;
+  uint64_t pollTime;
+  unsigned long pollIterations;
+  unsigned long pollAssemblies;
+  unsigned long pollSolutions;
+  std::vector<unsigned long> pollDepths;
+
+  /* microseconds since statStart */
+  uint64_t statNow(void) const;
+
  private:
 
   Problem *puzzle;
@@ -112,6 +196,9 @@ class SolveThread : public AssemblerCallbackInterface, public Thread {
 
   int sortMethod;
 
+  /* the key of Problem::sortSolutions the saved solutions are known to be sorted by, 0 when not known */
+  int sortedBy;
+
  public:
 
   enum {
@@ -122,6 +209,38 @@ class SolveThread : public AssemblerCallbackInterface, public Thread {
 
   void setSortMethod(int sort) { sortMethod = sort; }
 
+ private:
+
+  /* number of threads for the assembler and the split level for the parallel search */
+  unsigned int threads;
+  unsigned int splitDepth;
+
+ public:
+
+  /* let the assembler use more than one thread, splitDepth 0 lets the assembler choose */
+  void setThreads(unsigned int t, unsigned int depth = 0) {
+    threads = t;
+    splitDepth = depth;
+  }
+
+ private:
+
+  /* number of threads that disassemble the found assemblies */
+  unsigned int disassemblerThreads;
+
+ public:
+
+  /* disassemble the assemblies on the given number of threads, while the assembler
+   * continues searching. The solutions are still added in the order the assembler
+   * found them
+   */
+  void setDisassemblerThreads(unsigned int t) { disassemblerThreads = t; }
+
+  /* keep the movement cache of the disassemblers in the given file, see
+   * movementCache_c::setFile. Call before start. Returns false when the file can not be used
+   */
+  bool setMovementCacheFile(const char *name);
+
  private:
 
   /* don't save more than this number of solutions 0 means no limit */
@@ -163,6 +282,50 @@ class SolveThread : public AssemblerCallbackInterface, public Thread {
   DisassemblerInterface *disassm;
   AssemblerInterface *assm;
 
+  /* the movement cache shared by all disassemblers */
+  movementCache_c *movementCache;
+
+  /* one assembly waiting for or being analysed by one of the disassembler threads */
+  struct DisassemblyJob {
+    Assembly *assembly;
+    Separation *separation;
+    bool disassembled;    // the assembly can be disassembled, separation is 0 when just counting
+    bool done;
+    bool failed;          // the disassembler did throw an assert_exception
+    assert_exception ae;
+
+    DisassemblyJob(Assembly *a) : assembly(a), separation(0), disassembled(false), done(false), failed(false) {}
+  };
+
+  /* the jobs in the order the assembler found the assemblies, the front most are
+   * removed as soon as they are done
+   */
+  std::deque<DisassemblyJob *> jobs;
+
+  /* index into jobs of the next job to hand out to a disassembler thread */
+  unsigned int nextJob;
+
+  /* true while the disassembler threads are running */
+  bool pipelined;
+  bool jobsFinished;
+
+  /* one disassembler for each thread, the first one is disassm */
+  std::vector<DisassemblerInterface *> disassemblers;
+  boost::thread_group disassemblerGroup;
+
+  boost::mutex jobMutex;
+  boost::condition_variable jobCond;
+
+  void startDisassemblers(void);
+  void stopDisassemblers(void);
+  void finishDisassembly(void);
+  void disassemblerThread(DisassemblerInterface *d);
+
+  /* create a disassembler that uses the movement cache of the thread */
+  DisassemblerInterface *newDisassembler(void) const;
+  void queueAssembly(Assembly *a);
+  void commitJobs(boost::mutex::scoped_lock &lock);
+
  public:
 
   // stop and exit
@@ -173,6 +336,12 @@ class SolveThread : public AssemblerCallbackInterface, public Thread {
   // the callback
   bool assembly(Assembly *a);
 
+  // run the disassembler d on the assembly, when just counting s stays 0
+  bool disassemble(DisassemblerInterface *d, const Assembly *a, Separation **s) const;
+
+  // save or count the assembly, s is the result of the disassembler
+  void addAssembly(Assembly *a, Separation *s, bool disassembled);
+
  public:
 
   // let the thread start
@@ -191,6 +360,14 @@ class SolveThread : public AssemblerCallbackInterface, public Thread {
 
   void run(void);
 
+  /* add the solutions of other, that has been solved separately with the same
+   * parameters (e.g. one part of a split search) to our problem, see Problem::mergeSolutions.
+   * Afterwards the solutions are sorted and limited like this thread would have done it, so
+   * when the parts are merged in order the result is what a single search keeps, with
+   * the exception of thinned out solutions that the parts did drop
+   */
+  void mergeSolutions(Problem *other);
+
  private:
 
   // no copying and assigning
@@ -25,10 +25,13 @@
 #include "voxel.h"
 #include "assembly.h"
 #include "grid-type.h"
+#include "assembler-thread-pool.h"
+#include "placement-masks.h"
 
 #include "../tools/xml.h"
 
 #include <cstdlib>
+#include <climits>
 
 #ifdef WIN32
 #define snprintf _snprintf
@@ -288,6 +291,8 @@ void WeiHwaHuangAssembler::AddRangeNode(unsigned int col,
 
 WeiHwaHuangAssembler::WeiHwaHuangAssembler(void) :
     AssemblerInterface(),
+    splitDepth(UINT_MAX), minDepth(0), minFinished(0),
+    threads(1), requestedSplitDepth(0), pool(0),
     avoidTransformedAssemblies(0), avoidTransformedMirror(0),
     iterations(0),
     reducePiece(0) {
@@ -295,7 +300,36 @@ WeiHwaHuangAssembler::WeiHwaHuangAssembler(void) :
   task_stack.push_back(0);
 }
 
+WeiHwaHuangAssembler::WeiHwaHuangAssembler(const WeiHwaHuangAssembler *orig) :
+    AssemblerInterface(),
+    puzzle(orig->puzzle),
+    left(orig->left), right(orig->right), up(orig->up), down(orig->down),
+    colCount(orig->colCount), weight(orig->weight), min(orig->min), max(orig->max),
+    holeColumns(orig->holeColumns), holes(orig->holes),
+    abbort(false), running(false),
+    headerNodes(orig->headerNodes),
+    splitDepth(UINT_MAX), minDepth(0), minFinished(0),
+    threads(1), requestedSplitDepth(0), pool(0),
+    errorsState(ERR_NONE), errorsParam(0),
+    piecenumber(orig->piecenumber), asm_bc(0),
+    piecePositions(orig->piecePositions),
+    // the rotation check is done by the worker, as it is not thread safe
+    avoidTransformedAssemblies(false), avoidTransformedPivot(0), avoidTransformedMirror(0),
+    complete(orig->complete), debug(false), debug_loops(0),
+    iterations(0),
+    reducePiece(0) {
+
+  /* getFinished is called from other threads, so make sure that the vectors
+   * used there are not moved around too often
+   */
+  finished_a.reserve(headerNodes);
+  finished_b.reserve(headerNodes);
+}
+
 WeiHwaHuangAssembler::~WeiHwaHuangAssembler() {
+  // the pool needs to go first, its workers use our data
+  if (pool) delete pool;
+
   if (avoidTransformedMirror) delete avoidTransformedMirror;
 }
 
@@ -315,37 +349,6 @@ static Voxel *addToCache(Voxel *cache[], unsigned int *fill, Voxel *piece) {
   return piece;
 }
 
-bool WeiHwaHuangAssembler::canPlace(const Voxel *piece,
-                                    int x,
-                                    int y,
-                                    int z) const {
-
-  if (!piece->onGrid(x, y, z))
-    return false;
-
-  const Voxel *result = puzzle->getResultShape();
-
-  for (unsigned int pz = piece->boundZ1(); pz <= piece->boundZ2(); pz++)
-    for (unsigned int py = piece->boundY1(); py <= piece->boundY2(); py++)
-      for (unsigned int px = piece->boundX1(); px <= piece->boundX2(); px++)
-        if (
-          // the piece can not be place if the result is empty and the piece is filled at a given voxel
-            ((piece->getState(px, py, pz) == Voxel::VX_FILLED) &&
-                (result->getState(x + px, y + py, z + pz) == Voxel::VX_EMPTY))
-                ||
-
-                    // the piece can also not be placed when the colour constraints don't fit
-                    !puzzle->placementAllowed(piece->getColor(px, py, pz),
-                                              result->getColor(x + px,
-                                                               y + py,
-                                                               z + pz))
-
-            )
-          return false;
-
-  return true;
-}
-
 /**
  * this function prepares the matrix of nodes for the recursive function
  * I've done some additions to Knuths algorithm to implement variable
@@ -603,6 +606,8 @@ int WeiHwaHuangAssembler::prepare(bool hasRange,
 
   Voxel **cache = new Voxel *[sym->getNumTransformationsMirror()];
 
+  PlacementMasks masks(puzzle);
+
   /* now we insert one shape after another */
   for (unsigned int pc = 0; pc < puzzle->partNumber(); pc++) {
 
@@ -636,40 +641,41 @@ int WeiHwaHuangAssembler::prepare(bool hasRange,
       rotation = addToCache(cache, &cachefill, rotation);
 
       if (rotation) {
-        for (int x = (int) result->boundX1() - (int) rotation->boundX1();
-             x <= (int) result->boundX2() - (int) rotation->boundX2(); x++)
-          for (int y = (int) result->boundY1() - (int) rotation->boundY1();
-               y <= (int) result->boundY2() - (int) rotation->boundY2(); y++)
-            for (int z = (int) result->boundZ1() - (int) rotation->boundZ1();
-                 z <= (int) result->boundZ2() - (int) rotation->boundZ2(); z++)
-              if (canPlace(rotation, x, y, z)) {
-
-                int piecenode = AddPieceNode(pc,
-                                             rot,
-                                             x + rotation->getHx(),
-                                             y + rotation->getHy(),
-                                             z + rotation->getHz());
-                placements++;
-
-                /* now add the used cubes of the piece */
-                for (unsigned int pz = rotation->boundZ1();
-                     pz <= rotation->boundZ2(); pz++)
-                  for (unsigned int py = rotation->boundY1();
-                       py <= rotation->boundY2(); py++)
-                    for (unsigned int px = rotation->boundX1();
-                         px <= rotation->boundX2(); px++)
-                      if (rotation->getState(px, py, pz) == Voxel::VX_FILLED) {
-                        AddVoxelNode(columns[result->getIndex(x + px,
-                                                              y + py,
-                                                              z + pz)],
-                                     piecenode);
-                      }
-
-                // if we use the range counting and the piece is using a range, add it to
-                // the column
-                if (hasRange && (min[pc + 1] != max[pc + 1]))
-                  AddRangeNode(rangeColumn, piecenode, voxels);
-              }
+        std::vector<int> pos;
+        masks.findPlacements(rotation, &pos);
+
+        for (unsigned int i = 0; i < pos.size(); i += 3) {
+
+          int x = pos[i];
+          int y = pos[i + 1];
+          int z = pos[i + 2];
+
+          int piecenode = AddPieceNode(pc,
+                                       rot,
+                                       x + rotation->getHx(),
+                                       y + rotation->getHy(),
+                                       z + rotation->getHz());
+          placements++;
+
+          /* now add the used cubes of the piece */
+          for (unsigned int pz = rotation->boundZ1();
+               pz <= rotation->boundZ2(); pz++)
+            for (unsigned int py = rotation->boundY1();
+                 py <= rotation->boundY2(); py++)
+              for (unsigned int px = rotation->boundX1();
+                   px <= rotation->boundX2(); px++)
+                if (rotation->getState(px, py, pz) == Voxel::VX_FILLED) {
+                  AddVoxelNode(columns[result->getIndex(x + px,
+                                                        y + py,
+                                                        z + pz)],
+                               piecenode);
+                }
+
+          // if we use the range counting and the piece is using a range, add it to
+          // the column
+          if (hasRange && (min[pc + 1] != max[pc + 1]))
+            AddRangeNode(rangeColumn, piecenode, voxels);
+        }
         /* for the symmetry breaker piece we also add all symmetries of the box */
         if (pc == symBreakerShape)
           for (unsigned int r = 1; r < sym->getNumTransformations(); r++)
@@ -1119,10 +1125,22 @@ void WeiHwaHuangAssembler::solution() {
 
     Assembly *assembly = getAssembly();
 
-    if (avoidTransformedAssemblies && assembly->smallerRotationExists(puzzle,
-                                                                      avoidTransformedPivot,
-                                                                      avoidTransformedMirror,
-                                                                      complete))
+    bool transformed = false;
+
+    if (avoidTransformedAssemblies) {
+
+      // in the parallel search the workers do the same check at the same time
+      boost::unique_lock<boost::mutex> lock;
+      if (pool && pool->isActive())
+        lock = boost::unique_lock<boost::mutex>(pool->getSharedMutex());
+
+      transformed = assembly->smallerRotationExists(puzzle,
+                                                    avoidTransformedPivot,
+                                                    avoidTransformedMirror,
+                                                    complete);
+    }
+
+    if (transformed)
       delete assembly;
     else {
       getCallback()->assembly(assembly);
@@ -1542,7 +1560,17 @@ void WeiHwaHuangAssembler::iterative() {
 
   unsigned int row, col;
 
-  while (task_stack.size() > 0) {
+  while (task_stack.size() > minDepth) {
+
+    // the master thread of the parallel search hands the subtrees below the split
+    // level over to the worker threads and then continues as if the subtree was
+    // searched. When that fails the search has been stopped and we continue
+    // into the subtree until we are at a position that can be saved
+    if ((task_stack.back() == 0) && (rows.size() >= splitDepth) && !abbort && addTask()) {
+      next_row_stack.pop_back();
+      task_stack.pop_back();
+      continue;
+    }
 
     iterations++;
 
@@ -1905,6 +1933,352 @@ void WeiHwaHuangAssembler::iterative() {
   }
 }
 
+void WeiHwaHuangAssembler::stackOffsets(unsigned int frame,
+                                        unsigned int *col,
+                                        unsigned int *row,
+                                        unsigned int *hidden,
+                                        unsigned int *fin) const {
+
+  *col = *row = *hidden = *fin = 0;
+
+  for (unsigned int i = 0; i < frame; i++) {
+
+    switch (task_stack[i]) {
+
+      case 1:(*col)++;
+        break;
+      case 2:(*fin)++;
+        break;
+      case 5:(*fin)++;
+        (*row)++;
+
+        // the rows hidden in the row loop and the rows hidden after adding the row
+        (*hidden)++;
+        while (*hidden < hidden_rows.size() && hidden_rows[*hidden] > 0)
+          (*hidden)++;
+        (*hidden)++;
+        while (*hidden < hidden_rows.size() && hidden_rows[*hidden] > 0)
+          (*hidden)++;
+        break;
+    }
+  }
+}
+
+bool WeiHwaHuangAssembler::coverStack(void) {
+
+  unsigned int column_stack_pos = 0;
+  unsigned int col, row;
+  unsigned int hiderows_pos = 0;
+  unsigned int row_pos = 0;
+
+  for (unsigned int i = 0; i < task_stack.size(); i++) {
+
+    switch (task_stack[i]) {
+
+      case 0:
+        // a subtree that has not been entered, this is only possible on the top
+        if (i + 1 != task_stack.size()) return false;
+        break;
+      case 1:cover_column_only(column_stack[column_stack_pos++]);
+        break;
+      case 2:if (column_stack_pos == 0) return false;
+        col = column_stack[column_stack_pos - 1];
+        cover_column_rows(col);
+        break;
+      case 5:hiderows_pos++;
+        while (hiderows_pos < hidden_rows.size()
+            && hidden_rows[hiderows_pos] > 0) {
+          hiderow(hidden_rows[hiderows_pos++]);
+        }
+
+        row = rows[row_pos++];
+        // add row to rowset
+        weight[colCount[row]] += weight[row];
+        for (unsigned int r = right[row]; r != row; r = right[r])
+          weight[colCount[r]] += weight[r];
+
+        hiderows_pos++;
+        while (hiderows_pos < hidden_rows.size()
+            && hidden_rows[hiderows_pos] > 0) {
+          hiderow(hidden_rows[hiderows_pos++]);
+        }
+
+        break;
+
+      default:return false;
+    }
+  }
+
+  return true;
+}
+
+void WeiHwaHuangAssembler::uncoverStack(unsigned int frame) {
+
+  unsigned int column_stack_pos = 0;
+  unsigned int hiderows_pos = hidden_rows.size();
+  unsigned int row_pos = rows.size();
+  unsigned int row;
+
+  for (unsigned int i = 0; i < task_stack.size(); i++)
+    if (task_stack[i] == 1)
+      column_stack_pos++;
+
+  // exactly the reverse of coverStack, all hidden rows must be unhidden in
+  // the reverse order they were hidden in
+  for (int i = task_stack.size() - 1; i >= (int)frame; i--) {
+
+    switch (task_stack[i]) {
+
+      case 1:uncover_column_only(column_stack[--column_stack_pos]);
+        break;
+      case 2:uncover_column_rows(column_stack[column_stack_pos - 1]);
+        break;
+      case 5:while (hidden_rows[--hiderows_pos] > 0)
+          unhiderow(hidden_rows[hiderows_pos]);
+
+        // remove row from rowset
+        row = rows[--row_pos];
+        for (unsigned int r = left[row]; r != row; r = left[r])
+          weight[colCount[r]] -= weight[r];
+        weight[colCount[row]] -= weight[row];
+
+        while (hidden_rows[--hiderows_pos] > 0)
+          unhiderow(hidden_rows[hiderows_pos]);
+        break;
+    }
+  }
+}
+
+void WeiHwaHuangAssembler::getFraction(unsigned int fin, float *before, float *weight) const {
+
+  *before = 0;
+  *weight = 1;
+
+  for (unsigned int r = 0; r < fin; r++) {
+    *before += *weight * finished_a[r] / finished_b[r];
+    *weight /= finished_b[r];
+  }
+}
+
+/* one subtree of the parallel search, it contains the complete search stacks
+ * of the master at the time the subtree was entered. When the search within
+ * the subtree is stopped it contains the stacks of the worker
+ */
+class WeiHwaHuangTask : public AssemblerTask {
+
+ public:
+
+  /* the size of the task stack including the root frame of the subtree */
+  unsigned int depth;
+
+  std::vector<unsigned int> rows;
+  std::vector<unsigned int> task_stack;
+  std::vector<unsigned int> next_row_stack;
+  std::vector<unsigned int> column_stack;
+  std::vector<unsigned int> hidden_rows;
+  std::vector<unsigned int> finished_a;
+  std::vector<unsigned int> finished_b;
+};
+
+/* a worker thread for the parallel search, it has its own copy of the matrix */
+class WeiHwaHuangWorker : public AssemblerWorker, public AssemblerCallbackInterface {
+
+  const WeiHwaHuangAssembler *master;
+  AssemblerThreadPool *pool;
+  WeiHwaHuangAssembler assm;
+  WeiHwaHuangTask *task;
+
+ public:
+
+  WeiHwaHuangWorker(const WeiHwaHuangAssembler *m, AssemblerThreadPool *p) :
+      master(m), pool(p), assm(m), task(0) {
+    assm.asm_bc = this;
+  }
+
+  bool run(AssemblerTask *t) {
+
+    task = static_cast<WeiHwaHuangTask *>(t);
+
+    unsigned int col, row, hidden, fin;
+
+    assm.uncoverStack(0);
+    assm.loadStack(task);
+    assm.coverStack();
+
+    assm.minDepth = task->depth - 1;
+    assm.stackOffsets(assm.minDepth, &col, &row, &hidden, &fin);
+    assm.minFinished = fin;
+
+    assm.iterative();
+
+    if (assm.task_stack.size() <= assm.minDepth)
+      return true;
+
+    assm.saveStack(task);
+    return false;
+  }
+
+  void stop(void) { assm.stop(); }
+
+  float getFinished(void) const { return assm.getFinished(); }
+
+  unsigned long getIterations(void) const { return assm.iterations; }
+
+  bool assembly(Assembly *a) {
+
+    if (master->avoidTransformedAssemblies) {
+
+      // the rotation check uses caches within the shapes of the puzzle
+      boost::mutex::scoped_lock lock(pool->getSharedMutex());
+
+      if (a->smallerRotationExists(master->puzzle,
+                                   master->avoidTransformedPivot,
+                                   master->avoidTransformedMirror,
+                                   master->complete)) {
+        delete a;
+        return true;
+      }
+    }
+
+    pool->assembly(task, a);
+    return true;
+  }
+};
+
+/* the assemblies the master thread finds itself need to be put between
+ * the ones of the workers
+ */
+class WeiHwaHuangMasterCallback : public AssemblerCallbackInterface {
+
+  AssemblerThreadPool *pool;
+
+ public:
+
+  WeiHwaHuangMasterCallback(AssemblerThreadPool *p) : pool(p) {}
+
+  bool assembly(Assembly *a) {
+    pool->addAssembly(a);
+    return true;
+  }
+};
+
+void WeiHwaHuangAssembler::saveStack(WeiHwaHuangTask *t) const {
+
+  t->rows = rows;
+  t->task_stack = task_stack;
+  t->next_row_stack = next_row_stack;
+  t->column_stack = column_stack;
+  t->hidden_rows = hidden_rows;
+  t->finished_a = finished_a;
+  t->finished_b = finished_b;
+}
+
+void WeiHwaHuangAssembler::loadStack(const WeiHwaHuangTask *t) {
+
+  rows = t->rows;
+  task_stack = t->task_stack;
+  next_row_stack = t->next_row_stack;
+  column_stack = t->column_stack;
+  hidden_rows = t->hidden_rows;
+  finished_a = t->finished_a;
+  finished_b = t->finished_b;
+}
+
+bool WeiHwaHuangAssembler::addTask(void) {
+
+  WeiHwaHuangTask *t = new WeiHwaHuangTask();
+
+  saveStack(t);
+  t->depth = task_stack.size();
+  getFraction(finished_a.size(), &t->before, &t->weight);
+
+  return pool->addTask(t);
+}
+
+void WeiHwaHuangAssembler::parallelSearch(void) {
+
+  if (!pool)
+    pool = new AssemblerThreadPool(16 * threads);
+
+  AssemblerCallbackInterface *callback = asm_bc;
+  WeiHwaHuangMasterCallback masterCallback(pool);
+
+  pool->begin(callback, &abbort);
+  asm_bc = &masterCallback;
+
+  /* the workers need a copy of the matrix in its initial state */
+  uncoverStack(0);
+  for (unsigned int i = 0; i < threads; i++)
+    pool->addWorker(new WeiHwaHuangWorker(this, pool));
+  coverStack();
+
+  /* when we continue a search that has been stopped below the split level
+   * the subtree we are in is the first task, and we continue above it
+   */
+  unsigned int col, row, hidden, fin;
+  unsigned int frame;
+
+  for (frame = 1; frame < task_stack.size(); frame++) {
+    stackOffsets(frame, &col, &row, &hidden, &fin);
+    if (row >= splitDepth)
+      break;
+  }
+
+  if (frame < task_stack.size()) {
+
+    WeiHwaHuangTask *t = new WeiHwaHuangTask();
+
+    saveStack(t);
+    t->depth = frame + 1;
+    getFraction(fin, &t->before, &t->weight);
+
+    if (pool->addTask(t)) {
+
+      uncoverStack(frame);
+
+      task_stack.resize(frame);
+      next_row_stack.resize(frame);
+      column_stack.resize(col);
+      rows.resize(row);
+      hidden_rows.resize(hidden);
+      finished_a.resize(fin);
+      finished_b.resize(fin);
+    }
+  }
+
+  try {
+    iterative();
+  }
+  catch (const assert_exception &) {
+    // the workers must not continue with our data
+    asm_bc = callback;
+    pool->stop();
+    pool->finish();
+    throw;
+  }
+
+  pool->finish();
+
+  iterations += pool->getIterations();
+  pool->clearIterations();
+
+  asm_bc = callback;
+
+  /* when the search was stopped we need to get to the position of the first
+   * subtree that is not finished, that is where the single threaded search
+   * would be, all later subtrees will be searched again
+   */
+  AssemblerTask *t = pool->getFirstUnfinished();
+
+  if (t) {
+    uncoverStack(0);
+    loadStack(static_cast<WeiHwaHuangTask *>(t));
+    coverStack();
+
+    delete t;
+  }
+}
+
 void WeiHwaHuangAssembler::assemble(AssemblerCallbackInterface *callback) {
 
   running = true;
@@ -1916,20 +2290,44 @@ void WeiHwaHuangAssembler::assemble(AssemblerCallbackInterface *callback) {
     // run, when something to do
     if (next_row_stack.size()) {
       asm_bc = callback;
-      iterative();
+
+      splitDepth = requestedSplitDepth ? requestedSplitDepth : 2;
+      if (splitDepth >= piecenumber)
+        splitDepth = piecenumber - 1;
+
+      if ((threads > 1) && (splitDepth > 0))
+        parallelSearch();
+      else {
+        splitDepth = UINT_MAX;
+        iterative();
+      }
+
+      splitDepth = UINT_MAX;
     }
   }
 
   running = false;
 }
 
+void WeiHwaHuangAssembler::setThreads(unsigned int t, unsigned int depth) {
+  threads = t;
+  requestedSplitDepth = depth;
+}
+
+unsigned long WeiHwaHuangAssembler::getIterations() {
+  return iterations + (pool ? pool->getIterations() : 0);
+}
+
 float WeiHwaHuangAssembler::getFinished(void) const {
 
+  if (pool && pool->isActive())
+    return pool->getFinished();
+
   if (next_row_stack.size() == 0) return 1;
 
   float erg = 0;
 
-  for (int r = finished_a.size() - 1; r >= 0; r--) {
+  for (int r = finished_a.size() - 1; r >= (int)minFinished; r--) {
 
     erg += finished_a[r];
     erg /= finished_b[r];
@@ -1994,45 +2392,8 @@ AssemblerInterface::errState WeiHwaHuangAssembler::setPosition(const char *strin
   pos += stringToVector(string + pos, finished_b);
 
   // not we need to restore the matrix to the right state
-
-  unsigned int column_stack_pos = 0;
-  unsigned int col, row;
-  unsigned int hiderows_pos = 0;
-  unsigned int row_pos = 0;
-
-  for (unsigned int i = 0; i < task_stack.size(); i++) {
-
-    switch (task_stack[i]) {
-
-      case 1:cover_column_only(column_stack[column_stack_pos++]);
-        break;
-      case 2:if (column_stack_pos == 0) return ERR_CAN_NOT_RESTORE_SYNTAX;
-        col = column_stack[column_stack_pos - 1];
-        cover_column_rows(col);
-        break;
-      case 5:hiderows_pos++;
-        while (hiderows_pos < hidden_rows.size()
-            && hidden_rows[hiderows_pos] > 0) {
-          hiderow(hidden_rows[hiderows_pos++]);
-        }
-
-        row = rows[row_pos++];
-        // add row to rowset
-        weight[colCount[row]] += weight[row];
-        for (unsigned int r = right[row]; r != row; r = right[r])
-          weight[colCount[r]] += weight[r];
-
-        hiderows_pos++;
-        while (hiderows_pos < hidden_rows.size()
-            && hidden_rows[hiderows_pos] > 0) {
-          hiderow(hidden_rows[hiderows_pos++]);
-        }
-
-        break;
-
-      default:return ERR_CAN_NOT_RESTORE_SYNTAX;
-    }
-  }
+  if (!coverStack())
+    return ERR_CAN_NOT_RESTORE_SYNTAX;
 
   return ERR_NONE;
 }
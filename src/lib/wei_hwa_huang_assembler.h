@@ -30,6 +30,8 @@
 class Problem;
 class GridType;
 class MirrorInfo;
+class AssemblerThreadPool;
+class WeiHwaHuangTask;
 
 /**
  * This class is an assembler class.
@@ -103,6 +105,71 @@ class WeiHwaHuangAssembler : public AssemblerInterface {
 
   unsigned int headerNodes;  // number of nodes within the header
 
+  /* the master thread of the parallel search hands each subtree that starts with
+   * at least this number of rows selected to the worker threads, for the
+   * single threaded search this is UINT_MAX
+   */
+  unsigned int splitDepth;
+
+  /* the search ends, when the task stack gets this small. This is 0 except for the
+   * workers of the parallel search, where it is one below the root of their subtree
+   */
+  unsigned int minDepth;
+
+  /* getFinished only uses the finished_a and finished_b entries from here on */
+  unsigned int minFinished;
+
+  /* the positions within column_stack, rows, hidden_rows and finished_a/b where the
+   * entries of the given frame of the task stack start
+   */
+  void stackOffsets(unsigned int frame,
+                    unsigned int *col,
+                    unsigned int *row,
+                    unsigned int *hidden,
+                    unsigned int *fin) const;
+
+  /* redo all the changes to the matrix that the frames on the task stack did,
+   * returns false, when the stack contains something that is not restorable
+   */
+  bool coverStack(void);
+
+  /* undo the changes to the matrix of the given and all following frames of
+   * the task stack, the stacks themselves are not changed
+   */
+  void uncoverStack(unsigned int frame);
+
+  /* calculate the fraction of the search tree that comes before the subtree
+   * given by the first fin entries of finished_a and finished_b and the
+   * fraction the subtree itself has
+   */
+  void getFraction(unsigned int fin, float *before, float *weight) const;
+
+  /* the number of threads for the search and the number of rows where the search
+   * tree is split into the subtrees for the threads, 0 selects the level
+   * automatically
+   */
+  unsigned int threads;
+  unsigned int requestedSplitDepth;
+
+  /* the pool for the parallel search, it is kept until the assembler is deleted
+   * so that getFinished and getIterations can always access it
+   */
+  AssemblerThreadPool *pool;
+
+  /* the search function used when more than one thread is requested */
+  void parallelSearch(void);
+
+  /* called by the parallel search whenever the master thread enters a subtree
+   * below the split level, returns false, when the search has been stopped
+   */
+  bool addTask(void);
+
+  /* copy the search stacks into the task and back */
+  void saveStack(WeiHwaHuangTask *t) const;
+  void loadStack(const WeiHwaHuangTask *t);
+
+  friend class WeiHwaHuangWorker;
+
   bool open_column_conditions_fulfillable(void);
   int find_best_unclosed_column(void);
   void cover_column_only(int col);
@@ -121,12 +188,6 @@ class WeiHwaHuangAssembler : public AssemblerInterface {
   void remove_column(register unsigned int c);
   unsigned int clumpify(void);
 
-  /**
-   * this function is called by the default implementation of prepare
-   * to check, if the piece fits at the given position
-   */
-  bool canPlace(const Voxel *piece, int x, int y, int z) const;
-
   /* this function creates the matrix for the search function
    * because we need to know how many nodes we need to allocate the
    * arrays with the right size, we add a parameter. If this is true
@@ -270,6 +331,16 @@ class WeiHwaHuangAssembler : public AssemblerInterface {
   WeiHwaHuangAssembler(void);
   ~WeiHwaHuangAssembler(void);
 
+ private:
+
+  /* create a copy of the matrix of another assembler, this is used for the
+   * worker threads of the parallel search, the matrix of the original must be
+   * in its initial state
+   */
+  WeiHwaHuangAssembler(const WeiHwaHuangAssembler *orig);
+
+ public:
+
   /* functions that are overloaded from AssemblerInterface, for comments see there */
   errState createMatrix(const Problem *puz,
                         bool keepMirror,
@@ -302,7 +373,8 @@ class WeiHwaHuangAssembler : public AssemblerInterface {
                                  int *y,
                                  int *z) const;
   unsigned int getPiecePlacementCount(unsigned int piece) const;
-  unsigned long getIterations() { return iterations; }
+  virtual unsigned long getIterations();
+  virtual void setThreads(unsigned int threads, unsigned int splitDepth = 0);
 
  private:
 
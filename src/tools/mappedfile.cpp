@@ -0,0 +1,86 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#include "mappedfile.h"
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+MappedFile::~MappedFile(void) {
+#ifndef WIN32
+  if (data && buffer.empty())
+    munmap((void *)data, size);
+#endif
+}
+
+bool MappedFile::open(const char *name) {
+
+  if (data)
+    return false;
+
+#ifndef WIN32
+
+  int fd = ::open(name, O_RDONLY);
+
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+
+    void *m = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (m != MAP_FAILED) {
+      data = (const unsigned char *)m;
+      size = st.st_size;
+    }
+  }
+
+  close(fd);
+
+  return data != 0;
+
+#else
+
+  std::ifstream in(name, std::ios::binary);
+
+  if (!in)
+    return false;
+
+  buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+  if (buffer.empty())
+    return false;
+
+  data = &buffer[0];
+  size = buffer.size();
+
+  return true;
+
+#endif
+}
@@ -0,0 +1,58 @@
+/* BurrTools
+ *
+ * BurrTools is the legal property of its developers, whose
+ * names are listed in the COPYRIGHT file, which is included
+ * within the source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * a file mapped into memory for reading, the pages are only read when
+ * they are accessed. Where mapping is not available the file is read
+ * into memory
+ */
+class MappedFile {
+
+  const unsigned char *data;
+  size_t size;
+
+  /** the content when the file could not be mapped */
+  std::vector<unsigned char> buffer;
+
+ public:
+
+  MappedFile(void) : data(0), size(0) {}
+  ~MappedFile(void);
+
+  /** map the file, returns false when that is not possible or the file is empty */
+  bool open(const char *name);
+
+  const unsigned char *getData(void) const { return data; }
+  size_t getSize(void) const { return size; }
+
+ private:
+
+  // no copying and assigning
+  MappedFile(const MappedFile &);
+  void operator=(const MappedFile &);
+};
+
+#endif